@@ -80,6 +80,13 @@ class ChessGame:
             return self.board.get_outcome()
         return None
     
+    def key(self):
+        """
+        Hashable key identifying the position (pieces, side to move, castling and en passant rights).
+        Different move orders reaching the same position give the same key.
+        """
+        return self.board.hash()
+
     def reset(self):
         """
         Reset the chess board to the initial state.
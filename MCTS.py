@@ -12,6 +12,8 @@ Requirements from the game state class:
 4. `valid_moves()`: Method to return a list of valid actions that can be taken from the current state. (Recommend using tuples)
 5. `get_feature_plane()`: Method to return the feature plane representation of the game state for the neural network model.
 6. `player`: Property to get the current player of the game state (1 for player, -1 for opponent).
+   Optionally `player_after(action)`: the player to move after `action`, for games where turns do not always alternate.
+7. `key()`: Method to return a hashable key of the position (only needed for MCTS_Deep(transpositions=True)).
 
 Requirements from the neural network model:
 1. `forward(state)`: Method to take a game state and return the value and policy (action probabilities).
@@ -24,6 +26,8 @@ Notes:
 - Actions are represented as keys in dictionaries, allowing for flexible action representation (e.g., tuples for coordinates).
 - I represented actions as coordinates in the policy head for ease of use with grid-based games, but this can be adapted for other action representations.
 """
+import time
+
 import numpy as np
 
 
@@ -36,10 +40,13 @@ class Deep_Node:
     - `state`: The game state represented by this node.
     - `model`: The neural network model used for state evaluation and action probabilities.
     - `children`: A dictionary mapping actions to child nodes.
-    - `Q`: A dictionary mapping actions to Q-values (expected rewards).
-    - `N`: A dictionary mapping actions to visit counts.
-    - `P`: A dictionary mapping actions to policy probabilities (from the model).
-    - `T`: A dictionary mapping actions to the player of the next state (1 for current player, -1 for opponent).
+    - `actions`: The valid actions, in the order used by the arrays below.
+    - `index`: A dictionary mapping actions to their position in `actions`.
+    - `Q`: NumPy array of Q-values (expected rewards) per action.
+    - `N`: NumPy array of visit counts per action.
+    - `P`: NumPy array of policy probabilities (from the model) per action.
+    - `T`: NumPy array of the player of the next state per action (1 for current player, -1 for opponent).
+    Keeping the statistics in contiguous arrays lets PUCT score and pick an action with a few vectorized calls per node.
 
     Search works by selecting actions based on the PUCT (Policy Upper Confidence Tree) formula,
     expanding nodes when necessary, and backing up values through the tree.
@@ -48,16 +55,19 @@ class Deep_Node:
     allowing for more informed decision-making compared to traditional MCTS nodes that rely solely on random simulations.
     """
     def __init__(self, state, model):
-        self.state = state.copy()       # Deep copy of the game state to ensure immutability
+        self.state = state              # Not copied: states come from step(), which already returns a new game
         self.model = model              # Neural network model for state evaluation and action probabilities
         self.children = {}              # Children nodes indexed by action
-        self.Q        = {}              # Q-values for actions (with respect to the next player to move)
-        self.N        = {}              # Number of visits for actions
-        self.P        = {}              # Policy probabilities for actions (from the model)
-        self.T        = {}              # Player of next state (1 if player stays the same, -1 if it changes)
+        self.actions  = []              # Valid actions; position i of the arrays below belongs to actions[i]
+        self.index    = {}              # Action -> position in actions
+        self.Q        = np.zeros(0)     # Q-values for actions (with respect to the next player to move)
+        self.N        = np.zeros(0, dtype=np.int64) # Number of visits for actions
+        self.P        = np.zeros(0)     # Policy probabilities for actions (from the model)
+        self.T        = np.zeros(0)     # Player of next state (1 if player stays the same, -1 if it changes)
         self.player   = state.player    # Current player of the state
         self.N_visits = 0               # Total number of visits to this node
         self.value    = 0               # Value of the node (with respect to the current player)
+        self.prior_value = 0            # Value first given by the model (or the outcome), before any backups
         self.terminal = False           # Whether the node is terminal (game over)
         self._initialize_node(state)
 
@@ -66,43 +76,40 @@ class Deep_Node:
         if outcome is not None:         # If terminal, set value and mark as terminal
             self.terminal = True
             self.value = outcome * self.player  # Set the value based on the outcome and current player
+            self.prior_value = self.value
             return
         
         # Get value and policy from model
-        self.value, self.P = self.model.forward(state)  # If not terminal, get value and policy from the model
+        self.value, policy = self.model.forward(state)  # If not terminal, get value and policy from the model
+        self.prior_value = self.value
         
-        # Initialize tracking dictionaries for all valid actions
-        for action in self.P:
-            self.children[action] = None
-            self.N[action] = 0
-            
-            # Create next state for Q-value initialization
-            next_state = self.state.step(action)
-            # self.Q[action] = self.model.get_value(next_state)
-            self.Q[action] = 0.0 # Initialize Q-value to 0.0 for all actions (can be updated later) (this is done as a speed up)
-            
-            # T=1 for moves that lead to the current player, T=-1 for opponent's turn
-            self.T[action] = 1 if (next_state.player == self.player) else -1
+        # Initialize tracking arrays for all valid actions. No child states are created here:
+        # a child's state is only built (by MCTS_Deep._expand) the first time its action is selected.
+        self.actions = list(policy)
+        self.index = {action: i for i, action in enumerate(self.actions)}
+        self.children = dict.fromkeys(self.actions)
+        self.P = np.fromiter(policy.values(), dtype=np.float64, count=len(self.actions))
+        self.N = np.zeros(len(self.actions), dtype=np.int64)
+        self.Q = np.zeros(len(self.actions)) # Initialize Q-value to 0.0 for all actions (can be updated later) (this is done as a speed up)
 
+        # T=1 for moves that lead to the current player, T=-1 for opponent's turn (turns alternate unless the game says otherwise)
+        player_after = getattr(state, 'player_after', None)
+        if player_after is None:
+            self.T = np.full(len(self.actions), -1.0)
+        else:
+            self.T = np.array([1.0 if player_after(action) == self.player else -1.0 for action in self.actions])
 
     def _select_action(self, puct=1.0):
-        """Select action using PUCT formula"""
-        if self.terminal or not self.P:
+        """Select action using PUCT formula (scored for all actions at once)"""
+        if self.terminal or not self.actions:
             return None
             
-        # Calculate UCT values for all actions
-        U = {}
-        for action in self.P:
-            if self.N[action] == 0:
-                # If action has never been visited, set U to the prior probability
-                U[action] = self.P[action] 
-            
-            exploration = puct * self.P[action] * np.sqrt(self.N_visits) / (1 + self.N[action])
-            exploitation = self.Q[action]
-            U[action] = exploitation * self.T[action] + exploration
-            
-        # Return action with maximum UCT value
-        return max(U, key=U.get) if U else None
+        U = self.Q * self.T + puct * self.P * np.sqrt(self.N_visits) / (1 + self.N)
+        return self.actions[int(np.argmax(U))]
+
+    def visit_counts(self):
+        """Visit counts as a dictionary mapping actions to visits."""
+        return dict(zip(self.actions, self.N.tolist()))
     
 
 class MCTS_Deep:
@@ -113,31 +120,233 @@ class MCTS_Deep:
     It performs the search by selecting nodes based on the PUCT (Policy Upper Confidence Tree) formula,
     expanding nodes when necessary, and backing up values through the tree.
 
+    With `transpositions=True` nodes are shared between move orders that reach the same position (looked up by `state.key()`),
+    so each position is evaluated by the model once and its statistics are pooled. The tree then becomes a graph; a move that
+    repeats a position earlier on the search path still leads to that position's node, but scores that simulation as a draw.
+
+    With `root_policy="gumbel"`, search() replaces PUCT at the root by Gumbel top-k sampling with sequential halving
+    (Danihelka et al., "Policy improvement by planning with Gumbel"): k root actions are drawn without replacement by
+    Gumbel noise plus policy logits, the simulation budget is split evenly between them and the worse half is dropped
+    after each phase until one remains. Below the root, PUCT is used as usual. `improved_policy()` gives the matching
+    training target. This improves on the raw policy with far fewer simulations than PUCT needs.
+
+    With `max_nodes` set, the tree is kept to that many nodes: once it grows past the limit the least visited subtrees are
+    cut off until it is back to three quarters of it. A cut action keeps its visit count and Q-value in the parent, and its
+    child is rebuilt (and re-evaluated) if the search selects it again.
+
     Args:
         state: The initial game state to start the search from.
         model: The neural network model used for state evaluation and action probabilities.
+        transpositions: Whether to share nodes between transpositions.
+        max_nodes: Largest number of nodes to keep in the tree (None for no limit).
+        seed: Seed of the Gumbel noise used by search(root_policy="gumbel").
         root: The root node of the search tree, initialized with the initial state and model.
     """
-    def __init__(self, state, model):
+    def __init__(self, state, model, transpositions=False, max_nodes=None, seed=None):
         self.model = model
         self.state = state
-        self.root = Deep_Node(state, model)
-
-    def search(self, puct=1.0, num_simulations=1000):
-        for _ in range(num_simulations):
-            path = self._select(puct)
-            node = self._expand(path)
-            value = node.value
-            self._backup(path, value)
-        return self.root.value, self.root.N        # Returns the estimated value and visit counts for the children of root node
-
-    def _select(self, puct=1.0):
-        """Select a node to expand using PUCT."""
+        self.root = Deep_Node(state.copy(), model)     # Copy so the caller's game is never shared with the tree
+        self.table = {state.key(): self.root} if transpositions else None     # Position key -> node
+        self.max_nodes = max_nodes
+        self.num_nodes = 1                              # Nodes in the tree (counted when created, recounted after pruning)
+        self.last_search = None                         # Statistics of the last search() call
+        self._done = 0                                  # Simulations run by the current search()
+        self.rng = np.random.default_rng(seed)          # Gumbel noise of root_policy="gumbel"
+
+    def search(self, puct=1.0, num_simulations=1000, time_ms=None, node_limit=None, early_stop=False,
+               root_policy="puct", gumbel_k=16):
+        """
+        Run up to `num_simulations` simulations, stopping earlier once `time_ms` milliseconds have passed or the tree holds
+        `node_limit` nodes. With `early_stop` the search also ends as soon as the most visited root action can no longer be
+        overtaken by the simulations left (estimated from the rate so far under a time limit).
+        `root_policy` picks how root actions are chosen: "puct", or "gumbel" for Gumbel top-`gumbel_k` sampling with
+        sequential halving (early_stop does not apply; the halving decides by itself).
+        What the search did is kept in `last_search`: simulations run and saved, elapsed_ms and the reason for stopping,
+        plus, for "gumbel", the chosen `action` and the `policy` target from improved_policy().
+        """
+        if root_policy not in ("puct", "gumbel"):
+            raise ValueError(f"Unknown root policy: {root_policy}")
+        start = time.perf_counter()
+        self._done = 0
+        self._reason = "simulations"
+
+        def stop():
+            elapsed_ms = (time.perf_counter() - start) * 1000.0
+            if self._done >= num_simulations:
+                return True
+            if time_ms is not None and elapsed_ms >= time_ms:
+                self._reason = "time"
+                return True
+            if node_limit is not None and self.num_nodes >= node_limit:
+                self._reason = "nodes"
+                return True
+            if early_stop and root_policy == "puct":
+                left = num_simulations - self._done
+                if time_ms is not None and self._done > 0:
+                    left = min(left, self._done / max(elapsed_ms, 1e-6) * (time_ms - elapsed_ms))
+                if self._decided(left):
+                    self._reason = "decided"
+                    return True
+            return False
+
+        action = None
+        if root_policy == "gumbel":
+            action = self._gumbel_search(puct, num_simulations, gumbel_k, stop)
+        else:
+            while not stop():
+                self._simulate(puct)
+        done = self._done
+        self.last_search = {"simulations": done, "saved": num_simulations - done,
+                            "elapsed_ms": (time.perf_counter() - start) * 1000.0, "reason": self._reason}
+        if root_policy == "gumbel":
+            self.last_search["action"] = action
+            self.last_search["policy"] = self.improved_policy()
+        return self.root.value, self.root.visit_counts()   # Returns the estimated value and visit counts for the children of root node
+
+    def _simulate(self, puct, root_action=None):
+        """One simulation: select (starting with `root_action` if given), expand, evaluate and back up."""
+        path = self._select(puct, root_action)
+        node = self._expand(path)
+        value = 0.0 if self._repeats(path, node) else node.value
+        self._backup(path, value)
+        if self.max_nodes is not None and self.num_nodes > self.max_nodes:
+            self._prune()
+        self._done += 1
+
+    def _gumbel_search(self, puct, num_simulations, k, stop):
+        """
+        Sequential halving over the top-k root actions by Gumbel noise plus policy logits.
+        Each phase gives every remaining candidate the same number of simulations, then keeps the better half by
+        g + logits + sigma(q). Once two remain (or if there was only one) they share what is left of the budget.
+        Returns the chosen action.
+        """
+        root = self.root
+        if root.terminal or not root.actions:
+            return None
+        logits = np.log(np.maximum(root.P, 1e-12))
+        g = self.rng.gumbel(size=len(root.actions))
+        k = max(1, min(k, len(root.actions)))
+        candidates = np.argsort(-(g + logits))[:k]
+
+        # A single candidate (k == 1 or one legal move) still gets the whole budget, so its value is searched
+        phases = max(1, int(np.ceil(np.log2(k))))
+        while not stop():
+            per_action = max(1, num_simulations // (phases * len(candidates)))
+            for _ in range(per_action):
+                for i in candidates:
+                    if stop():
+                        break
+                    self._simulate(puct, root.actions[int(i)])
+            if len(candidates) > 2:
+                scores = g[candidates] + logits[candidates] + self._sigma(self._completed_q())[candidates]
+                candidates = candidates[np.argsort(-scores)[:(len(candidates) + 1) // 2]]
+        scores = g[candidates] + logits[candidates] + self._sigma(self._completed_q())[candidates]
+        return root.actions[int(candidates[int(np.argmax(scores))])]
+
+    def _completed_q(self):
+        """Root Q-values from the root player's perspective, with unvisited actions set to the mixed value estimate."""
+        root = self.root
+        q = root.Q * root.T
+        visited = root.N > 0
+        total = root.N.sum()
+        if not visited.any():
+            return np.full(len(root.actions), float(root.prior_value))
+        weight = root.P[visited].sum()
+        mixed = (root.prior_value + total / max(weight, 1e-12) * (root.P[visited] * q[visited]).sum()) / (1 + total)
+        return np.where(visited, q, mixed)
+
+    def _sigma(self, q, c_visit=50.0, c_scale=0.1):
+        """Monotone transform of values in [-1, 1] that grows with the visit count of the most visited action."""
+        return (c_visit + self.root.N.max(initial=0)) * c_scale * (q + 1.0) / 2.0
+
+    def improved_policy(self, c_visit=50.0, c_scale=0.1):
+        """
+        Policy improvement target of the Gumbel search: softmax(logits + sigma(completed Q)) over the root actions.
+        Unlike raw visit counts, it is a sound target even after few simulations. Returns {action: probability}.
+        """
+        root = self.root
+        if root.terminal or not root.actions:
+            return {}
+        scores = np.log(np.maximum(root.P, 1e-12)) + self._sigma(self._completed_q(), c_visit, c_scale)
+        probs = np.exp(scores - scores.max())
+        probs /= probs.sum()
+        return dict(zip(root.actions, probs.tolist()))
+
+    def _decided(self, remaining):
+        """Whether the most visited root action stays ahead even if the runner-up gets `remaining` more visits."""
+        root = self.root
+        if root.terminal or root.N_visits == 0:
+            return False
+        if len(root.actions) <= 1:
+            return True
+        second, first = np.partition(root.N, -2)[-2:]
+        return second + remaining < first
+
+    def advance(self, action):
+        """
+        Re-root the tree after `action` has been played, so the next search starts from the statistics
+        already gathered below that child. The child's subtree (visits, priors and children) is kept; its siblings are dropped.
+        """
+        child = self.root.children.get(action)
+        if child is None:
+            next_state = self.root.state.step(action)
+            if next_state is None:
+                raise ValueError(f"Invalid action: {action}")
+            child = Deep_Node(next_state, self.model)
+        self.root = child
+        self.state = child.state
+        if self.table is not None:
+            self.table = self._reachable_nodes(child)   # Forget positions that can no longer be reached
+        self.num_nodes = len(self._subtree(child))
+
+    def _prune(self):
+        """
+        Cut the least visited subtrees until the tree is back to 3/4 of `max_nodes`.
+        Cutting only drops the child node: the parent's N and Q for that action stay, so the statistics gathered for the
+        move are kept and only the detail below it is lost.
+        """
+        target = self.max_nodes * 3 // 4
+        nodes = self._subtree(self.root)
+
+        # Subtree sizes, children before parents (a shared node counts under each parent, so on a DAG these are estimates)
+        sizes = {}
+        for node in reversed(nodes):
+            sizes[id(node)] = 1 + sum(sizes.get(id(child), 0) for child in node.children.values() if child is not None)
+
+        edges = [(parent.N[parent.index[action]], parent, action, child)
+                 for parent in nodes for action, child in parent.children.items() if child is not None]
+        edges.sort(key=lambda edge: edge[0])
+        remaining = len(nodes)
+        for _, parent, action, child in edges:
+            if remaining <= target:
+                break
+            if parent.children[action] is child:
+                parent.children[action] = None
+                remaining -= sizes[id(child)]
+
+        self.num_nodes = len(self._subtree(self.root))
+        if self.table is not None:
+            self.table = self._reachable_nodes(self.root)
+
+    @staticmethod
+    def _subtree(root):
+        """Every node reachable from `root` (each once), parents before their children."""
+        seen = {id(root)}
+        nodes = [root]
+        for node in nodes:
+            for child in node.children.values():
+                if child is not None and id(child) not in seen:
+                    seen.add(id(child))
+                    nodes.append(child)
+        return nodes
+
+    def _select(self, puct=1.0, root_action=None):
+        """Select a node to expand using PUCT (the first action is `root_action` when given)."""
         path = []
         node = self.root
         
         # Get the best action from current node
-        action = node._select_action(puct)
+        action = node._select_action(puct) if root_action is None else root_action
         
         # If no valid action, return the current path
         if action is None:
@@ -148,6 +357,10 @@ class MCTS_Deep:
         # Continue selecting until we find a node that hasn't been initialized
         while action is not None and node.children[action] is not None:
             node = node.children[action]
+
+            # A shared node can lead back to a node already on the path; stop instead of cycling
+            if self._repeats(path, node):
+                break
             
             # If terminal node, stop selection
             if node.terminal:
@@ -170,16 +383,46 @@ class MCTS_Deep:
             
         node, action = path[-1]
         
-        # If already expanded, return existing child (only happens with terminal nodes)
+        # If already expanded, return existing child (only happens with terminal nodes and repetitions)
         if node.children[action] is not None:
             return node.children[action]
             
         # Otherwise create a new node
         next_state = node.state.step(action)  # Apply the action to get the next state
+        if self.table is not None:
+            key = next_state.key()
+            child = self.table.get(key)
+            if child is None:
+                child = self.table[key] = Deep_Node(next_state, self.model)
+                self.num_nodes += 1
+            # A child already on this path is shared all the same: the repetition only makes this simulation a draw
+            # (see _simulate), since other move orders reaching `node` need not repeat it
+            node.children[action] = child
+            return child
         node.children[action] = Deep_Node(next_state, self.model) # Create a new child node with the next state and model (handles initialization)
+        self.num_nodes += 1
         
         return node.children[action]
 
+    @staticmethod
+    def _reachable_nodes(root):
+        """Key -> node table of every node reachable from `root`."""
+        table = {}
+        stack = [root]
+        while stack:
+            node = stack.pop()
+            key = node.state.key()
+            if key in table:
+                continue
+            table[key] = node
+            stack.extend(child for child in node.children.values() if child is not None)
+        return table
+
+    @staticmethod
+    def _repeats(path, node):
+        """Whether `node` is one of the nodes on `path` (only possible with transpositions)."""
+        return any(node is parent for parent, _ in path)
+
     def _backup(self, path, value):
         """
         Backpropagate the value through the tree.
@@ -202,13 +445,14 @@ class MCTS_Deep:
                 continue
                 
             # Update action visit counts
-            node.N[action] += 1
+            i = node.index[action]
+            node.N[i] += 1
             node.N_visits += 1
             
             # Update Q-value if child exists
             if node.children[action] is not None:
                 child = node.children[action]
-                node.Q[action] = child.value 
+                node.Q[i] = child.value 
             
                 
             # Update node value (weighted average)
@@ -217,4 +461,43 @@ class MCTS_Deep:
             node.value = ((node.N_visits - 1) * prev_value + (value * (leaf_player * node.player))) / node.N_visits
 
 
+class MCTS_Native:
+    """
+    Chess-only counterpart of MCTS_Deep backed by the C++ search in `chessengine.MCTS`.
+    The whole tree lives in C++; Python is only entered to run the network on leaf positions.
 
+    Args:
+        state: The ChessGame to search from (its `board` is copied into the native tree).
+        model: Model exposing `evaluate_batch(states) -> (values, logits)` (e.g. ChessCNN), or None for uniform priors.
+        puct: PUCT exploration constant.
+        server: Optional `chessengine.InferenceServer` to evaluate through instead of calling `model` directly.
+            Searches running in different threads that share a server have their leaves batched together.
+        cache: Optional `chessengine.EvalCache` consulted before every network call (may be shared between searches).
+    """
+    def __init__(self, state, model, puct=1.0, server=None, cache=None):
+        import chessengine
+        self.model = model
+        self.state = state
+        evaluator = server if server is not None else (model.evaluate_batch if model is not None else None)
+        self.tree = chessengine.MCTS(state.board, evaluator, puct, cache)
+        self.last_search = None
+
+    def advance(self, action):
+        """Re-root the native tree after `action` has been played, keeping the chosen subtree's statistics."""
+        import chessengine
+        if not self.tree.advance(chessengine.Move(*action)):
+            raise ValueError(f"Invalid action: {action}")
+        self.state = self.state.step(action)
+
+    def search(self, puct=1.0, num_simulations=1000, batch_size=1, num_threads=1, time_ms=None, node_limit=None,
+               memory_limit=None, early_stop=False):
+        """
+        Run the search, sending up to `batch_size` leaves per network call (selected with virtual loss).
+        With num_threads > 1 several native workers share the tree; the model is then called from each of them (under the GIL).
+        The limits and `early_stop` work as in MCTS_Deep.search (memory_limit is in bytes of tree nodes and edges);
+        what the search did is kept in `last_search`.
+        """
+        self.tree.set_c_puct(puct)
+        self.last_search = self.tree.search_limited(num_simulations, time_ms or 0.0, node_limit or 0, memory_limit or 0,
+                                                    early_stop, batch_size, num_threads)
+        return self.last_search["value"], self.tree.root_visit_counts()     # Same shape of result as MCTS_Deep.search
@@ -2,6 +2,60 @@ import torch
 import torch.nn as nn
 import torch.nn.functional as F
 import numpy as np
+import os
+import tempfile
+import chessengine
+
+NATIVE_MAGIC = 0x4E4E4343     # "CCNN", see game_logic/Network.h
+NATIVE_VERSION = 2
+NATIVE_ALIGNMENT = 64         # Bytes; the header and every tensor start on this boundary
+BN_EPS = 1e-5                 # nn.BatchNorm2d default
+
+
+def _fold_batch_norm(params, conv, bn):
+    """Weights and bias of convolution `conv` with the (eval-mode) batch norm `bn` that follows it folded in."""
+    scale = params[f"{bn}.weight"] / np.sqrt(params[f"{bn}.running_var"] + BN_EPS)
+    weight = params[f"{conv}.weight"] * scale.reshape(-1, *([1] * (params[f"{conv}.weight"].ndim - 1)))
+    bias = (params[f"{conv}.bias"] - params[f"{bn}.running_mean"]) * scale + params[f"{bn}.bias"]
+    return weight, bias
+
+
+def write_native_weights(path, params):
+    """
+    Write ChessCNN parameters (a state_dict as numpy arrays) in the format loaded by chessengine.Network.
+
+    Batch norms are folded into the convolutions before them and every tensor is stored 64-byte aligned in the
+    layout the native kernels use, so the file is evaluated in place from a read-only memory map (see
+    game_logic/Network.h). The file is written next to `path` and renamed over it, so processes that have the
+    previous version mapped keep a consistent copy.
+    """
+    conv1_weight = params["conv1.weight"]
+    input_channels, channels = conv1_weight.shape[1], conv1_weight.shape[0]
+    header = np.zeros(NATIVE_ALIGNMENT // 4, dtype="<u4")
+    header[:5] = [NATIVE_MAGIC, NATIVE_VERSION, input_channels, channels, params["value_fc1.weight"].shape[0]]
+
+    arrays = []
+    for conv, bn in [("conv1", "bn1"), ("conv2", "bn2"), ("conv3", "bn3")]:
+        weight, bias = _fold_batch_norm(params, conv, bn)
+        # (out, in, ky, kx) -> rows (ky, kx, in), columns out
+        arrays.extend([weight.transpose(2, 3, 1, 0).reshape(-1, weight.shape[0]), bias])
+    policy_weight, policy_bias = _fold_batch_norm(params, "policy_conv", "policy_bn")
+    value_weight, value_bias = _fold_batch_norm(params, "value_conv", "value_bn")
+    heads = np.concatenate([policy_weight.reshape(-1, channels), value_weight.reshape(-1, channels)])
+    arrays.extend([heads.T, np.concatenate([policy_bias, value_bias])])
+    arrays.extend([params["policy_fc.weight"].T, params["policy_fc.bias"], params["policy_fc.weight"]])
+    for fc in ["value_fc1", "value_fc2"]:
+        arrays.extend([params[f"{fc}.weight"].T, params[f"{fc}.bias"]])
+
+    temporary = f"{path}.tmp{os.getpid()}"
+    with open(temporary, "wb") as f:
+        f.write(header.tobytes())
+        for array in arrays:
+            data = np.ascontiguousarray(array, dtype="<f4").tobytes()
+            f.write(data)
+            f.write(b"\0" * (-len(data) % NATIVE_ALIGNMENT))
+    os.replace(temporary, path)
+
 
 class ChessCNN(nn.Module):
     def __init__(self, input_channels=9, num_channels=128):
@@ -32,6 +86,9 @@ class ChessCNN(nn.Module):
         self.policy_shape = (8, 8, 8, 8)
         self.value_shape = (1,)
 
+        # Optional chessengine.EvalCache consulted by forward/forward_batch before running the network on a chess position
+        self.cache = None
+
     def forward(self, state):
         """
         Forward pass through the network.
@@ -44,25 +101,93 @@ class ChessCNN(nn.Module):
             policy: Dictionary mapping valid move tuples to probabilities.
         """
         if isinstance(state, torch.Tensor):
-            x = self._prepare_tensor(state)
             # Cannot infer valid moves from tensor alone, this path is for get_value or direct network calls
-            policy_mask = None 
+            # If no mask, return raw logits (used internally by get_value)
+            return self._network_forward(self._prepare_tensor(state))
+
+        board = getattr(state, 'board', None)
+        chess = isinstance(board, chessengine.ChessBoard)
+        if chess and self.cache is not None:
+            cached = self.cache.lookup(board)
+            if cached is not None:
+                return cached[0], self._policy_from_priors(board, cached[1])
+
+        try:
+            x = self._prepare_tensor(state.get_feature_plane())
+        except AttributeError:
+            raise ValueError("Input state must have get_feature_plane and get_policy_mask methods")
+
+        if chess:
+            # Only the legal moves' rows of policy_fc are computed
+            with torch.no_grad():
+                value, features = self._network_features(x)
+                priors = self._legal_priors(features[0], chessengine.legal_policy_indices([board])[0])
+            policy_dict = self._policy_from_priors(board, priors)
+            if self.cache is not None:
+                self.cache.insert(board, value.item(), priors)
         else:
+            with torch.no_grad():
+                value, policy_logits = self._network_forward(x)
             try:
-                feature_plane = state.get_feature_plane()
                 policy_mask = state.get_policy_mask()
-                x = self._prepare_tensor(feature_plane)
             except AttributeError:
                 raise ValueError("Input state must have get_feature_plane and get_policy_mask methods")
-
-        value, policy_logits = self._network_forward(x)
-        
-        if policy_mask is not None:
             policy_dict = self._create_policy_dict(policy_logits, policy_mask)
-            return value.item(), policy_dict
-        else:
-            # If no mask, return raw logits (used internally by get_value)
-            return value, policy_logits
+        return value.item(), policy_dict
+
+    def forward_batch(self, states):
+        """
+        Evaluate several chess states with a single network pass.
+
+        Args:
+            states: List of ChessGame-like objects (must expose get_feature_plane() and a chessengine `board`).
+
+        Returns:
+            List of (value, policy) tuples in the same order, where policy maps valid move tuples to probabilities.
+        """
+        if not states:
+            return []
+        results = [None] * len(states)
+        if self.cache is not None:
+            for i, state in enumerate(states):
+                cached = self.cache.lookup(state.board)
+                if cached is not None:
+                    results[i] = (cached[0], self._policy_from_priors(state.board, cached[1]))
+        misses = [i for i, result in enumerate(results) if result is None]
+        if not misses:
+            return results
+
+        x = torch.FloatTensor(np.stack([states[i].get_feature_plane() for i in misses]))
+        boards = [states[i].board for i in misses]
+        with torch.no_grad():
+            values, features = self._network_features(x)
+            priors = [self._legal_priors(row, indices)
+                      for row, indices in zip(features, chessengine.legal_policy_indices(boards))]
+        for i, board, value, board_priors in zip(misses, boards, values.view(-1).tolist(), priors):
+            results[i] = (value, self._policy_from_priors(board, board_priors))
+            if self.cache is not None:
+                self.cache.insert(board, value, board_priors)
+        return results
+
+    def evaluate_batch(self, states):
+        """
+        Evaluator callback for the native search (chessengine.MCTS).
+
+        Args:
+            states: float32 numpy array of shape (batch, 9, 8, 8).
+
+        Returns:
+            (values, logits) as numpy arrays of shape (batch,) and (batch, 4096).
+        """
+        with torch.no_grad():
+            values, policy_logits = self._network_forward(torch.from_numpy(states))
+        return values.view(-1).numpy(), policy_logits.numpy()
+
+    @staticmethod
+    def _policy_from_priors(board, priors):
+        """Policy dictionary from priors aligned with board.legal_moves()."""
+        return {(move.start.x, move.start.y, move.to.x, move.to.y): prob
+                for move, prob in zip(board.legal_moves(), priors.tolist())}
 
     def _prepare_tensor(self, tensor):
         """Prepare input tensor for the network."""
@@ -78,6 +203,11 @@ class ChessCNN(nn.Module):
 
     def _network_forward(self, x):
         """Internal network forward pass."""
+        value, policy = self._network_features(x)
+        return value, self.policy_fc(policy)
+
+    def _network_features(self, x):
+        """Network forward pass up to the input of policy_fc; returns (value, policy features)."""
         # Shared representation
         x = F.relu(self.bn1(self.conv1(x)))
         x = F.relu(self.bn2(self.conv2(x)))
@@ -86,7 +216,6 @@ class ChessCNN(nn.Module):
         # Policy head
         policy = F.relu(self.policy_bn(self.policy_conv(x)))
         policy = policy.view(x.size(0), -1)
-        policy = self.policy_fc(policy)
         
         # Value head
         value = F.relu(self.value_bn(self.value_conv(x)))
@@ -96,6 +225,18 @@ class ChessCNN(nn.Module):
         
         return value, policy
 
+    def _legal_priors(self, features, indices):
+        """
+        Priors of the given policy entries (usually the legal moves) for one position's policy features:
+        only those rows of policy_fc are computed, and the softmax runs over them alone.
+        """
+        indices = torch.from_numpy(indices)
+        logits = F.linear(features, self.policy_fc.weight[indices], self.policy_fc.bias[indices])
+        priors = F.softmax(logits, dim=0).numpy()
+        if not np.isfinite(priors).all():
+            priors = np.full(len(priors), 1.0 / len(priors), dtype=np.float32)
+        return priors
+
     def _create_policy_dict(self, policy_logits, policy_mask):
         """Convert policy logits to a dictionary of probabilities for valid moves."""
         policy_probs = F.softmax(policy_logits, dim=1)
@@ -148,6 +289,21 @@ class ChessCNN(nn.Module):
             value, _ = self._network_forward(x)
             return value.item()
 
+    def export_native(self, path):
+        """Export the weights for native inference (chessengine.Network), with batch norm folded into the convolutions."""
+        params = {name: tensor.detach().cpu().numpy() for name, tensor in self.state_dict().items()}
+        write_native_weights(path, params)
+
+    def publish_native(self, slot):
+        """Publish a native export to a chessengine.WeightSlot for self-play processes to pick up; returns its generation."""
+        fd, path = tempfile.mkstemp(suffix=".bin")
+        os.close(fd)
+        try:
+            self.export_native(path)
+            return slot.publish_file(path)
+        finally:
+            os.remove(path)
+
     def save(self, path):
         """Save the model to a file."""
         torch.save(self.state_dict(), path)
@@ -155,4 +311,6 @@ class ChessCNN(nn.Module):
     def load(self, path):
         """Load the model from a file."""
         self.load_state_dict(torch.load(path))
-        self.eval()
\ No newline at end of file
+        self.eval()
+        if self.cache is not None:
+            self.cache.clear()     # Cached evaluations belong to the old weights
\ No newline at end of file
@@ -1,12 +1,184 @@
 // bindings.cpp
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>  // For automatic STL conversions
+#include <pybind11/numpy.h>
 #include "game_logic/ChessBoard.h" 
 #include "game_logic/Piece.h"
 #include "game_logic/types.h"
+#include "game_logic/Random.h"
+#include "game_logic/Policy.h"
+#include "game_logic/MCTS.h"
+#include "game_logic/InferenceServer.h"
+#include "game_logic/EvalCache.h"
+#include "game_logic/Playout.h"
+#include "game_logic/Network.h"
+#include "game_logic/SelfPlay.h"
+#include "game_logic/Replay.h"
+#include "game_logic/DataLoader.h"
+#include "game_logic/Pgn.h"
+#include "game_logic/SharedMemory.h"
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
 
 namespace py = pybind11;
 
+using FloatArray = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+// Validates a (batch, 4096) or (4096,) logits array against the boards and runs the masked softmax without the GIL
+static std::vector<std::vector<float>> priors_for_boards(const FloatArray& logits, const std::vector<const ChessBoard*>& boards) {
+    if ((logits.ndim() != 1 && logits.ndim() != 2) || logits.shape(logits.ndim() - 1) != POLICY_SIZE) {
+        throw std::invalid_argument("policy logits must have shape (batch, 4096) or (4096,)");
+    }
+    size_t rows = logits.ndim() == 1 ? 1 : static_cast<size_t>(logits.shape(0));
+    if (rows != boards.size()) {
+        throw std::invalid_argument("number of logit rows does not match number of boards");
+    }
+    const float* data = logits.data();
+    py::gil_scoped_release release;
+    return masked_softmax_batch(data, boards);
+}
+
+// Wraps a Python callable `fn(states) -> (values, logits)` as a native network.
+// states is a float32 array of shape (batch, 9, 8, 8); values has batch entries and logits is (batch, 4096).
+// The GIL is only held while calling into Python, so searches can run with it released.
+static BatchNetwork python_network(const py::function& fn) {
+    // The callable may outlive the GIL scope it was created in, so release it under the GIL
+    std::shared_ptr<py::function> callable(new py::function(fn), [](py::function* f) {
+        py::gil_scoped_acquire acquire;
+        delete f;
+    });
+    return [callable](const float* states, int batch, float* values, float* logits) {
+        py::gil_scoped_acquire acquire;
+        py::array_t<float> input({static_cast<py::ssize_t>(batch), py::ssize_t(9), py::ssize_t(8), py::ssize_t(8)});
+        std::copy(states, states + static_cast<size_t>(batch) * STATE_TENSOR_SIZE, input.mutable_data());
+
+        py::tuple output = (*callable)(input);
+        FloatArray value_array = output[0].cast<FloatArray>();
+        FloatArray logit_array = output[1].cast<FloatArray>();
+        if (value_array.size() != batch) {
+            throw std::invalid_argument("evaluator returned the wrong number of values");
+        }
+        if (logit_array.size() != static_cast<py::ssize_t>(batch) * POLICY_SIZE) {
+            throw std::invalid_argument("policy logits must have shape (batch, 4096)");
+        }
+        std::copy(value_array.data(), value_array.data() + batch, values);
+        std::copy(logit_array.data(), logit_array.data() + static_cast<size_t>(batch) * POLICY_SIZE, logits);
+    };
+}
+
+// A server for a native Network (scoring only the legal moves), or for a Python callable as in python_network
+static InferenceServer* new_server(const py::object& network, int max_batch_size, std::chrono::microseconds max_wait) {
+    if (py::isinstance<Network>(network)) {
+        return new InferenceServer(legal_network(network.cast<std::shared_ptr<Network>>()), max_batch_size, max_wait);
+    }
+    return new InferenceServer(python_network(network.cast<py::function>()), max_batch_size, max_wait);
+}
+
+// Python handle for playout_evaluator() settings
+struct PlayoutEvaluator {
+    int playouts;
+    int max_plies;
+    float capture_bias;
+};
+
+// Accepts a Python callable (see python_network), a native Network, an InferenceServer or a PlayoutEvaluator as a search evaluator
+static Evaluator python_evaluator(const py::object& evaluator) {
+    if (evaluator.is_none()) {
+        return uniform_evaluator();
+    }
+    if (py::isinstance<PlayoutEvaluator>(evaluator)) {
+        const PlayoutEvaluator& spec = evaluator.cast<const PlayoutEvaluator&>();
+        return playout_evaluator(spec.playouts, spec.max_plies, spec.capture_bias);
+    }
+    if (py::isinstance<InferenceServer>(evaluator)) {
+        return server_evaluator(evaluator.cast<std::shared_ptr<InferenceServer>>());
+    }
+    if (py::isinstance<Network>(evaluator)) {
+        return network_evaluator(legal_network(evaluator.cast<std::shared_ptr<Network>>()));
+    }
+    return network_evaluator(python_network(evaluator.cast<py::function>()));
+}
+
+// Puts an optional EvalCache in front of an evaluator
+static Evaluator with_cache(Evaluator evaluator, const py::object& cache) {
+    if (cache.is_none()) {
+        return evaluator;
+    }
+    return cached_evaluator(std::move(evaluator), cache.cast<std::shared_ptr<EvalCache>>());
+}
+
+static ReplacementPolicy replacement_policy(const std::string& name) {
+    if (name == "always") {
+        return ReplacementPolicy::ALWAYS;
+    }
+    if (name == "lru") {
+        return ReplacementPolicy::LRU;
+    }
+    if (name == "lfu") {
+        return ReplacementPolicy::LFU;
+    }
+    throw std::invalid_argument("replacement policy must be 'always', 'lru' or 'lfu'");
+}
+
+static py::dict stats_dict(const InferenceStats& stats) {
+    py::dict result;
+    result["requests"] = stats.requests;
+    result["batches"] = stats.batches;
+    result["mean_batch_size"] = stats.mean_batch_size;
+    result["batch_fill"] = stats.batch_fill;
+    result["mean_latency_us"] = stats.mean_latency_us;
+    result["p50_latency_us"] = stats.p50_latency_us;
+    result["p99_latency_us"] = stats.p99_latency_us;
+    result["max_latency_us"] = stats.max_latency_us;
+    return result;
+}
+
+// Python handle for a ReplayBuffer. Its reads and refresh() all run without the GIL, so they take this lock
+// instead: refresh() remaps and unmaps shards and needs it exclusively, like DataLoader's buffer
+struct SharedReplayBuffer {
+    ReplayBuffer buffer;
+    mutable std::shared_mutex mutex;
+
+    SharedReplayBuffer(const std::string& directory, size_t window) : buffer(directory, window) {}
+};
+
+// Decodes replay records into (states, policies, values) arrays without the GIL
+static py::tuple decode_records(const SharedReplayBuffer& shared, const std::vector<size_t>& indices) {
+    py::ssize_t count = static_cast<py::ssize_t>(indices.size());
+    py::array_t<float> states({count, py::ssize_t(9), py::ssize_t(8), py::ssize_t(8)});
+    py::array_t<float> policies({count, py::ssize_t(POLICY_SIZE)});
+    py::array_t<float> values(count);
+    float* state_data = states.mutable_data();
+    float* policy_data = policies.mutable_data();
+    float* value_data = values.mutable_data();
+    {
+        py::gil_scoped_release release;
+        std::shared_lock<std::shared_mutex> read(shared.mutex);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            decode_record(shared.buffer.record(indices[i]), state_data + i * STATE_TENSOR_SIZE, policy_data + i * POLICY_SIZE, value_data + i);
+        }
+    }
+    return py::make_tuple(states, policies, values);
+}
+
+// Wraps a loader batch as (states, policies, values) arrays that share its buffers; the batch returns
+// to the loader's pool once all three arrays are garbage collected
+static py::tuple batch_arrays(std::shared_ptr<const TrainingBatch> batch) {
+    py::capsule owner(new std::shared_ptr<const TrainingBatch>(batch), [](void* p) {
+        delete static_cast<std::shared_ptr<const TrainingBatch>*>(p);
+    });
+    py::ssize_t size = batch->size;
+    py::array_t<float> states({size, py::ssize_t(9), py::ssize_t(8), py::ssize_t(8)}, batch->states.data(), owner);
+    py::array_t<float> policies({size, py::ssize_t(POLICY_SIZE)}, batch->policies.data(), owner);
+    py::array_t<float> values(size, batch->values.data(), owner);
+    return py::make_tuple(states, policies, values);
+}
+
 PYBIND11_MODULE(chessengine, m) {
     m.doc() = "Chess Engine Module";
 
@@ -30,28 +202,697 @@ PYBIND11_MODULE(chessengine, m) {
         .export_values();
 
     // Bind ChessBoard class
-    py::class_<ChessBoard>(m, "ChessBoard")
+    // Engine work runs with the GIL released so Python threads driving *different* boards can
+    // run in parallel. A single board must still only be used by one thread at a time.
+    using release_gil = py::call_guard<py::gil_scoped_release>;
+    py::class_<ChessBoard>(m, "ChessBoard",
+        "Chess position. Distinct boards may be used from different threads concurrently; "
+        "a single board must not be shared between threads.")
         .def(py::init<>())
-        .def("make_move", py::overload_cast<const Move&>(&ChessBoard::make_move), "Make a move on the chessboard")
+        .def("make_move", py::overload_cast<const Move&>(&ChessBoard::make_move), "Make a move on the chessboard",
+             release_gil())
         .def("get_turn", &ChessBoard::get_turn, "Get the current turn")
-        .def("is_in_check", &ChessBoard::is_in_check, "Check if a color is in check")
+        .def("is_in_check", &ChessBoard::is_in_check, "Check if a color is in check", release_gil())
         .def("print_board", &ChessBoard::print_board, "Print the current state of the chessboard")
-        .def("clone", &ChessBoard::clone, "Create a deep copy of the chessboard")
-        .def("copy", &ChessBoard::clone, "Create a deep copy of the chessboard for MCTS")
+        .def("clone", &ChessBoard::clone, "Create a deep copy of the chessboard", release_gil())
+        .def("copy", &ChessBoard::clone, "Create a deep copy of the chessboard for MCTS", release_gil())
         .def("get_board_state_chars", &ChessBoard::get_board_state_chars, 
              "Get the current state of the chessboard as a 2D array of characters")
         .def("get_valid_moves", &ChessBoard::get_valid_moves, 
-             "Get all valid moves for the current turn")
+             "Get all valid moves for the current turn", release_gil())
+        .def("legal_moves", &ChessBoard::legal_moves,
+             "Get the cached valid moves for the current turn without regenerating them")
         .def("is_game_over", &ChessBoard::is_game_over, 
              "Check if the game is over")
         .def("get_outcome", &ChessBoard::get_outcome, 
              "Get the outcome of the game (checkmate, stalemate, etc.)")
         .def("get_state_tensor", &ChessBoard::get_state_tensor, 
-             "Get the state tensor representing the chessboard")
+             "Get the state tensor representing the chessboard", release_gil())
         .def("get_policy_mask", &ChessBoard::get_policy_mask,
-        "Get the policy mask for valid moves in the current state")
-        .def("reset", &ChessBoard::reset, "Reset the chessboard to the initial state")
-        .def("step", &ChessBoard::step, "Apply a move and return a new ChessBoard instance")
-        .def("random_move", &ChessBoard::random_move, "Generate a random legal move for the current player");
+        "Get the policy mask for valid moves in the current state", release_gil())
+        .def("hash", &ChessBoard::hash, "64-bit Zobrist key of the position (equal for transposed move orders)")
+        .def("reset", &ChessBoard::reset, "Reset the chessboard to the initial state", release_gil())
+        .def("step", &ChessBoard::step, "Apply a move and return a new ChessBoard instance", release_gil())
+        .def("random_move", py::overload_cast<>(&ChessBoard::random_move),
+             "Generate a random legal move for the current player (uses the calling thread's RNG)", release_gil())
+        .def("parse_san", &parse_san, py::arg("san"),
+             "Resolve a move in standard algebraic notation (e.g. 'Nbd7', 'O-O', 'e8=Q+') against the legal moves");
+
+    // Policy decoding
+    m.def("masked_softmax", [](const FloatArray& logits, const std::vector<const ChessBoard*>& boards) {
+        std::vector<std::vector<float>> priors = priors_for_boards(logits, boards);
+        py::list result;
+        for (const std::vector<float>& p : priors) {
+            result.append(py::array_t<float>(p.size(), p.data()));
+        }
+        return result;
+    }, py::arg("logits"), py::arg("boards"),
+    "Softmax of each logit row over its board's legal moves. Returns one array per board aligned with legal_moves()");
+
+    m.def("policy_dicts", [](const FloatArray& logits, const std::vector<const ChessBoard*>& boards) {
+        std::vector<std::vector<float>> priors = priors_for_boards(logits, boards);
+        py::list result;
+        for (size_t b = 0; b < boards.size(); ++b) {
+            const std::vector<Move>& moves = boards[b]->legal_moves();
+            py::dict policy;
+            for (size_t i = 0; i < moves.size(); ++i) {
+                policy[py::make_tuple(moves[i].from.x, moves[i].from.y, moves[i].to.x, moves[i].to.y)] = priors[b][i];
+            }
+            result.append(policy);
+        }
+        return result;
+    }, py::arg("logits"), py::arg("boards"),
+    "Like masked_softmax, but returns one {(from_x, from_y, to_x, to_y): prob} dict per board");
+
+    m.def("move_to_index", &move_to_policy_index, "Flat policy index of a move");
+    m.def("legal_policy_indices", [](const std::vector<const ChessBoard*>& boards) {
+        py::list indices;
+        for (const ChessBoard* board : boards) {
+            const std::vector<Move>& moves = board->legal_moves();
+            py::array_t<int64_t> row(moves.size());
+            int64_t* data = row.mutable_data();
+            for (size_t i = 0; i < moves.size(); ++i) {
+                data[i] = move_to_policy_index(moves[i]);
+            }
+            indices.append(row);
+        }
+        return indices;
+    }, py::arg("boards"), "Flat policy indices of each board's legal moves (int64 arrays in legal_moves() order)");
+    m.def("index_to_move", &policy_index_to_move, "Move for a flat policy index");
+
+    // Bind MCTS class
+    py::class_<MCTS>(m, "MCTS",
+        "Native Monte Carlo Tree Search. The evaluator is called with a float32 array of states shaped "
+        "(batch, 9, 8, 8) and must return (values, logits) shaped (batch,) and (batch, 4096). "
+        "An InferenceServer can be passed instead to share its batches with other searches, or a PlayoutEvaluator "
+        "for model-free search. "
+        "Without an evaluator, uniform priors and zero values are used.")
+        .def(py::init([](const ChessBoard& board, py::object evaluator, float c_puct, py::object cache) {
+            return new MCTS(board, with_cache(python_evaluator(evaluator), cache), c_puct);
+        }), py::arg("board"), py::arg("evaluator") = py::none(), py::arg("c_puct") = 1.0f, py::arg("cache") = py::none(),
+        "cache: optional EvalCache consulted before every evaluator call")
+        .def("search", static_cast<float (MCTS::*)(int, int, int)>(&MCTS::search), py::arg("num_simulations"), py::arg("batch_size") = 1, py::arg("num_threads") = 1,
+             "Run simulations and return the root value (side to move perspective). Up to batch_size leaves "
+             "are collected with virtual loss and evaluated in one evaluator call; num_threads workers share the tree",
+             release_gil())
+        .def("search_limited", [](MCTS& tree, int simulations, double time_ms, long long nodes, size_t memory,
+                                  bool early_stop, int batch_size, int num_threads) {
+            SearchLimits limits;
+            limits.simulations = simulations;
+            limits.time_ms = time_ms;
+            limits.nodes = nodes;
+            limits.memory = memory;
+            limits.early_stop = early_stop;
+            SearchStats stats;
+            {
+                py::gil_scoped_release release;
+                stats = tree.search(limits, batch_size, num_threads);
+            }
+            static const char* reasons[] = {"simulations", "time", "nodes", "memory", "decided"};
+            py::dict result;
+            result["value"] = stats.value;
+            result["simulations"] = stats.simulations;
+            result["saved"] = stats.saved;
+            result["elapsed_ms"] = stats.elapsed_ms;
+            result["reason"] = reasons[static_cast<int>(stats.reason)];
+            return result;
+        }, py::arg("simulations"), py::arg("time_ms") = 0.0, py::arg("nodes") = 0, py::arg("memory") = 0,
+           py::arg("early_stop") = false, py::arg("batch_size") = 1, py::arg("num_threads") = 1,
+           "Search until the first limit is hit: simulations, time_ms of wall-clock time, nodes in the tree or memory "
+           "bytes of live nodes and edges (0 = no limit; see live_memory, memory_usage is larger). With early_stop the search also ends once the most visited "
+           "root move cannot be overtaken by the remaining simulations. Returns a dict with the root value, the "
+           "simulations run and saved, elapsed_ms and the reason for stopping "
+           "('simulations', 'time', 'nodes', 'memory' or 'decided')")
+        .def("root_visit_counts", [](const MCTS& tree) {
+            py::dict counts;
+            for (const auto& entry : tree.root_visit_counts()) {
+                const Move& move = entry.first;
+                counts[py::make_tuple(move.from.x, move.from.y, move.to.x, move.to.y)] = entry.second;
+            }
+            return counts;
+        }, "Visit counts of the root moves as {(from_x, from_y, to_x, to_y): visits}")
+        .def("advance", &MCTS::advance, py::arg("move"),
+             "Re-root the tree at the position after move, keeping that subtree's statistics. "
+             "Returns False if the move is illegal at the root")
+        .def("best_move", &MCTS::best_move, "Most visited root move")
+        .def("root_value", &MCTS::root_value, "Root value estimate (side to move perspective)")
+        .def("root_visits", &MCTS::root_visits, "Number of simulations through the root")
+        .def("root_board", &MCTS::root_board, py::return_value_policy::copy, "Copy of the root position")
+        .def("set_c_puct", &MCTS::set_c_puct, py::arg("c_puct"), "Change the PUCT exploration constant")
+        .def("set_virtual_loss", &MCTS::set_virtual_loss, py::arg("virtual_loss"),
+             "Value assumed for pending visits while a batch is being selected")
+        .def("collisions", &MCTS::collisions, "Number of selections that hit a leaf already being evaluated")
+        .def("num_nodes", &MCTS::num_nodes, "Number of node slots allocated in the tree")
+        .def("memory_usage", &MCTS::memory_usage, "Bytes held by the node and edge arenas, including unused and pruned slots")
+        .def("set_memory_budget", &MCTS::set_memory_budget, py::arg("bytes"),
+             "Cap the bytes of nodes and edges in use (0 = unlimited); least visited subtrees are pruned to stay under it. "
+             "This bounds live_memory only: the arenas (memory_usage) never shrink and keep pruned slots, so they end up larger")
+        .def("live_memory", &MCTS::live_memory, "Bytes of nodes and edges currently in the tree")
+        .def("pruned_nodes", &MCTS::pruned_nodes, "Number of nodes freed by pruning so far")
+        .def("set_transpositions", &MCTS::set_transpositions, py::arg("enabled"),
+             "Share nodes between move orders that reach the same position (best set before the first search)")
+        .def("transposition_hits", &MCTS::transposition_hits,
+             "Number of leaves resolved from the transposition table instead of the evaluator");
+
+    // Bind InferenceServer class
+    py::class_<InferenceServer, std::shared_ptr<InferenceServer>>(m, "InferenceServer",
+        "Batches evaluation requests from many searches into single network calls. network(states) gets a "
+        "float32 array shaped (batch, 9, 8, 8) and returns (values, logits) like an MCTS evaluator; it is "
+        "called from the server's own thread; a native Network can be given instead. Pass the server as the evaluator "
+        "of any number of MCTS objects.")
+        .def(py::init([](const py::object& network, int max_batch_size, double max_wait_ms) {
+            auto wait = std::chrono::microseconds(static_cast<long long>(max_wait_ms * 1000.0));
+            // Stopping joins the batching thread, which may be waiting for the GIL, so never stop while holding it
+            return std::shared_ptr<InferenceServer>(new_server(network, max_batch_size, wait),
+                [](InferenceServer* server) {
+                    if (PyGILState_Check()) {
+                        py::gil_scoped_release release;
+                        delete server;
+                    } else {
+                        delete server;
+                    }
+                });
+        }), py::arg("network"), py::arg("max_batch_size") = 64, py::arg("max_wait_ms") = 1.0)
+        .def("evaluate", [](InferenceServer& server, const ChessBoard& board) {
+            std::future<Evaluation> future = server.submit(board);
+            Evaluation evaluation;
+            {
+                py::gil_scoped_release release;
+                evaluation = future.get();
+            }
+            return py::make_tuple(evaluation.value, py::array_t<float>(evaluation.priors.size(), evaluation.priors.data()));
+        }, py::arg("board"), "Evaluate one position through the batch queue; returns (value, priors aligned with legal_moves)")
+        .def("stats", [](const InferenceServer& server) { return stats_dict(server.stats()); },
+             "Request count, batch count, batch fill and latency (mean/p50/p99/max, microseconds)")
+        .def("reset_stats", &InferenceServer::reset_stats, "Clear the metrics")
+        .def_property_readonly("max_batch_size", &InferenceServer::max_batch_size);
+
+    // Bind Network class
+    py::class_<Network, std::shared_ptr<Network>>(m, "Network",
+        "ChessCNN evaluated natively on the CPU from weights written by ChessCNN.export_native(). Pass it as the "
+        "evaluator of MCTS, InferenceServer or self_play to search without calling into Python.")
+        .def(py::init([](const std::string& path) {
+            py::gil_scoped_release release;
+            return std::make_shared<Network>(path);
+        }), py::arg("path"))
+        .def("evaluate", [](const Network& network, const FloatArray& states) {
+            if (states.ndim() != 4 || states.shape(1) != 9 || states.shape(2) != 8 || states.shape(3) != 8) {
+                throw std::invalid_argument("states must have shape (batch, 9, 8, 8)");
+            }
+            py::ssize_t batch = states.shape(0);
+            py::array_t<float> values(batch);
+            py::array_t<float> logits({batch, py::ssize_t(POLICY_SIZE)});
+            const float* input = states.data();
+            float* value_data = values.mutable_data();
+            float* logit_data = logits.mutable_data();
+            {
+                py::gil_scoped_release release;
+                network.evaluate(input, static_cast<int>(batch), value_data, logit_data);
+            }
+            return py::make_tuple(values, logits);
+        }, py::arg("states"), "Run a batch of (9, 8, 8) states; returns (values, logits) shaped (batch,) and (batch, 4096)")
+        .def("evaluate_boards", [](const Network& network, const std::vector<const ChessBoard*>& boards) {
+            std::vector<float> states(boards.size() * STATE_TENSOR_SIZE);
+            std::vector<const std::vector<Move>*> moves(boards.size());
+            std::vector<Evaluation> results(boards.size());
+            {
+                py::gil_scoped_release release;
+                for (size_t i = 0; i < boards.size(); ++i) {
+                    boards[i]->copy_state_tensor(states.data() + i * STATE_TENSOR_SIZE);
+                    moves[i] = &boards[i]->legal_moves();
+                }
+                network.evaluate_moves(states.data(), moves, results);
+            }
+            py::list output;
+            for (const Evaluation& evaluation : results) {
+                output.append(py::make_tuple(evaluation.value, py::array_t<float>(evaluation.priors.size(), evaluation.priors.data())));
+            }
+            return output;
+        }, py::arg("boards"),
+            "Evaluate boards computing only the policy logits of their legal moves; returns a (value, priors) tuple per "
+            "board, priors aligned with legal_moves(). Searches using the network do the same.")
+        .def("quantize", [](Network& network, const FloatArray& states) {
+            if (states.ndim() != 4 || states.shape(1) != 9 || states.shape(2) != 8 || states.shape(3) != 8) {
+                throw std::invalid_argument("states must have shape (batch, 9, 8, 8)");
+            }
+            const float* input = states.data();
+            py::gil_scoped_release release;
+            network.quantize(input, static_cast<int>(states.shape(0)));
+        }, py::arg("states"),
+            "Quantize to INT8, calibrating activation ranges on a batch of (9, 8, 8) states (e.g. recorded self-play "
+            "positions), and switch to INT8 inference. Do not call while searches are using the network.")
+        .def("compare_precision", [](const Network& network, const std::vector<const ChessBoard*>& boards) {
+            QuantizationReport report;
+            {
+                py::gil_scoped_release release;
+                report = network.compare_precision(boards);
+            }
+            py::dict result;
+            result["positions"] = report.positions;
+            result["value_mae"] = report.value_mae;
+            result["value_max_error"] = report.value_max_error;
+            result["policy_kl"] = report.policy_kl;
+            result["top1_agreement"] = report.top1_agreement;
+            result["fp32_seconds"] = report.fp32_seconds;
+            result["int8_seconds"] = report.int8_seconds;
+            return result;
+        }, py::arg("boards"),
+            "Evaluate held-out boards in FP32 and INT8; returns the value error (mean and max), the mean KL divergence "
+            "of the legal-move priors, how often both pick the same top move, and the time each precision took")
+        .def_property("precision",
+            [](const Network& network) { return network.precision() == Precision::INT8 ? "int8" : "fp32"; },
+            [](Network& network, const std::string& name) {
+                if (name != "fp32" && name != "int8") {
+                    throw std::invalid_argument("precision must be 'fp32' or 'int8'");
+                }
+                network.set_precision(name == "int8" ? Precision::INT8 : Precision::FP32);
+            }, "Arithmetic used by evaluate and searches: 'fp32', or 'int8' once quantized")
+        .def_property_readonly("quantized", &Network::quantized)
+        .def_property_readonly("channels", &Network::channels)
+        .def_property_readonly("mapped", &Network::mapped,
+                               "True if the weights are used in place from the memory-mapped file (current format)")
+        .def_property_readonly_static("kernel", [](py::object) { return Network::kernel(); },
+                                      "GEMM kernel in use: 'avx512', 'avx2' or 'scalar'")
+        .def_property_readonly_static("int8_kernel", [](py::object) { return Network::int8_kernel(); },
+                                      "INT8 GEMM kernel in use: 'avx512vnni', 'avx2' or 'scalar'");
+
+    // Bind EvalCache class
+    py::class_<EvalCache, std::shared_ptr<EvalCache>>(m, "EvalCache",
+        "Fixed-size sharded cache of network evaluations keyed by position hash. Pass it to MCTS or self_play "
+        "(or set it as a ChessCNN's cache) to skip the network for positions evaluated before. policy picks the "
+        "entry a full bucket evicts: 'always' (direct-mapped), 'lru' or 'lfu'.")
+        .def(py::init([](size_t capacity, const std::string& policy) {
+            return std::make_shared<EvalCache>(capacity, replacement_policy(policy));
+        }), py::arg("capacity") = 1 << 20, py::arg("policy") = "lru")
+        .def("lookup", [](EvalCache& cache, const ChessBoard& board) -> py::object {
+            Evaluation evaluation;
+            if (!cache.lookup(board.hash(), board.legal_moves().size(), evaluation)) {
+                return py::none();
+            }
+            return py::make_tuple(evaluation.value, py::array_t<float>(evaluation.priors.size(), evaluation.priors.data()));
+        }, py::arg("board"), "Returns (value, priors aligned with legal_moves) if the position is cached, else None")
+        .def("insert", [](EvalCache& cache, const ChessBoard& board, float value, const FloatArray& priors) {
+            if (static_cast<size_t>(priors.size()) != board.legal_moves().size()) {
+                throw std::invalid_argument("priors must have one entry per legal move");
+            }
+            Evaluation evaluation;
+            evaluation.value = value;
+            evaluation.priors.assign(priors.data(), priors.data() + priors.size());
+            cache.insert(board.hash(), evaluation);
+        }, py::arg("board"), py::arg("value"), py::arg("priors"), "Cache an evaluation (priors aligned with legal_moves)")
+        .def("stats", [](const EvalCache& cache) {
+            EvalCacheStats stats = cache.stats();
+            py::dict result;
+            result["lookups"] = stats.lookups;
+            result["hits"] = stats.hits;
+            result["inserts"] = stats.inserts;
+            result["evictions"] = stats.evictions;
+            result["hit_rate"] = stats.hit_rate;
+            result["entries"] = stats.entries;
+            return result;
+        }, "Lookups, hits, hit_rate, inserts, evictions and the number of cached positions")
+        .def("reset_stats", &EvalCache::reset_stats, "Clear the counters")
+        .def("clear", &EvalCache::clear, "Drop every entry (e.g. after loading new weights)")
+        .def_property_readonly("capacity", &EvalCache::capacity);
+
+    // Replay storage
+    py::class_<ShardWriter, std::shared_ptr<ShardWriter>>(m, "ShardWriter",
+        "Appends training records to a binary shard file (created if needed, a record torn by a crash is cut off). "
+        "Pass it to self_play as writer to store games from the worker threads.")
+        .def(py::init<const std::string&>(), py::arg("path"))
+        .def("append", [](ShardWriter& writer, const ChessBoard& board, const std::vector<int>& moves, const std::vector<int>& visits,
+                          int result, uint32_t game, int ply, int game_plies, uint32_t generation) {
+            if (moves.size() != visits.size()) {
+                throw std::invalid_argument("moves and visits must have the same length");
+            }
+            std::vector<std::pair<Move, int>> counts(moves.size());
+            for (size_t i = 0; i < moves.size(); ++i) {
+                if (moves[i] < 0 || moves[i] >= POLICY_SIZE || visits[i] < 0) {
+                    throw std::invalid_argument("moves must be policy indices and visits non-negative");
+                }
+                counts[i] = {policy_index_to_move(moves[i]), visits[i]};
+            }
+            writer.append(pack_position(board), pack_visits(counts), result, game, ply, game_plies, generation);
+        }, py::arg("board"), py::arg("moves"), py::arg("visits"), py::arg("result"), py::arg("game") = 0, py::arg("ply") = 0,
+           py::arg("game_plies") = 0, py::arg("generation") = 0,
+           "Buffer a record: the board, the policy indices of its root moves with their visit counts and the game result "
+           "(1, 0, -1) from the side to move's perspective. Visit counts above 65535 are scaled down like self-play's")
+        .def("flush", &ShardWriter::flush, py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("records", &ShardWriter::records)
+        .def_property_readonly("path", &ShardWriter::path);
+
+    py::class_<SharedReplayBuffer>(m, "ReplayBuffer",
+        "Uniform sampling over the most recent window positions of the *.shard files in a directory, read through memory maps. "
+        "Shards are ordered by file name. Safe to use from several Python threads: refresh() waits for running reads.")
+        .def(py::init([](const std::string& directory, size_t window) {
+            py::gil_scoped_release release;
+            return new SharedReplayBuffer(directory, window);
+        }), py::arg("directory"), py::arg("window") = 1000000)
+        .def("refresh", [](SharedReplayBuffer& shared) {
+            py::gil_scoped_release release;
+            std::unique_lock<std::shared_mutex> write(shared.mutex);
+            return shared.buffer.refresh();
+        }, "Pick up new shards and records and slide the window; returns the number of positions in it. Shard files "
+           "shorter than the shard header are left for a later refresh")
+        .def("__len__", [](const SharedReplayBuffer& shared) {
+            std::shared_lock<std::shared_mutex> read(shared.mutex);
+            return shared.buffer.size();
+        })
+        .def("sample", [](const SharedReplayBuffer& shared, size_t count, py::object seed) {
+            Xoshiro256 rng(seed.is_none() ? (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}() : seed.cast<uint64_t>());
+            std::vector<size_t> indices;
+            {
+                std::shared_lock<std::shared_mutex> read(shared.mutex);
+                indices = shared.buffer.sample(count, rng);
+            }
+            // A refresh() in between can only grow the window or slide it, so the indices stay in range
+            return decode_records(shared, indices);
+        }, py::arg("count"), py::arg("seed") = py::none(),
+           "Draw count positions uniformly (with replacement) as (states (n, 9, 8, 8), policies (n, 4096) visit "
+           "distributions, values (n,))")
+        .def("decode", &decode_records, py::arg("indices"), "Window positions (0 = oldest) in the format of sample")
+        .def("record", [](const SharedReplayBuffer& shared, size_t index) {
+            std::shared_lock<std::shared_mutex> read(shared.mutex);
+            const RecordHeader& header = *shared.buffer.record(index).header;
+            py::dict result;
+            result["game"] = header.game;
+            result["ply"] = header.ply;
+            result["game_plies"] = header.game_plies;
+            result["generation"] = header.generation;
+            result["result"] = header.result;
+            result["visits"] = header.num_visits;
+            return result;
+        }, py::arg("index"), "Metadata of a window position")
+        .def_property_readonly("window", [](const SharedReplayBuffer& shared) { return shared.buffer.window(); })
+        .def_property_readonly("num_shards", [](const SharedReplayBuffer& shared) {
+            std::shared_lock<std::shared_mutex> read(shared.mutex);
+            return shared.buffer.num_shards();
+        });
+
+    py::class_<DataLoader>(m, "DataLoader",
+        "Training batches sampled from the most recent window positions of a shard directory, decoded on background "
+        "threads. Iterating yields (states (batch, 9, 8, 8), policies (batch, 4096), values (batch,)) float32 arrays "
+        "indefinitely. The arrays share a batch buffer of the loader without copying and keep it alive, so they stay valid "
+        "for as long as any of them is referenced; the buffer is only recycled once all three are dropped.")
+        .def(py::init([](const std::string& directory, size_t window, int batch_size, int threads, int prefetch, py::object seed) {
+            LoaderConfig config;
+            config.batch_size = batch_size;
+            config.threads = threads;
+            config.prefetch = prefetch;
+            config.seed = seed.is_none() ? (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}() : seed.cast<uint64_t>();
+            py::gil_scoped_release release;
+            return new DataLoader(directory, window, config);
+        }), py::arg("directory"), py::arg("window") = 1000000, py::arg("batch_size") = 256, py::arg("threads") = 0,
+           py::arg("prefetch") = 8, py::arg("seed") = py::none())
+        .def("__iter__", [](py::object self) { return self; })
+        .def("__next__", [](DataLoader& loader) {
+            std::shared_ptr<const TrainingBatch> batch;
+            {
+                py::gil_scoped_release release;
+                batch = loader.next();
+            }
+            return batch_arrays(std::move(batch));
+        })
+        .def("refresh", &DataLoader::refresh, py::call_guard<py::gil_scoped_release>(),
+             "Pick up positions written since the last refresh and slide the window; returns the number of positions in it")
+        .def("__len__", &DataLoader::size)
+        .def("stats", [](const DataLoader& loader) {
+            LoaderStats stats = loader.stats();
+            py::dict result;
+            result["batches"] = stats.batches;
+            result["positions"] = stats.positions;
+            result["seconds"] = stats.seconds;
+            result["positions_per_second"] = stats.positions_per_second;
+            result["wait_seconds"] = stats.wait_seconds;
+            return result;
+        }, "Batches and positions delivered, their rate, and the time spent waiting for batches (a starved consumer)")
+        .def_property_readonly("batch_size", [](const DataLoader& loader) { return loader.config().batch_size; })
+        .def_property_readonly("threads", [](const DataLoader& loader) { return loader.config().threads; });
+
+    m.def("ingest_pgn", [](const std::string& path, const std::string& out_prefix, int num_threads, uint32_t generation, int min_plies) {
+        IngestConfig config;
+        config.num_threads = num_threads;
+        config.generation = generation;
+        config.min_plies = min_plies;
+        IngestStats stats;
+        {
+            py::gil_scoped_release release;
+            stats = ingest_pgn(path, out_prefix, config);
+        }
+        py::dict result;
+        result["games"] = stats.games;
+        result["positions"] = stats.positions;
+        result["skipped"] = stats.skipped;
+        result["truncated"] = stats.truncated;
+        result["bytes"] = stats.bytes;
+        result["seconds"] = stats.seconds;
+        result["shards"] = stats.shards;
+        return result;
+    }, py::arg("path"), py::arg("out_prefix"), py::arg("num_threads") = 0, py::arg("generation") = 0, py::arg("min_plies") = 1,
+    "Convert the games of a PGN file into training shards <out_prefix>-000.shard, -001.shard, ... (one per thread; one record per position, with the "
+    "move played as a one-hot policy and the game result), splitting the memory-mapped file across threads. Games with an "
+    "unknown result, a custom start position, a variant or an unresolvable move are skipped; games with an underpromotion "
+    "(the engine always promotes to a queen) are kept up to it. Fails if shards with this prefix already exist. "
+    "Returns the games, positions, skipped and truncated counts, bytes read, seconds and shards written");
+
+    // Shared-memory transport between processes
+    py::class_<RecordRing, std::shared_ptr<RecordRing>>(m, "RecordRing",
+        "Single-producer, single-consumer ring of messages in shared memory (/dev/shm), created on first open. "
+        "A self-play process pushes its games (pass it to self_play as writer); the trainer drains them into a shard.")
+        .def(py::init([](const std::string& name, size_t capacity) {
+            return std::make_shared<RecordRing>(name, capacity);
+        }), py::arg("name"), py::arg("capacity") = size_t(64) << 20)
+        .def("push", [](RecordRing& ring, const py::bytes& message, int timeout_ms) {
+            std::string data = message;
+            py::gil_scoped_release release;
+            return ring.push(reinterpret_cast<const uint8_t*>(data.data()), data.size(), timeout_ms);
+        }, py::arg("message"), py::arg("timeout_ms") = -1,
+           "Append a message, waiting up to timeout_ms (forever if negative) for room; returns False on timeout")
+        .def("pop", [](RecordRing& ring) -> py::object {
+            std::vector<uint8_t> message;
+            if (!ring.pop(message)) {
+                return py::none();
+            }
+            return py::bytes(reinterpret_cast<const char*>(message.data()), message.size());
+        }, "Remove the oldest message, or None if the ring is empty")
+        .def("drain", &RecordRing::drain, py::arg("writer"), py::call_guard<py::gil_scoped_release>(),
+             "Append the records of every pending message to a ShardWriter and flush it; returns the number of records")
+        .def("stats", [](const RecordRing& ring) {
+            RingStats stats = ring.stats();
+            py::dict result;
+            result["messages_pushed"] = stats.messages_pushed;
+            result["messages_popped"] = stats.messages_popped;
+            result["bytes_pushed"] = stats.bytes_pushed;
+            result["pending_bytes"] = stats.pending_bytes;
+            result["full_waits"] = stats.full_waits;
+            result["capacity"] = stats.capacity;
+            return result;
+        }, "Messages pushed and popped, bytes pushed and pending, pushes that waited for room, and the capacity")
+        .def_property_readonly("name", &RecordRing::name)
+        .def_static("unlink", &SharedRegion::unlink, py::arg("name"),
+                    "Remove a ring's name (processes that have it open keep using it); returns False if there was none");
+
+    py::class_<WeightSlot>(m, "WeightSlot",
+        "Versioned blob in shared memory guarded by a sequence lock: the trainer publishes each new native export and "
+        "self-play processes load it when its generation changes, without ever blocking the trainer.")
+        .def(py::init<const std::string&, size_t>(), py::arg("name"), py::arg("capacity") = size_t(64) << 20)
+        .def("publish", [](WeightSlot& slot, const py::bytes& blob) {
+            std::string data = blob;
+            py::gil_scoped_release release;
+            return slot.publish(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+        }, py::arg("blob"), "Replace the blob; returns its generation (one process publishes)")
+        .def("publish_file", [](WeightSlot& slot, const std::string& path) {
+            py::gil_scoped_release release;
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("cannot open " + path);
+            }
+            std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            return slot.publish(data.data(), data.size());
+        }, py::arg("path"), "Publish the contents of a file, e.g. written by ChessCNN.export_native(); returns the generation")
+        .def("read", [](const WeightSlot& slot, uint64_t known_generation) -> py::object {
+            std::shared_ptr<const uint8_t> blob;
+            size_t size = 0;
+            uint64_t generation;
+            {
+                py::gil_scoped_release release;
+                generation = slot.read(blob, size, known_generation);
+            }
+            if (generation == 0) {
+                return py::none();
+            }
+            return py::make_tuple(generation, py::bytes(reinterpret_cast<const char*>(blob.get()), size));
+        }, py::arg("known_generation") = 0,
+           "(generation, bytes) if the blob is newer than known_generation, else None (also if a publish has not "
+           "finished within a second, e.g. because its process died)")
+        .def("network", [](const WeightSlot& slot, uint64_t known_generation) -> py::object {
+            std::shared_ptr<Network> network;
+            uint64_t generation;
+            {
+                py::gil_scoped_release release;
+                std::shared_ptr<const uint8_t> blob;
+                size_t size = 0;
+                generation = slot.read(blob, size, known_generation);
+                if (generation != 0) {
+                    network = std::make_shared<Network>(std::move(blob), size);
+                }
+            }
+            if (generation == 0) {
+                return py::none();
+            }
+            return py::make_tuple(generation, network);
+        }, py::arg("known_generation") = 0,
+           "(generation, Network) built from the published export if it is newer than known_generation, else None "
+           "(as for read)")
+        .def_property_readonly("generation", &WeightSlot::generation)
+        .def_property_readonly("capacity", &WeightSlot::capacity)
+        .def_property_readonly("name", &WeightSlot::name)
+        .def_static("unlink", &SharedRegion::unlink, py::arg("name"),
+                    "Remove a slot's name (processes that have it open keep using it); returns False if there was none");
+
+    // Self-play
+    m.def("self_play", [](py::object evaluator, int games, int concurrent_games, int simulations, int batch_size,
+                          float c_puct, int temperature_plies, int max_plies, uint64_t seed, bool early_stop, py::object cache,
+                          py::object on_game, py::object writer, uint32_t generation, int threads) {
+        SelfPlayConfig config;
+        config.games = games;
+        config.concurrent_games = concurrent_games;
+        config.threads = threads;
+        config.simulations = simulations;
+        config.batch_size = batch_size;
+        config.c_puct = c_puct;
+        config.temperature_plies = temperature_plies;
+        config.max_plies = max_plies;
+        config.seed = seed;
+        config.early_stop = early_stop;
+
+        // A plain callable or native network gets its own server so that all games still share batches
+        Evaluator eval;
+        if (!evaluator.is_none() && !py::isinstance<InferenceServer>(evaluator) && !py::isinstance<PlayoutEvaluator>(evaluator)) {
+            std::shared_ptr<InferenceServer> server(new_server(evaluator, concurrent_games * batch_size, std::chrono::microseconds(1000)));
+            eval = server_evaluator(server);
+        } else {
+            eval = python_evaluator(evaluator);
+        }
+        eval = with_cache(std::move(eval), cache);
+
+        std::shared_ptr<ShardWriter> shard;
+        std::shared_ptr<RecordRing> ring;
+        if (py::isinstance<RecordRing>(writer)) {
+            ring = writer.cast<std::shared_ptr<RecordRing>>();
+        } else if (!writer.is_none()) {
+            shard = writer.cast<std::shared_ptr<ShardWriter>>();
+        }
+
+        SelfPlay self_play(std::move(eval), config);
+        SelfPlayStats stats;
+        {
+            py::gil_scoped_release release;
+            stats = self_play.run([&on_game, &shard, &ring, generation](GameRecord& game) {
+                if (shard) {
+                    shard->write_game(game, generation);
+                }
+                if (ring) {
+                    ring->push_game(game, generation);
+                }
+                if (on_game.is_none()) {
+                    return;
+                }
+                py::gil_scoped_acquire acquire;
+                py::ssize_t plies = game.plies;
+                py::array_t<float> states({plies, py::ssize_t(9), py::ssize_t(8), py::ssize_t(8)});
+                py::array_t<float> policies({plies, py::ssize_t(POLICY_SIZE)});
+                float* state_data = states.mutable_data();
+                float* policy_data = policies.mutable_data();
+                for (py::ssize_t i = 0; i < plies; ++i) {
+                    RecordHeader header{};
+                    header.position = game.positions[i];
+                    header.num_visits = static_cast<uint16_t>(game.visits[i].size());
+                    float value;
+                    decode_record({&header, game.visits[i].data()}, state_data + i * STATE_TENSOR_SIZE, policy_data + i * POLICY_SIZE, &value);
+                }
+                py::dict record;
+                record["index"] = game.index;
+                record["outcome"] = game.outcome;
+                record["states"] = states;
+                record["policies"] = policies;
+                record["values"] = py::array_t<float>(game.values.size(), game.values.data());
+                on_game(record);
+            });
+        }
+        py::dict result;
+        result["games"] = stats.games;
+        result["positions"] = stats.positions;
+        result["seconds"] = stats.seconds;
+        result["games_per_hour"] = stats.games_per_hour;
+        result["positions_per_second"] = stats.positions_per_second;
+        result["simulations"] = stats.simulations;
+        result["simulations_saved"] = stats.simulations_saved;
+        result["white_wins"] = stats.white_wins;
+        result["draws"] = stats.draws;
+        result["black_wins"] = stats.black_wins;
+        return result;
+    }, py::arg("evaluator") = py::none(), py::arg("games") = 100, py::arg("concurrent_games") = 64, py::arg("simulations") = 200,
+       py::arg("batch_size") = 8, py::arg("c_puct") = 1.0f, py::arg("temperature_plies") = 30, py::arg("max_plies") = 512,
+       py::arg("seed") = 0, py::arg("early_stop") = false, py::arg("cache") = py::none(),
+       py::arg("on_game") = py::none(), py::arg("writer") = py::none(), py::arg("generation") = 0, py::arg("threads") = 0,
+    "Play games against itself with one native search per concurrent game, sharing network batches across games. "
+    "The concurrent games are shared out among threads workers (0: one per core), each stepping its games in turn and "
+    "evaluating their leaves together. "
+    "evaluator is an InferenceServer, a network callable or native Network (wrapped in a server), a PlayoutEvaluator (to bootstrap "
+    "before a network is trained) or None for uniform priors. "
+    "on_game(record) receives each finished game as a dict with states (plies, 9, 8, 8), policies (plies, 4096) "
+    "visit distributions, values (plies,) outcomes from the side to move's perspective, outcome and index. "
+    "cache is an optional EvalCache shared by all games. "
+    "writer is an optional ShardWriter that stores every game, or RecordRing that sends it to another process, tagged with "
+    "generation, without going through Python. "
+    "With early_stop, searches after the temperature plies end once their most visited move is decided. "
+    "Returns the throughput (games, positions, seconds, games_per_hour, positions_per_second), the "
+    "simulations run and saved and the outcomes (white_wins, draws, black_wins)");
+
+    // Random playouts
+    m.def("playout", [](const ChessBoard& board, int games, int max_plies, uint64_t seed, int num_threads, float capture_bias) {
+        PlayoutConfig config;
+        config.max_plies = max_plies;
+        config.seed = seed;
+        config.num_threads = num_threads;
+        config.capture_bias = capture_bias;
+        PlayoutResult result;
+        {
+            py::gil_scoped_release release;
+            result = playout(board, games, config);
+        }
+        py::dict counts;
+        counts["games"] = result.games;
+        counts["white_wins"] = result.white_wins;
+        counts["draws"] = result.draws;
+        counts["black_wins"] = result.black_wins;
+        counts["unfinished"] = result.unfinished;
+        counts["mean_plies"] = result.mean_plies();
+        counts["mean_decisive_plies"] = result.mean_decisive_plies();
+        counts["score"] = result.score(board.get_turn());
+        counts["seconds"] = result.seconds;
+        return counts;
+    }, py::arg("board"), py::arg("games"), py::arg("max_plies") = 512, py::arg("seed") = 0, py::arg("num_threads") = 0,
+       py::arg("capture_bias") = 0.0f,
+    "Play `games` random games from board (not modified) on num_threads threads (0 = all cores) without the GIL. "
+    "With capture_bias > 0, that fraction of moves takes the most valuable piece on offer when a capture exists. "
+    "Games longer than max_plies count as draws. Returns white_wins, draws, black_wins, unfinished, mean_plies, "
+    "mean_decisive_plies, score (mean outcome for the side to move) and seconds");
+
+    py::class_<PlayoutEvaluator>(m, "PlayoutEvaluator",
+        "Model-free evaluator for MCTS: values are the mean outcome of random playouts from the leaf, priors are uniform")
+        .def(py::init([](int playouts, int max_plies, float capture_bias) {
+            if (playouts < 1) {
+                throw std::invalid_argument("playouts must be at least 1");
+            }
+            return PlayoutEvaluator{playouts, max_plies, capture_bias};
+        }), py::arg("playouts") = 8, py::arg("max_plies") = 200, py::arg("capture_bias") = 0.5f)
+        .def_readonly("playouts", &PlayoutEvaluator::playouts)
+        .def_readonly("max_plies", &PlayoutEvaluator::max_plies)
+        .def_readonly("capture_bias", &PlayoutEvaluator::capture_bias);
+
+    m.def("seed_rng", &seed_thread_rng, py::arg("seed"),
+          "Seed the calling thread's random generator (used by random_move and playouts)");
 
 }
\ No newline at end of file
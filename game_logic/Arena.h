@@ -0,0 +1,125 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+/**
+ * @brief Append-only storage for fixed-size blocks of elements, addressed by a 32-bit index.
+ *
+ * Block must be a struct of arrays with a static constexpr uint32_t SIZE giving the number of
+ * elements per block. Blocks are zero-initialized when created and never move, so elements may be
+ * atomics and indices stay valid while other threads allocate. Allocation is a lock-free bump of a
+ * shared cursor; only creating a new block takes a lock.
+ */
+template <typename Block>
+class ChunkedArena {
+public:
+    static constexpr uint32_t BLOCK_SIZE = Block::SIZE;
+    static constexpr uint32_t MAX_BLOCKS = 1u << 13;
+
+    ChunkedArena() : blocks(new std::atomic<Block*>[MAX_BLOCKS]) {
+        for (uint32_t i = 0; i < MAX_BLOCKS; ++i) {
+            blocks[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~ChunkedArena() {
+        for (uint32_t i = 0; i < MAX_BLOCKS; ++i) {
+            delete blocks[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    ChunkedArena(const ChunkedArena&) = delete;
+    ChunkedArena& operator=(const ChunkedArena&) = delete;
+
+    /**
+     * @brief Reserves count consecutive elements that all lie in the same block.
+     * @param count Number of elements, at most BLOCK_SIZE.
+     * @return Index of the first element. Freshly created blocks are zeroed, but indices handed out
+     * again after clear() keep their old contents, so callers initialize what they allocate.
+     */
+    uint32_t allocate(uint32_t count) {
+        uint64_t current = cursor.load(std::memory_order_relaxed);
+        uint64_t start;
+        do {
+            start = current;
+            if ((start % BLOCK_SIZE) + count > BLOCK_SIZE) {
+                start += BLOCK_SIZE - (start % BLOCK_SIZE); // Would straddle two blocks; skip to the next one
+            }
+        } while (!cursor.compare_exchange_weak(current, start + count, std::memory_order_relaxed));
+
+        uint64_t block = start / BLOCK_SIZE;
+        if (block >= MAX_BLOCKS) {
+            throw std::bad_alloc();
+        }
+        if (blocks[block].load(std::memory_order_acquire) == nullptr) {
+            std::lock_guard<std::mutex> lock(grow_mutex);
+            if (blocks[block].load(std::memory_order_relaxed) == nullptr) {
+                blocks[block].store(new Block(), std::memory_order_release);
+                allocated_blocks.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        return static_cast<uint32_t>(start);
+    }
+
+    /**
+     * @brief Returns the block holding the given index.
+     */
+    Block& block(uint32_t index) const {
+        return *blocks[index / BLOCK_SIZE].load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Returns the position of the given index inside its block.
+     */
+    static uint32_t slot(uint32_t index) {
+        return index % BLOCK_SIZE;
+    }
+
+    /**
+     * @brief Number of indices handed out so far (including padding skipped at block ends).
+     */
+    uint64_t size() const {
+        return cursor.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Bytes of block storage currently held.
+     */
+    size_t memory_bytes() const {
+        return allocated_blocks.load(std::memory_order_relaxed) * sizeof(Block);
+    }
+
+    /**
+     * @brief Forgets all allocations but keeps the blocks for reuse. Not thread-safe.
+     */
+    void clear() {
+        cursor.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Swaps contents with another arena. Not thread-safe.
+     */
+    void swap(ChunkedArena& other) {
+        blocks.swap(other.blocks);
+        uint64_t c = cursor.load();
+        cursor.store(other.cursor.load());
+        other.cursor.store(c);
+        size_t a = allocated_blocks.load();
+        allocated_blocks.store(other.allocated_blocks.load());
+        other.allocated_blocks.store(a);
+    }
+
+private:
+    std::unique_ptr<std::atomic<Block*>[]> blocks;
+    std::atomic<uint64_t> cursor{0};
+    std::atomic<size_t> allocated_blocks{0};
+    std::mutex grow_mutex;
+};
+
+#endif // ARENA_H
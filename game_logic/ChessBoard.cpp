@@ -68,7 +68,6 @@ ChessBoard::ChessBoard() {
     can_castle_queen_side = false;
     _en_passant_valid = false;
     state_tensor = std::vector<float>(9 * 8 * 8, 0.0f); // Initialize state tensor
-    policy_mask = std::vector<float>(8 * 8 * 8 * 8, 0.0f); // Initialize policy mask
     this->valid_moves = get_valid_moves();
 }
 
@@ -82,19 +81,22 @@ ChessBoard::~ChessBoard() {
 
 ChessBoard::ChessBoard(const ChessBoard& other) {
     _turn = other._turn;
-    last_piece = other.last_piece ? copy_piece(other.last_piece) : nullptr;
     last_move = other.last_move;
     _game_over = other._game_over;
     fifty_move_rule_counter = other.fifty_move_rule_counter;
     outcome = other.outcome;
+    can_castle_king_side = other.can_castle_king_side;
+    can_castle_queen_side = other.can_castle_queen_side;
+    _en_passant_valid = other._en_passant_valid;
 
     for (int i = 0; i < 8; ++i) {
         for (int j = 0; j < 8; ++j) {
             _board[i][j] = copy_piece(other._board[i][j]);
         }
     }
+    // last_piece points into the board (it is the piece that made last_move), so re-point it at our copy
+    last_piece = other.last_piece ? _board[last_move.to.x][last_move.to.y] : nullptr;
     valid_moves = other.valid_moves;
-    policy_mask = other.policy_mask;
     state_tensor = other.state_tensor;
 }
 
@@ -108,14 +110,15 @@ ChessBoard& ChessBoard::operator=(const ChessBoard& other) {
         }
 
         _turn = other._turn;
-        delete last_piece;
-        last_piece = other.last_piece ? copy_piece(other.last_piece) : nullptr;
         last_move = other.last_move;
+        last_piece = other.last_piece ? _board[last_move.to.x][last_move.to.y] : nullptr;
         _game_over = other._game_over;
         fifty_move_rule_counter = other.fifty_move_rule_counter;
         outcome = other.outcome;
+        can_castle_king_side = other.can_castle_king_side;
+        can_castle_queen_side = other.can_castle_queen_side;
+        _en_passant_valid = other._en_passant_valid;
         valid_moves = other.valid_moves;
-        policy_mask = other.policy_mask;
         state_tensor = other.state_tensor;
     }
     return *this;
@@ -226,7 +229,6 @@ bool ChessBoard::position_safe_after_move(Piece* piece, const Coords& from, cons
 std::vector<Move> ChessBoard::get_valid_moves() {
     // Clear previous state
     valid_moves.clear();
-    policy_mask.assign(8 * 8 * 8 * 8, 0.0f);
     state_tensor.assign(9 * 8 * 8, 0.0f);
     can_castle_king_side = false;
     can_castle_queen_side = false;
@@ -289,10 +291,6 @@ std::vector<Move> ChessBoard::get_valid_moves() {
                 auto add_move_if_valid = [&](const Coords& from, const Coords& to) {
                     if (position_safe_after_move(piece, from, to)) {
                         valid_moves.push_back(Move(from, to));
-                        size_t index = (from.x * 8 * 8 * 8) + (from.y * 8 * 8) + (to.x * 8) + to.y;
-                        if (index < policy_mask.size()) {
-                            policy_mask[index] = 1.0f;
-                        }
                     }
                 };
 
@@ -317,19 +315,16 @@ std::vector<Move> ChessBoard::get_valid_moves() {
             if (piece_type == 'k') {
                 if (can_castle(static_cast<King*>(piece), true)) {
                     valid_moves.push_back(Move(Coords(rank, file), Coords(rank, file + 2)));
-                    policy_mask[(rank * 8 * 8 * 8) + (file * 8 * 8) + (rank * 8) + (file + 2)] = 1.0f;
                     can_castle_king_side = true;
                 }
                 if (can_castle(static_cast<King*>(piece), false)) {
                     valid_moves.push_back(Move(Coords(rank, file), Coords(rank, file - 2)));
-                    policy_mask[(rank * 8 * 8 * 8) + (file * 8 * 8) + (rank * 8) + (file - 2)] = 1.0f;
                     can_castle_queen_side = true;
                 }
             } else if (piece_type == 'p') {
                 if (can_en_passant(static_cast<Pawn*>(piece), Coords(rank, file))) {
                     int en_passant_x = (_turn == Color::WHITE) ? rank + 1 : rank - 1;
                     valid_moves.push_back(Move(Coords(rank, file), Coords(en_passant_x, last_move.to.y)));
-                    policy_mask[(rank * 8 * 8 * 8) + (file * 8 * 8) + (en_passant_x * 8) + last_move.to.y] = 1.0f;
                     _en_passant_valid = true;
                 }
             }
@@ -352,6 +347,10 @@ std::vector<Move> ChessBoard::get_valid_moves() {
     return valid_moves;
 }
 
+const std::vector<Move>& ChessBoard::legal_moves() const {
+    return valid_moves;
+}
+
 bool ChessBoard::is_game_over() const {
     return _game_over;
 }
@@ -449,6 +448,15 @@ bool ChessBoard::make_move(const Move& move) {
         return false;
     }
 
+    play_unchecked(move);
+    refresh();
+
+    return true;
+}
+
+void ChessBoard::play_unchecked(const Move& move) {
+    Piece* piece = _board[move.from.x][move.from.y];
+
     if (_board[move.to.x][move.to.y] != nullptr || piece->get_type() == 'p') {
         fifty_move_rule_counter = 0;
     } else {
@@ -469,12 +477,13 @@ bool ChessBoard::make_move(const Move& move) {
     }
 
     _turn = (_turn == Color::WHITE) ? Color::BLACK : Color::WHITE;
-    last_piece = piece;
+    last_piece = _board[move.to.x][move.to.y]; // After promotion this is the new queen, not the deleted pawn
     last_move = move;
+}
+
+void ChessBoard::refresh() {
     valid_moves = get_valid_moves();
     check_game_over();
-
-    return true;
 }
 
 std::vector<std::vector<char>> ChessBoard::get_board_state_chars() const {
@@ -564,17 +573,88 @@ void ChessBoard::handle_special_move(Piece* piece, const Coords& from, const Coo
 }
 
 Move ChessBoard::random_move() {
-        if (valid_moves.empty()) {
-            return Move(Coords(-1, -1), Coords(-1, -1)); // No valid moves
-        }
-        int random_index = rand() % valid_moves.size();
-        return valid_moves[random_index];
+    return random_move(thread_rng());
+}
+
+Move ChessBoard::random_move(Xoshiro256& rng) const {
+    if (valid_moves.empty()) {
+        return Move(Coords(-1, -1), Coords(-1, -1)); // No valid moves
+    }
+    return valid_moves[rng.bounded(static_cast<uint32_t>(valid_moves.size()))];
 }
 
 std::vector<float> ChessBoard::get_state_tensor() {
     return state_tensor;
 }
 
+void ChessBoard::copy_state_tensor(float* out) const {
+    std::copy(state_tensor.begin(), state_tensor.end(), out);
+}
+
 std::vector<float> ChessBoard::get_policy_mask() {
+    std::vector<float> policy_mask(8 * 8 * 8 * 8, 0.0f);
+    for (const Move& move : valid_moves) {
+        policy_mask[(move.from.x * 8 * 8 * 8) + (move.from.y * 8 * 8) + (move.to.x * 8) + move.to.y] = 1.0f;
+    }
     return policy_mask;
-}
\ No newline at end of file
+}
+// Random keys for hash(): 12 piece kinds x 64 squares, then side to move, 4 castling rights,
+// 8 en passant files and the fifty-move counter values near the limit
+static const uint64_t* zobrist_keys() {
+    static const std::vector<uint64_t> keys = [] {
+        Xoshiro256 rng(0x5EED);
+        std::vector<uint64_t> k(12 * 64 + 1 + 4 + 8 + 101);
+        for (uint64_t& key : k) {
+            key = rng.next();
+        }
+        return k;
+    }();
+    return keys.data();
+}
+
+uint64_t ChessBoard::hash() const {
+    static const std::string piece_types = "pnbrqk";
+    const uint64_t* keys = zobrist_keys();
+    const uint64_t* side_key = keys + 12 * 64;
+    const uint64_t* castle_keys = side_key + 1;
+    const uint64_t* en_passant_keys = castle_keys + 4;
+    const uint64_t* fifty_move_keys = en_passant_keys + 8;
+
+    uint64_t h = 0;
+    for (int rank = 0; rank < 8; ++rank) {
+        for (int file = 0; file < 8; ++file) {
+            const Piece* piece = _board[rank][file];
+            if (piece != nullptr) {
+                int kind = static_cast<int>(piece_types.find(piece->get_type())) + (piece->get_color() == Color::WHITE ? 0 : 6);
+                h ^= keys[kind * 64 + rank * 8 + file];
+            }
+        }
+    }
+    if (_turn == Color::BLACK) {
+        h ^= *side_key;
+    }
+
+    // Castling rights: unmoved king and rook on their home squares
+    for (int side = 0; side < 2; ++side) {
+        int rank = side == 0 ? 0 : 7;
+        const Piece* king = _board[rank][4];
+        if (king == nullptr || king->get_type() != 'k' || king->get_has_moved()) {
+            continue;
+        }
+        for (int wing = 0; wing < 2; ++wing) {
+            const Piece* rook = _board[rank][wing == 0 ? 7 : 0];
+            if (rook != nullptr && rook->get_type() == 'r' && rook->get_color() == king->get_color() && !rook->get_has_moved()) {
+                h ^= castle_keys[side * 2 + wing];
+            }
+        }
+    }
+
+    // Only an en passant capture that is actually available changes the position
+    if (_en_passant_valid) {
+        h ^= en_passant_keys[last_move.to.y];
+    }
+    if (fifty_move_rule_counter >= 100 - FIFTY_MOVE_HASH_WINDOW) {
+        h ^= fifty_move_keys[std::min(fifty_move_rule_counter, 100)];
+    }
+    return h;
+}
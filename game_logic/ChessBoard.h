@@ -3,6 +3,7 @@
 
 #include "Piece.h"
 #include "types.h"
+#include "Random.h"
 #include <vector>
 #include <map>
 #include <string>
@@ -12,6 +13,16 @@ class Rook;
 class King;
 
 
+/**
+ * @brief Chess position with move generation and game-over detection.
+ *
+ * Thread safety: a ChessBoard holds no global or shared state, so distinct boards can be used
+ * from different threads at the same time without locking (the Python bindings release the GIL
+ * for the expensive calls to allow exactly that). A single board is NOT safe to share between
+ * threads: even queries like get_valid_moves() rewrite internal caches. Give each thread its
+ * own board, e.g. via clone(). Concurrent calls to const member functions (clone(),
+ * legal_moves(), copy_state_tensor(), ...) on one board are fine as long as nobody modifies it.
+ */
 class ChessBoard {
 public:
     /**
@@ -83,6 +94,12 @@ public:
      */
     std::vector<Move> get_valid_moves();
 
+    /**
+     * @brief Returns the legal moves cached for the current position without regenerating them.
+     * The order matches get_valid_moves(); the reference stays valid until the board changes.
+     */
+    const std::vector<Move>& legal_moves() const;
+
     /**
      * @brief Checks if the game has ended (checkmate, stalemate, etc.).
      * @return True if the game is over, false otherwise.
@@ -119,6 +136,20 @@ public:
      */
     bool make_move(const Move& move);
 
+    /**
+     * @brief Plays a move without checking it or regenerating the legal moves.
+     * Meant for replaying moves already known to be legal (e.g. a search path from the root): the
+     * expensive move generation is skipped, so call refresh() once after the last move before
+     * using legal_moves(), the state tensor or the game-over status.
+     * @param move A legal move in the current position.
+     */
+    void play_unchecked(const Move& move);
+
+    /**
+     * @brief Regenerates the legal moves, state tensor and game-over status after play_unchecked().
+     */
+    void refresh();
+
     /**
      * @brief Returns the board state as a 2D vector of characters (FEN notation).
      * @return An 8x8 vector of chars representing the pieces on the board.
@@ -127,11 +158,20 @@ public:
 
     /**
      * @brief Generates a random legal move for the current player.
+     * Draws from the calling thread's generator (see thread_rng() in Random.h), so concurrent
+     * callers on different boards neither race nor disturb each other's sequences.
      * @return A Move object representing a random legal move.
-     * If no legal moves are available, returns a default Move object (from(0,0) to(0,0)).
+     * If no legal moves are available, returns Move(-1, -1, -1, -1).
      * This function is useful for AI simulations or testing purposes.
      */
-    Move random_move(); 
+    Move random_move();
+
+    /**
+     * @brief Generates a random legal move using the given generator.
+     * @param rng The generator to draw from, for callers that manage their own seeded streams.
+     * @return A random legal move, or Move(-1, -1, -1, -1) if there is none.
+     */
+    Move random_move(Xoshiro256& rng) const;
 
     /**
      * Returns a tensor representation of the current board state relative to the current player's perspective.
@@ -149,21 +189,42 @@ public:
      */
     std::vector<float> get_state_tensor();
 
+    /**
+     * @brief Copies the state tensor (see get_state_tensor()) into a caller-provided buffer.
+     * Unlike get_state_tensor() this does not allocate, which suits filling network input batches.
+     * @param out Buffer of at least 9 * 8 * 8 floats.
+     */
+    void copy_state_tensor(float* out) const;
+
     /**
      * @brief Returns a policy mask for the current player's valid moves.
      * The policy mask is of size 8x8x8x8 (from_row, from_col, to_row, to_col), flattened.
-     * Each entry is 1.0 if the move is valid, 0.0 otherwise.
+     * Each entry is 1.0 if the move is valid, 0.0 otherwise. Built on demand from the legal moves.
      */
     std::vector<float> get_policy_mask();
 
+    /**
+     * @brief Number of plies before the fifty-move draw within which hash() also encodes the counter.
+     */
+    static constexpr int FIFTY_MOVE_HASH_WINDOW = 20;
+
+    /**
+     * @brief Returns a 64-bit Zobrist key of the position.
+     * Covers the pieces, the side to move, castling rights and an available en passant capture, so
+     * equal keys mean the same legal moves and outcome. The fifty-move counter is only included once
+     * it is within FIFTY_MOVE_HASH_WINDOW plies of the draw, where it can change the result; further
+     * out, positions that differ only in the counter share a key. Valid after the legal moves have
+     * been generated (make_move() or refresh()).
+     */
+    uint64_t hash() const;
+
     Piece* _board[8][8]; // 8x8 board of pieces
 
 private:
     Color _turn;         // Current turn (WHITE or BLACK)
     std::vector<Move> valid_moves; // List of valid moves for the current turn
-    std::vector<float> policy_mask; // Placeholder for policy mask, currently empty
     std::vector<float> state_tensor; // Placeholder for state tensor, currently empty
-    Piece* last_piece;
+    Piece* last_piece;   // Piece that made last_move (points into _board, not owned)
     Move last_move;
     bool _game_over;
     int fifty_move_rule_counter = 0;
@@ -0,0 +1,62 @@
+#ifndef CPU_H
+#define CPU_H
+
+/**
+ * @brief Runtime CPU feature checks for the hand-vectorized kernels.
+ * Kernels are compiled with per-function target attributes and chosen at run time, so one build
+ * runs everywhere and uses the widest instructions the machine has. Each check is evaluated once.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHESS_X86 1
+#endif
+
+/**
+ * @brief True if the CPU has AVX2 and F16C (8-wide float math and fp16 conversion).
+ */
+inline bool cpu_has_avx2() {
+#ifdef CHESS_X86
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief True if the CPU has AVX2 and FMA (fused multiply-add on 8 floats).
+ */
+inline bool cpu_has_avx2_fma() {
+#ifdef CHESS_X86
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief True if the CPU has AVX-512F (16-wide float math).
+ */
+inline bool cpu_has_avx512() {
+#ifdef CHESS_X86
+    static const bool supported = __builtin_cpu_supports("avx512f");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief True if the CPU has AVX-512 VNNI (8-bit integer dot products accumulated into 32 bits).
+ */
+inline bool cpu_has_avx512_vnni() {
+#ifdef CHESS_X86
+    static const bool supported = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#endif // CPU_H
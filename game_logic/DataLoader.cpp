@@ -0,0 +1,149 @@
+#include "DataLoader.h"
+#include "Policy.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+static long long now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+DataLoader::DataLoader(const std::string& directory, size_t window, LoaderConfig config)
+    : buffer(directory, window), settings(config), pool(std::make_shared<Pool>()) {
+    if (settings.batch_size < 1 || settings.prefetch < 1) {
+        throw std::invalid_argument("batch_size and prefetch must be at least 1");
+    }
+    if (buffer.size() == 0) {
+        throw std::invalid_argument("no training positions in " + directory);
+    }
+    if (settings.threads <= 0) {
+        settings.threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    start_ns = now_ns();
+    for (int t = 0; t < settings.threads; ++t) {
+        workers.emplace_back(&DataLoader::work, this, t);
+    }
+}
+
+DataLoader::~DataLoader() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    space_cv.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::unique_ptr<TrainingBatch> DataLoader::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (!pool->free.empty()) {
+            std::unique_ptr<TrainingBatch> batch = std::move(pool->free.back());
+            pool->free.pop_back();
+            return batch;
+        }
+    }
+    auto batch = std::make_unique<TrainingBatch>();
+    batch->size = settings.batch_size;
+    batch->states.resize(static_cast<size_t>(settings.batch_size) * STATE_TENSOR_SIZE);
+    batch->policies.resize(static_cast<size_t>(settings.batch_size) * POLICY_SIZE);
+    batch->values.resize(settings.batch_size);
+    return batch;
+}
+
+void DataLoader::work(int thread) {
+    Xoshiro256 rng(settings.seed + static_cast<uint64_t>(thread));
+    try {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                if (stopping) {
+                    return;
+                }
+            }
+
+            std::unique_ptr<TrainingBatch> batch = acquire();
+            {
+                // Wait out a pending refresh() so that a stream of readers cannot starve it
+                { std::lock_guard<std::mutex> turn(refresh_mutex); }
+                std::shared_lock<std::shared_mutex> read(buffer_mutex);
+                std::vector<size_t> indices = buffer.sample(batch->size, rng);
+                for (int i = 0; i < batch->size; ++i) {
+                    decode_record(buffer.record(indices[i]), batch->states.data() + static_cast<size_t>(i) * STATE_TENSOR_SIZE,
+                                  batch->policies.data() + static_cast<size_t>(i) * POLICY_SIZE, batch->values.data() + i);
+                }
+            }
+
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            space_cv.wait(lock, [this] { return stopping || ready.size() < static_cast<size_t>(settings.prefetch); });
+            if (stopping) {
+                return;
+            }
+            ready.push_back(std::move(batch));
+            ready_cv.notify_one();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+        ready_cv.notify_all();
+    }
+}
+
+std::shared_ptr<const TrainingBatch> DataLoader::next() {
+    std::unique_ptr<TrainingBatch> batch;
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (ready.empty() && !error) {
+            long long start = now_ns();
+            ready_cv.wait(lock, [this] { return !ready.empty() || error; });
+            wait_total += (now_ns() - start) * 1e-9;
+        }
+        if (ready.empty()) {
+            std::rethrow_exception(error);
+        }
+        batch = std::move(ready.front());
+        ready.pop_front();
+        batches_out++;
+    }
+    space_cv.notify_one();
+
+    // The batch goes back to the pool once the caller is done with it, even if the loader is gone by then
+    std::shared_ptr<Pool> owner = pool;
+    return std::shared_ptr<const TrainingBatch>(batch.release(), [owner](const TrainingBatch* done) {
+        std::lock_guard<std::mutex> lock(owner->mutex);
+        owner->free.emplace_back(const_cast<TrainingBatch*>(done));
+    });
+}
+
+size_t DataLoader::refresh() {
+    std::lock_guard<std::mutex> turn(refresh_mutex);
+    std::unique_lock<std::shared_mutex> write(buffer_mutex);
+    return buffer.refresh();
+}
+
+size_t DataLoader::size() const {
+    std::shared_lock<std::shared_mutex> read(buffer_mutex);
+    return buffer.size();
+}
+
+LoaderStats DataLoader::stats() const {
+    LoaderStats stats;
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    stats.batches = batches_out;
+    stats.positions = batches_out * settings.batch_size;
+    stats.seconds = (now_ns() - start_ns) * 1e-9;
+    stats.wait_seconds = wait_total;
+    if (stats.seconds > 0.0) {
+        stats.positions_per_second = stats.positions / stats.seconds;
+    }
+    return stats;
+}
+
+const LoaderConfig& DataLoader::config() const {
+    return settings;
+}
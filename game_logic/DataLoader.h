@@ -0,0 +1,115 @@
+#ifndef DATA_LOADER_H
+#define DATA_LOADER_H
+
+#include "Replay.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Settings for a DataLoader.
+ */
+struct LoaderConfig {
+    int batch_size = 256;
+    int threads = 0;                // Decoding threads (0 = one per core)
+    int prefetch = 8;               // Ready batches queued ahead of the consumer
+    uint64_t seed = 0;              // Thread t samples from a generator seeded with seed + t
+};
+
+/**
+ * @brief A training batch in contiguous buffers, ready to hand to the network.
+ */
+struct TrainingBatch {
+    int size = 0;
+    std::vector<float> states;      // size x STATE_TENSOR_SIZE
+    std::vector<float> policies;    // size x POLICY_SIZE visit distributions
+    std::vector<float> values;      // size game results from the side to move's perspective
+};
+
+/**
+ * @brief Throughput of a DataLoader.
+ */
+struct LoaderStats {
+    long long batches = 0;          // Batches handed to the consumer
+    long long positions = 0;
+    double seconds = 0.0;           // Since the loader started
+    double positions_per_second = 0.0;
+    double wait_seconds = 0.0;      // Time next() spent waiting for a batch, i.e. the consumer was starved
+};
+
+/**
+ * @brief Samples training batches from a ReplayBuffer on background threads.
+ *
+ * Each thread draws positions uniformly from the buffer's window, decodes them with unpack_state()
+ * and densifies their visit counts into policy targets, and queues the finished batch. At most
+ * config.prefetch batches wait in the queue; threads block once it is full. Batch buffers are
+ * recycled: a batch returns to the loader's pool when the last reference from next() is dropped,
+ * so steady-state loading allocates no new batches.
+ */
+class DataLoader {
+public:
+    /**
+     * @param directory Shard directory (see ReplayBuffer).
+     * @param window Number of most recent positions to sample from.
+     * @throws std::invalid_argument if the settings are invalid or the directory holds no positions.
+     */
+    DataLoader(const std::string& directory, size_t window, LoaderConfig config);
+    ~DataLoader();
+
+    DataLoader(const DataLoader&) = delete;
+    DataLoader& operator=(const DataLoader&) = delete;
+
+    /**
+     * @brief Returns the next batch, waiting for one if none is ready. Batches are sampled
+     * indefinitely; an exception raised by a loading thread is rethrown here.
+     */
+    std::shared_ptr<const TrainingBatch> next();
+
+    /**
+     * @brief Picks up positions written since the last refresh and slides the window. Loading
+     * threads pause while the buffer is remapped.
+     * @return Positions in the window.
+     */
+    size_t refresh();
+
+    size_t size() const;
+    LoaderStats stats() const;
+    const LoaderConfig& config() const;
+
+private:
+    // Recycled batch buffers, shared with the batches handed out so they can outlive the loader
+    struct Pool {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<TrainingBatch>> free;
+    };
+
+    ReplayBuffer buffer;
+    LoaderConfig settings;
+    mutable std::shared_mutex buffer_mutex;     // Shared by loading threads, exclusive for refresh()
+    std::mutex refresh_mutex;                   // Held by refresh() to keep new readers out
+    std::shared_ptr<Pool> pool;
+
+    mutable std::mutex queue_mutex;
+    std::condition_variable ready_cv;           // A batch was queued (or a thread failed)
+    std::condition_variable space_cv;           // The consumer took a batch (or the loader is stopping)
+    std::deque<std::unique_ptr<TrainingBatch>> ready;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    long long batches_out = 0;
+    double wait_total = 0.0;
+    long long start_ns = 0;
+    std::vector<std::thread> workers;
+
+    void work(int thread);
+    std::unique_ptr<TrainingBatch> acquire();
+};
+
+#endif // DATA_LOADER_H
@@ -0,0 +1,160 @@
+#include "EvalCache.h"
+#include "Half.h"
+#include <algorithm>
+
+EvalCache::EvalCache(size_t capacity, ReplacementPolicy policy)
+    : replacement(policy),
+      buckets(std::max<size_t>(1, (capacity + SHARDS * WAYS - 1) / (SHARDS * WAYS))),
+      shards(new Shard[SHARDS]) {
+    for (int s = 0; s < SHARDS; ++s) {
+        shards[s].entries.resize(buckets * WAYS);
+    }
+}
+
+EvalCache::Shard& EvalCache::shard_of(uint64_t key) const {
+    return shards[key >> 58]; // Top 6 bits pick the shard, the low bits the bucket
+}
+
+EvalCache::Entry* EvalCache::bucket_of(Shard& shard, uint64_t key) const {
+    return shard.entries.data() + (key % buckets) * WAYS;
+}
+
+bool EvalCache::lookup(uint64_t key, size_t num_moves, Evaluation& result) {
+    lookup_count.fetch_add(1, std::memory_order_relaxed);
+    Shard& shard = shard_of(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry* bucket = bucket_of(shard, key);
+    for (int w = 0; w < WAYS; ++w) {
+        Entry& entry = bucket[w];
+        if (entry.used && entry.key == key && entry.priors.size() == num_moves) {
+            entry.last_use = ++shard.clock;
+            entry.hits++;
+            result.value = entry.value;
+            result.priors.resize(num_moves);
+            for (size_t i = 0; i < num_moves; ++i) {
+                result.priors[i] = half_to_float(entry.priors[i]);
+            }
+            hit_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void EvalCache::insert(uint64_t key, const Evaluation& evaluation) {
+    insert_count.fetch_add(1, std::memory_order_relaxed);
+    Shard& shard = shard_of(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry* bucket = bucket_of(shard, key);
+
+    Entry* target = nullptr;
+    for (int w = 0; w < WAYS && !target; ++w) {
+        if (bucket[w].used && bucket[w].key == key) {
+            target = &bucket[w]; // Re-evaluated (e.g. by two threads at once): refresh it
+        }
+    }
+    if (!target) {
+        if (replacement == ReplacementPolicy::ALWAYS) {
+            target = &bucket[(key >> 32) % WAYS];
+        } else {
+            for (int w = 0; w < WAYS && !target; ++w) {
+                if (!bucket[w].used) {
+                    target = &bucket[w];
+                }
+            }
+            if (!target) {
+                target = bucket;
+                for (int w = 1; w < WAYS; ++w) {
+                    Entry& entry = bucket[w];
+                    bool better = replacement == ReplacementPolicy::LRU
+                        ? entry.last_use < target->last_use
+                        : entry.hits < target->hits || (entry.hits == target->hits && entry.last_use < target->last_use);
+                    if (better) {
+                        target = &entry;
+                    }
+                }
+            }
+        }
+        if (target->used) {
+            eviction_count.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            shard.used++;
+        }
+        target->hits = 0;
+    }
+
+    target->used = true;
+    target->key = key;
+    target->value = evaluation.value;
+    target->last_use = ++shard.clock;
+    target->priors.resize(evaluation.priors.size()); // Keeps its capacity, so a warm cache does not allocate
+    for (size_t i = 0; i < evaluation.priors.size(); ++i) {
+        target->priors[i] = float_to_half(evaluation.priors[i]);
+    }
+}
+
+EvalCacheStats EvalCache::stats() const {
+    EvalCacheStats stats;
+    stats.lookups = lookup_count.load();
+    stats.hits = hit_count.load();
+    stats.inserts = insert_count.load();
+    stats.evictions = eviction_count.load();
+    stats.hit_rate = stats.lookups > 0 ? static_cast<double>(stats.hits) / stats.lookups : 0.0;
+    for (int s = 0; s < SHARDS; ++s) {
+        std::lock_guard<std::mutex> lock(shards[s].mutex);
+        stats.entries += shards[s].used;
+    }
+    return stats;
+}
+
+void EvalCache::reset_stats() {
+    lookup_count.store(0);
+    hit_count.store(0);
+    insert_count.store(0);
+    eviction_count.store(0);
+}
+
+void EvalCache::clear() {
+    for (int s = 0; s < SHARDS; ++s) {
+        std::lock_guard<std::mutex> lock(shards[s].mutex);
+        for (Entry& entry : shards[s].entries) {
+            entry.used = false;
+            entry.hits = 0;
+        }
+        shards[s].used = 0;
+    }
+}
+
+size_t EvalCache::capacity() const {
+    return buckets * WAYS * SHARDS;
+}
+
+ReplacementPolicy EvalCache::policy() const {
+    return replacement;
+}
+
+Evaluator cached_evaluator(Evaluator evaluator, std::shared_ptr<EvalCache> cache) {
+    return [evaluator, cache](const std::vector<const ChessBoard*>& boards, std::vector<Evaluation>& results) {
+        std::vector<const ChessBoard*> misses;
+        std::vector<size_t> miss_index;
+        std::vector<uint64_t> keys(boards.size());
+        for (size_t i = 0; i < boards.size(); ++i) {
+            keys[i] = boards[i]->hash();
+            if (!cache->lookup(keys[i], boards[i]->legal_moves().size(), results[i])) {
+                misses.push_back(boards[i]);
+                miss_index.push_back(i);
+            }
+        }
+        if (misses.empty()) {
+            return;
+        }
+
+        std::vector<Evaluation> evaluated(misses.size());
+        evaluator(misses, evaluated);
+        for (size_t m = 0; m < misses.size(); ++m) {
+            size_t i = miss_index[m];
+            cache->insert(keys[i], evaluated[m]);
+            results[i] = std::move(evaluated[m]);
+        }
+    };
+}
@@ -0,0 +1,118 @@
+#ifndef EVAL_CACHE_H
+#define EVAL_CACHE_H
+
+#include "ChessBoard.h"
+#include "MCTS.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Which entry of a full bucket a new evaluation replaces.
+ */
+enum class ReplacementPolicy {
+    ALWAYS,     // The slot the key maps to, whatever it holds (direct-mapped; cheapest)
+    LRU,        // The least recently used entry
+    LFU,        // The entry with the fewest hits (ties: least recently used), so frequent openings stay cached
+};
+
+/**
+ * @brief Counters of an EvalCache since construction or reset_stats().
+ */
+struct EvalCacheStats {
+    long long lookups = 0;
+    long long hits = 0;
+    long long inserts = 0;
+    long long evictions = 0;        // Inserts that replaced a different position
+    double hit_rate = 0.0;          // hits / lookups
+    size_t entries = 0;             // Positions currently cached
+};
+
+/**
+ * @brief Fixed-size cache of network evaluations keyed by position hash (ChessBoard::hash()).
+ *
+ * Entries hold the value and the priors over the legal moves in half precision. The table is split
+ * into shards, each guarded by its own mutex that is only held to copy an entry in or out, so
+ * searches on many threads rarely contend. Within a shard a key maps to a bucket of WAYS entries;
+ * when the bucket is full the replacement policy picks the entry to evict. Thread-safe.
+ */
+class EvalCache {
+public:
+    static constexpr int SHARDS = 64;
+    static constexpr int WAYS = 4;
+
+    /**
+     * @param capacity Number of positions to hold (rounded up to a whole number of buckets per shard).
+     * @param policy Replacement policy for full buckets.
+     */
+    explicit EvalCache(size_t capacity, ReplacementPolicy policy = ReplacementPolicy::LRU);
+
+    EvalCache(const EvalCache&) = delete;
+    EvalCache& operator=(const EvalCache&) = delete;
+
+    /**
+     * @brief Looks a position up.
+     * @param key Position hash.
+     * @param num_moves Number of legal moves of the position; an entry with a different count is
+     * treated as a hash collision and missed.
+     * @param result Receives the cached value and priors on a hit.
+     * @return Whether the position was cached.
+     */
+    bool lookup(uint64_t key, size_t num_moves, Evaluation& result);
+
+    /**
+     * @brief Stores an evaluation, replacing an older entry if the bucket is full.
+     */
+    void insert(uint64_t key, const Evaluation& evaluation);
+
+    EvalCacheStats stats() const;
+    void reset_stats();
+
+    /**
+     * @brief Drops every entry (e.g. after loading new network weights).
+     */
+    void clear();
+
+    size_t capacity() const;
+    ReplacementPolicy policy() const;
+
+private:
+    struct Entry {
+        uint64_t key = 0;
+        float value = 0.0f;
+        uint32_t last_use = 0;          // Shard clock at the last lookup hit or insert
+        uint32_t hits = 0;
+        bool used = false;
+        std::vector<uint16_t> priors;   // Half precision, aligned with the position's legal moves
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::vector<Entry> entries;     // buckets * WAYS
+        uint32_t clock = 0;
+        size_t used = 0;
+    };
+
+    ReplacementPolicy replacement;
+    size_t buckets;                     // Per shard
+    std::unique_ptr<Shard[]> shards;
+
+    std::atomic<long long> lookup_count{0};
+    std::atomic<long long> hit_count{0};
+    std::atomic<long long> insert_count{0};
+    std::atomic<long long> eviction_count{0};
+
+    Shard& shard_of(uint64_t key) const;
+    Entry* bucket_of(Shard& shard, uint64_t key) const;
+};
+
+/**
+ * @brief Returns an evaluator that answers positions from the cache and passes only the misses on
+ * to the given evaluator (in one call per batch), caching what it returns.
+ */
+Evaluator cached_evaluator(Evaluator evaluator, std::shared_ptr<EvalCache> cache);
+
+#endif // EVAL_CACHE_H
@@ -0,0 +1,77 @@
+#ifndef HALF_H
+#define HALF_H
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Conversions between float and IEEE 754 half precision (binary16), used to store priors and
+ * other probabilities in two bytes. Rounds to nearest even; values beyond the half range
+ * become infinity.
+ */
+
+inline uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFFu) { // Inf or NaN
+        return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+    }
+    int half_exponent = static_cast<int>(exponent) - 127 + 15;
+    if (half_exponent >= 31) { // Overflow
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+    if (half_exponent <= 0) { // Subnormal half or zero
+        if (half_exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - half_exponent);
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1u))) {
+            half_mantissa++;
+        }
+        return static_cast<uint16_t>(sign | half_mantissa);
+    }
+    uint32_t half = sign | (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        half++; // May carry into the exponent, which is the correct rounding
+    }
+    return static_cast<uint16_t>(half);
+}
+
+inline float half_to_float(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else { // Subnormal: normalize
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400u) == 0) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3FFu;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    } else if (exponent == 31) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+#endif // HALF_H
@@ -0,0 +1,280 @@
+#include "InferenceServer.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+Evaluator network_evaluator(BatchNetwork network) {
+    return [network](const std::vector<const ChessBoard*>& boards, std::vector<Evaluation>& results) {
+        int batch = static_cast<int>(boards.size());
+        std::vector<float> states(static_cast<size_t>(batch) * STATE_TENSOR_SIZE);
+        std::vector<float> values(batch);
+        std::vector<float> logits(static_cast<size_t>(batch) * POLICY_SIZE);
+        for (int i = 0; i < batch; ++i) {
+            boards[i]->copy_state_tensor(states.data() + static_cast<size_t>(i) * STATE_TENSOR_SIZE);
+        }
+        network(states.data(), batch, values.data(), logits.data());
+        for (int i = 0; i < batch; ++i) {
+            const std::vector<Move>& moves = boards[i]->legal_moves();
+            results[i].value = values[i];
+            results[i].priors.resize(moves.size());
+            masked_softmax(logits.data() + static_cast<size_t>(i) * POLICY_SIZE, moves, results[i].priors.data());
+        }
+    };
+}
+
+Evaluator network_evaluator(LegalNetwork network) {
+    return [network](const std::vector<const ChessBoard*>& boards, std::vector<Evaluation>& results) {
+        std::vector<float> states(boards.size() * STATE_TENSOR_SIZE);
+        std::vector<const std::vector<Move>*> moves(boards.size());
+        for (size_t i = 0; i < boards.size(); ++i) {
+            boards[i]->copy_state_tensor(states.data() + i * STATE_TENSOR_SIZE);
+            moves[i] = &boards[i]->legal_moves();
+        }
+        network(states.data(), moves, results);
+    };
+}
+
+InferenceServer::InferenceServer(BatchNetwork network, int max_batch_size, std::chrono::microseconds max_wait)
+    : network(std::move(network)), batch_limit(std::max(max_batch_size, 1)), max_wait(max_wait), head(&stub), tail(&stub) {
+    for (std::atomic<long long>& bucket : latency_histogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    worker = std::thread(&InferenceServer::run, this);
+}
+
+InferenceServer::InferenceServer(LegalNetwork network, int max_batch_size, std::chrono::microseconds max_wait)
+    : legal_network(std::move(network)), batch_limit(std::max(max_batch_size, 1)), max_wait(max_wait), head(&stub), tail(&stub) {
+    for (std::atomic<long long>& bucket : latency_histogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    worker = std::thread(&InferenceServer::run, this);
+}
+
+InferenceServer::~InferenceServer() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping.store(true);
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void InferenceServer::push(QueueNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    QueueNode* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+InferenceServer::Request* InferenceServer::pop() {
+    QueueNode* first = tail;
+    QueueNode* next = first->next.load(std::memory_order_acquire);
+    if (first == &stub) {
+        if (next == nullptr) {
+            return nullptr;
+        }
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+        tail = next;
+        return static_cast<Request*>(first);
+    }
+    if (first != head.load(std::memory_order_acquire)) {
+        return nullptr; // A producer has exchanged head but not linked its node yet
+    }
+    // first is the only node: put the stub behind it so it can be taken without emptying the list
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+        tail = next;
+        return static_cast<Request*>(first);
+    }
+    return nullptr;
+}
+
+std::future<Evaluation> InferenceServer::submit(const ChessBoard& board) {
+    Request* request = new Request();
+    board.copy_state_tensor(request->state);
+    request->moves = board.legal_moves();
+    request->submitted = std::chrono::steady_clock::now();
+    std::future<Evaluation> result = request->result.get_future();
+
+    push(request);
+    pending.fetch_add(1);
+    if (sleeping.load()) {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        wake.notify_one();
+    }
+    return result;
+}
+
+void InferenceServer::wait_for_requests(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    sleeping.store(true);
+    // Producers bump pending before they check sleeping, so one of the two always sees the other
+    wake.wait_until(lock, deadline, [this] { return pending.load() > 0 || stopping.load(); });
+    sleeping.store(false);
+}
+
+void InferenceServer::run() {
+    std::vector<Request*> batch;
+    std::vector<float> states;
+    std::vector<float> values;
+    std::vector<float> logits;
+
+    while (!stopping.load()) {
+        Request* request = pop();
+        if (request == nullptr) {
+            // Nothing queued (or a push still in progress); the timeout covers the latter
+            wait_for_requests(std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+            continue;
+        }
+
+        // The oldest request sets the deadline, which bounds the time any request waits for others
+        batch.assign(1, request);
+        pending.fetch_sub(1);
+        std::chrono::steady_clock::time_point deadline = request->submitted + max_wait;
+        while (static_cast<int>(batch.size()) < batch_limit && !stopping.load()) {
+            request = pop();
+            if (request != nullptr) {
+                batch.push_back(request);
+                pending.fetch_sub(1);
+            } else if (std::chrono::steady_clock::now() < deadline) {
+                wait_for_requests(deadline);
+            } else {
+                break;
+            }
+        }
+        evaluate(batch, states, values, logits);
+    }
+
+    // Fail whatever is still queued so no caller waits forever
+    while (pending.load() > 0) {
+        Request* request = pop();
+        if (request == nullptr) {
+            std::this_thread::yield();
+            continue;
+        }
+        pending.fetch_sub(1);
+        request->result.set_exception(std::make_exception_ptr(std::runtime_error("inference server stopped")));
+        delete request;
+    }
+}
+
+void InferenceServer::evaluate(std::vector<Request*>& batch, std::vector<float>& states, std::vector<float>& values, std::vector<float>& logits) {
+    int size = static_cast<int>(batch.size());
+    states.resize(static_cast<size_t>(size) * STATE_TENSOR_SIZE);
+    values.resize(size);
+    if (!legal_network) {
+        logits.resize(static_cast<size_t>(size) * POLICY_SIZE);
+    }
+    for (int i = 0; i < size; ++i) {
+        std::copy(batch[i]->state, batch[i]->state + STATE_TENSOR_SIZE, states.data() + static_cast<size_t>(i) * STATE_TENSOR_SIZE);
+    }
+
+    std::exception_ptr error;
+    std::vector<Evaluation> evaluations;
+    try {
+        if (legal_network) {
+            std::vector<const std::vector<Move>*> moves(size);
+            for (int i = 0; i < size; ++i) {
+                moves[i] = &batch[i]->moves;
+            }
+            evaluations.resize(size);
+            legal_network(states.data(), moves, evaluations);
+        } else {
+            network(states.data(), size, values.data(), logits.data());
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (int i = 0; i < size; ++i) {
+        Request* request = batch[i];
+        if (error) {
+            request->result.set_exception(error);
+        } else if (legal_network) {
+            request->result.set_value(std::move(evaluations[i]));
+        } else {
+            Evaluation evaluation;
+            evaluation.value = values[i];
+            evaluation.priors.resize(request->moves.size());
+            masked_softmax(logits.data() + static_cast<size_t>(i) * POLICY_SIZE, request->moves, evaluation.priors.data());
+            request->result.set_value(std::move(evaluation));
+        }
+
+        long long latency = std::chrono::duration_cast<std::chrono::microseconds>(now - request->submitted).count();
+        int bucket = 0;
+        while (bucket < LATENCY_BUCKETS - 1 && (1LL << bucket) <= latency) {
+            bucket++;
+        }
+        latency_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+        total_latency_us.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > max_latency.load(std::memory_order_relaxed)) {
+            max_latency.store(latency, std::memory_order_relaxed); // Only this thread writes it
+        }
+        delete request;
+    }
+    request_count.fetch_add(size, std::memory_order_relaxed);
+    batch_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+InferenceStats InferenceServer::stats() const {
+    InferenceStats stats;
+    stats.requests = request_count.load(std::memory_order_relaxed);
+    stats.batches = batch_count.load(std::memory_order_relaxed);
+    if (stats.requests == 0 || stats.batches == 0) {
+        return stats;
+    }
+    stats.mean_batch_size = static_cast<double>(stats.requests) / stats.batches;
+    stats.batch_fill = stats.mean_batch_size / batch_limit;
+    stats.mean_latency_us = static_cast<double>(total_latency_us.load(std::memory_order_relaxed)) / stats.requests;
+    stats.max_latency_us = static_cast<double>(max_latency.load(std::memory_order_relaxed));
+
+    long long counted = 0;
+    long long total = 0;
+    for (const std::atomic<long long>& bucket : latency_histogram) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+        counted += latency_histogram[b].load(std::memory_order_relaxed);
+        double upper = static_cast<double>(1LL << b);
+        if (stats.p50_latency_us == 0.0 && counted * 2 >= total) {
+            stats.p50_latency_us = upper;
+        }
+        if (counted * 100 >= total * 99) {
+            stats.p99_latency_us = upper;
+            break;
+        }
+    }
+    return stats;
+}
+
+void InferenceServer::reset_stats() {
+    request_count.store(0);
+    batch_count.store(0);
+    total_latency_us.store(0);
+    max_latency.store(0);
+    for (std::atomic<long long>& bucket : latency_histogram) {
+        bucket.store(0);
+    }
+}
+
+int InferenceServer::max_batch_size() const {
+    return batch_limit;
+}
+
+Evaluator server_evaluator(std::shared_ptr<InferenceServer> server) {
+    return [server](const std::vector<const ChessBoard*>& boards, std::vector<Evaluation>& results) {
+        std::vector<std::future<Evaluation>> futures;
+        futures.reserve(boards.size());
+        for (const ChessBoard* board : boards) {
+            futures.push_back(server->submit(*board));
+        }
+        for (size_t i = 0; i < futures.size(); ++i) {
+            results[i] = futures[i].get();
+        }
+    };
+}
@@ -0,0 +1,169 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+#include "ChessBoard.h"
+#include "MCTS.h"
+#include "Policy.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The raw network: runs batch encoded positions (batch x STATE_TENSOR_SIZE floats) and
+ * writes one value (side to move perspective) and POLICY_SIZE policy logits per position.
+ */
+using BatchNetwork = std::function<void(const float* states, int batch, float* values, float* logits)>;
+
+/**
+ * @brief A network that only scores the moves it is asked about: runs moves.size() encoded positions
+ * and fills results[b] with the value and the priors of *moves[b], softmaxed over those moves alone.
+ */
+using LegalNetwork = std::function<void(const float* states, const std::vector<const std::vector<Move>*>& moves,
+                                        std::vector<Evaluation>& results)>;
+
+/**
+ * @brief Returns an evaluator that calls the network directly on each batch, in the calling thread.
+ */
+Evaluator network_evaluator(BatchNetwork network);
+Evaluator network_evaluator(LegalNetwork network);
+
+/**
+ * @brief Latency and batching metrics of an InferenceServer since construction or reset_stats().
+ * Latency is measured from submit() until the result is ready.
+ */
+struct InferenceStats {
+    long long requests = 0;
+    long long batches = 0;
+    double mean_batch_size = 0.0;
+    double batch_fill = 0.0;        // mean_batch_size / max_batch_size
+    double mean_latency_us = 0.0;
+    double p50_latency_us = 0.0;    // Percentiles are read from a log2 histogram, so they are upper bounds
+    double p99_latency_us = 0.0;
+    double max_latency_us = 0.0;
+};
+
+/**
+ * @brief Shares one network between many search threads by batching their requests.
+ *
+ * Callers submit() positions from any thread and wait on the returned future. Requests go onto a
+ * lock-free multi-producer queue; a single batching thread takes them off, waits until it has
+ * max_batch_size of them or the oldest has waited max_wait, runs the network once for the whole
+ * batch and fulfils each future with the value and the policy softmaxed over that position's legal
+ * moves (a LegalNetwork computes those priors itself). The network is only ever called from the
+ * batching thread.
+ *
+ * Destroying the server stops the batching thread; requests still queued fail with
+ * std::runtime_error.
+ */
+class InferenceServer {
+public:
+    /**
+     * @param network The network to run.
+     * @param max_batch_size Largest batch passed to the network.
+     * @param max_wait How long the oldest request may wait for the batch to fill up.
+     */
+    InferenceServer(BatchNetwork network, int max_batch_size = 64,
+                    std::chrono::microseconds max_wait = std::chrono::microseconds(1000));
+    InferenceServer(LegalNetwork network, int max_batch_size = 64,
+                    std::chrono::microseconds max_wait = std::chrono::microseconds(1000));
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    /**
+     * @brief Queues a position for evaluation. Thread-safe; the queue itself is lock-free and a lock
+     * is only taken to wake the batching thread when it is asleep.
+     * @param board The position; it is encoded immediately and need not outlive the call.
+     * @return Future holding the evaluation, with priors aligned with board.legal_moves().
+     */
+    std::future<Evaluation> submit(const ChessBoard& board);
+
+    /**
+     * @brief Returns the metrics gathered so far.
+     */
+    InferenceStats stats() const;
+
+    /**
+     * @brief Clears the metrics.
+     */
+    void reset_stats();
+
+    int max_batch_size() const;
+
+private:
+    struct QueueNode {
+        std::atomic<QueueNode*> next{nullptr};
+    };
+
+    struct Request : QueueNode {
+        float state[STATE_TENSOR_SIZE];
+        std::vector<Move> moves;
+        std::promise<Evaluation> result;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    static constexpr int LATENCY_BUCKETS = 32;  // Bucket b counts latencies below 2^b microseconds
+
+    BatchNetwork network;
+    LegalNetwork legal_network;     // Used instead of network if set
+    int batch_limit;
+    std::chrono::microseconds max_wait;
+
+    // Intrusive MPSC queue (Vyukov): producers exchange head, the batching thread owns tail
+    std::atomic<QueueNode*> head;
+    QueueNode* tail;
+    QueueNode stub;
+    std::atomic<long long> pending{0};
+
+    // Only used to let the batching thread sleep while the queue is empty
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<bool> sleeping{false};
+    std::atomic<bool> stopping{false};
+
+    std::atomic<long long> request_count{0};
+    std::atomic<long long> batch_count{0};
+    std::atomic<long long> total_latency_us{0};
+    std::atomic<long long> max_latency{0};
+    std::atomic<long long> latency_histogram[LATENCY_BUCKETS];
+
+    std::thread worker;
+
+    void push(QueueNode* node);
+
+    /**
+     * @brief Takes the oldest request off the queue, or returns nullptr if there is none (or a
+     * producer is halfway through pushing it). Only called by the batching thread.
+     */
+    Request* pop();
+
+    /**
+     * @brief Sleeps until a request is pushed, the deadline passes or the server stops.
+     */
+    void wait_for_requests(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Body of the batching thread.
+     */
+    void run();
+
+    /**
+     * @brief Runs the network on a batch and fulfils (or fails) every request in it.
+     */
+    void evaluate(std::vector<Request*>& batch, std::vector<float>& states, std::vector<float>& values, std::vector<float>& logits);
+};
+
+/**
+ * @brief Returns an evaluator that sends each position through the given server, so any number of
+ * searches (e.g. one MCTS per game, each in its own thread) share the server's batches.
+ */
+Evaluator server_evaluator(std::shared_ptr<InferenceServer> server);
+
+#endif // INFERENCE_SERVER_H
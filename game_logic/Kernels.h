@@ -0,0 +1,70 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "Cpu.h"
+#include <cstdint>
+
+/**
+ * @brief The dense kernels behind Network, one variant per instruction set.
+ * Network picks a variant at run time (see Cpu.h); they are declared here so that kernel_test can
+ * check every variant the machine supports against the portable one. The x86 variants carry the
+ * same target attributes as their definitions and must only be called if the CPU has those features.
+ */
+
+/**
+ * @brief C[M][N] = act(A[M][K] B[K][N] + bias[N]), all row-major and dense, for columns [from, N) only.
+ */
+void gemm_scalar(const float* A, const float* B, const float* bias, float* C, int M, int N, int K, bool relu, int from = 0);
+
+/**
+ * @brief The fastest GEMM the CPU supports.
+ */
+void gemm(const float* A, const float* B, const float* bias, float* C, int M, int N, int K, bool relu);
+
+/**
+ * @brief Dot product of n floats.
+ */
+float dot_scalar(const float* a, const float* b, int n);
+float dot(const float* a, const float* b, int n);
+
+/**
+ * @brief INT8 GEMM: C[M][N] = act(sum(A[M][K] B[K][N]) * scales[N] + bias[N]), A unsigned 7-bit codes and
+ * B signed, packed in groups of 4 inputs ((K / 4) x N x 4, K a multiple of 4). Columns [from, N) only.
+ * The integer sums are exact in every variant.
+ */
+void gemm_int8_scalar(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C,
+                      int M, int N, int K, bool relu, int from = 0);
+void gemm_int8(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C,
+               int M, int N, int K, bool relu);
+
+/**
+ * @brief Dot product of n unsigned 7-bit codes and n signed weights.
+ */
+int32_t dot_int8_scalar(const uint8_t* a, const int8_t* b, int n);
+int32_t dot_int8(const uint8_t* a, const int8_t* b, int n);
+
+#ifdef CHESS_X86
+__attribute__((target("avx512f")))
+void gemm_avx512(const float* A, const float* B, const float* bias, float* C, int M, int N, int K, bool relu);
+__attribute__((target("avx2,fma")))
+void gemm_avx2(const float* A, const float* B, const float* bias, float* C, int M, int N, int K, bool relu);
+
+__attribute__((target("avx512f")))
+float dot_avx512(const float* a, const float* b, int n);
+__attribute__((target("avx2,fma")))
+float dot_avx2(const float* a, const float* b, int n);
+
+__attribute__((target("avx512f,avx512vnni")))
+void gemm_int8_vnni(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C,
+                    int M, int N, int K, bool relu);
+__attribute__((target("avx2,fma")))
+void gemm_int8_avx2(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C,
+                    int M, int N, int K, bool relu);
+
+__attribute__((target("avx512f,avx512vnni")))
+int32_t dot_int8_vnni(const uint8_t* a, const int8_t* b, int n);
+__attribute__((target("avx2,fma")))
+int32_t dot_int8_avx2(const uint8_t* a, const int8_t* b, int n);
+#endif
+
+#endif // KERNELS_H
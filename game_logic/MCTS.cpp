@@ -0,0 +1,932 @@
+#include "MCTS.h"
+#include "Cpu.h"
+#include "Half.h"
+#include "Policy.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#ifdef CHESS_X86
+#include <immintrin.h>
+#endif
+
+// std::atomic<float>::fetch_add is C++20, so add with a compare-and-swap loop
+static void atomic_add(std::atomic<float>& target, float value) {
+    float current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {
+    }
+}
+
+static bool on_path(const std::vector<std::pair<uint32_t, uint32_t>>& path, uint32_t node) {
+    for (const auto& step : path) {
+        if (step.first == node) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Takes one simulation from the shared budget, failing once it is used up
+static bool claim_simulation(std::atomic<int>& remaining) {
+    int current = remaining.load(std::memory_order_relaxed);
+    while (current > 0) {
+        if (remaining.compare_exchange_weak(current, current - 1, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Evaluator uniform_evaluator() {
+    return [](const std::vector<const ChessBoard*>& boards, std::vector<Evaluation>& results) {
+        for (size_t i = 0; i < boards.size(); ++i) {
+            size_t n = boards[i]->legal_moves().size();
+            results[i].value = 0.0f;
+            results[i].priors.assign(n, n ? 1.0f / n : 0.0f);
+        }
+    };
+}
+
+MCTS::MCTS(const ChessBoard& root_board, Evaluator evaluator, float c_puct)
+    : root_position(root_board.clone()), evaluator(std::move(evaluator)), c_puct(c_puct) {
+    nodes.allocate(1); // NO_NODE sentinel
+    for (std::atomic<long long>& count : free_edge_count) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    root = allocate_node();
+}
+
+MCTS::~MCTS() = default;
+
+void MCTS::init_node(NodeBlock& block, uint32_t n) {
+    block.edge_begin[n] = 0;
+    block.num_edges[n] = 0;
+    block.terminal[n] = 0;
+    block.value[n] = 0.0f;
+    block.visits[n].store(0, std::memory_order_relaxed);
+    block.value_sum[n].store(0.0f, std::memory_order_relaxed);
+    block.in_flight[n].store(0, std::memory_order_relaxed);
+    block.state[n].store(NEW, std::memory_order_release);
+}
+
+uint32_t MCTS::new_node(NodeArena& arena) {
+    uint32_t index = arena.allocate(1);
+    init_node(arena.block(index), NodeArena::slot(index));
+    return index;
+}
+
+uint32_t MCTS::allocate_node() {
+    live_nodes.fetch_add(1, std::memory_order_relaxed);
+    long long slot = free_node_count.fetch_sub(1, std::memory_order_relaxed) - 1;
+    if (slot < 0) {
+        return new_node(nodes);
+    }
+    // Free lists only change while no worker runs (in prune()), so reading them here is safe
+    uint32_t index = free_nodes[slot];
+    init_node(nodes.block(index), NodeArena::slot(index));
+    return index;
+}
+
+uint32_t MCTS::allocate_edges(uint32_t count) {
+    live_edges.fetch_add(count, std::memory_order_relaxed);
+    if (count < MAX_EDGES) {
+        long long slot = free_edge_count[count].fetch_sub(1, std::memory_order_relaxed) - 1;
+        if (slot >= 0) {
+            return free_edges[count][slot];
+        }
+    }
+    return edges.allocate(count);
+}
+
+float MCTS::search(int num_simulations, int batch_size, int num_threads) {
+    SearchLimits limits;
+    limits.simulations = num_simulations;
+    return search(limits, batch_size, num_threads).value;
+}
+
+SearchStats MCTS::search(const SearchLimits& limits, int batch_size, int num_threads) {
+    batch_size = std::max(batch_size, 1);
+    num_threads = std::max(num_threads, 1);
+    int started = std::max(limits.simulations, 0);
+    std::atomic<int> remaining(started);
+    budget_exhausted = false;
+    active_limits = &limits;
+    search_start = std::chrono::steady_clock::now();
+    stop_reason.store(static_cast<int>(StopReason::SIMULATIONS));
+    int visits_before = root_visits();
+
+    // Workers stop early when the tree outgrows the memory budget; prune it and carry on
+    try {
+        while (true) {
+            run_workers(remaining, batch_size, num_threads, started);
+            if (remaining.load() <= 0 || !over_budget()) {
+                break;
+            }
+            if (prune() == 0) {
+                budget_exhausted = true; // Nothing left to prune; finish this search over budget
+            }
+        }
+    } catch (...) {
+        active_limits = nullptr;
+        throw;
+    }
+    active_limits = nullptr;
+    return search_stats(started, visits_before);
+}
+
+SearchStats MCTS::search_stats(int started, int visits_before) const {
+    SearchStats stats;
+    stats.value = root_value();
+    stats.simulations = root_visits() - visits_before;
+    stats.saved = std::max(started - stats.simulations, 0);
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - search_start).count();
+    stats.reason = static_cast<StopReason>(stop_reason.load());
+    return stats;
+}
+
+void MCTS::begin_search(const SearchLimits& limits) {
+    step_limits = limits;
+    step_started = std::max(limits.simulations, 0);
+    step_remaining.store(step_started);
+    step_visits_before = root_visits();
+    budget_exhausted = false;
+    active_limits = &step_limits;
+    search_start = std::chrono::steady_clock::now();
+    stop_reason.store(static_cast<int>(StopReason::SIMULATIONS));
+}
+
+bool MCTS::gather(int batch_size, std::vector<const ChessBoard*>& boards) {
+    if (!step_leaves.empty()) {
+        throw std::logic_error("gather() called before the previous batch was expanded or released");
+    }
+    if (over_budget() && prune() == 0) {
+        budget_exhausted = true; // Nothing left to prune; finish this search over budget
+    }
+    int remaining = step_remaining.load(std::memory_order_relaxed);
+    if (remaining <= 0 || limit_reached(remaining, step_started)) {
+        step_remaining.store(0);
+        return false;
+    }
+    gather_batch(step_remaining, std::max(batch_size, 1), step_leaves, boards, step_boards);
+    return true;
+}
+
+void MCTS::expand_gathered(const Evaluation* results) {
+    expand_batch(step_leaves, results);
+}
+
+void MCTS::release_gathered() {
+    release_batch(step_leaves);
+}
+
+SearchStats MCTS::end_search() {
+    release_batch(step_leaves);
+    active_limits = nullptr;
+    return search_stats(step_started, step_visits_before);
+}
+
+bool MCTS::limit_reached(int remaining, int started) {
+    const SearchLimits& limits = *active_limits;
+    double elapsed_ms = 0.0;
+    if (limits.time_ms > 0.0 || limits.early_stop) {
+        elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - search_start).count();
+    }
+
+    StopReason reason;
+    if (limits.time_ms > 0.0 && elapsed_ms >= limits.time_ms) {
+        reason = StopReason::TIME;
+    } else if (limits.nodes > 0 && live_nodes.load(std::memory_order_relaxed) >= limits.nodes) {
+        reason = StopReason::NODES;
+    } else if (limits.memory > 0 && live_memory() >= limits.memory) {
+        reason = StopReason::MEMORY;
+    } else if (limits.early_stop) {
+        // Simulations that can still reach the root children: the unclaimed ones plus those in flight
+        const NodeBlock& block = nodes.block(root);
+        uint32_t n = NodeArena::slot(root);
+        int in_flight = block.in_flight[n].load(std::memory_order_relaxed);
+        double left = static_cast<double>(remaining) + in_flight;
+        int done = started - remaining - in_flight;
+        if (limits.time_ms > 0.0 && done > 0 && elapsed_ms > 0.0) {
+            left = std::min(left, done / elapsed_ms * (limits.time_ms - elapsed_ms) + in_flight);
+        }
+        if (!decided(left)) {
+            return false;
+        }
+        reason = StopReason::DECIDED;
+    } else {
+        return false;
+    }
+    stop_reason.store(static_cast<int>(reason), std::memory_order_relaxed);
+    return true;
+}
+
+bool MCTS::decided(double remaining) const {
+    const NodeBlock& block = nodes.block(root);
+    uint32_t n = NodeArena::slot(root);
+    if (block.state[n].load(std::memory_order_acquire) != EXPANDED || block.terminal[n]) {
+        return false;
+    }
+    if (block.num_edges[n] <= 1) {
+        return true; // Only one move to play
+    }
+    int first = 0;
+    int second = 0;
+    uint32_t begin = block.edge_begin[n];
+    for (uint32_t i = 0; i < block.num_edges[n]; ++i) {
+        int visits = edges.block(begin + i).visits[EdgeArena::slot(begin + i)].load(std::memory_order_relaxed);
+        if (visits > first) {
+            second = first;
+            first = visits;
+        } else if (visits > second) {
+            second = visits;
+        }
+    }
+    return second + remaining < first;
+}
+
+void MCTS::run_workers(std::atomic<int>& remaining, int batch_size, int num_threads, int started) {
+    if (num_threads == 1) {
+        run_worker(remaining, batch_size, started);
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto guarded_worker = [&]() {
+        try {
+            run_worker(remaining, batch_size, started);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            remaining.store(0); // Stop the other workers
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < num_threads; ++t) {
+        workers.emplace_back(guarded_worker);
+    }
+    guarded_worker();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void MCTS::run_worker(std::atomic<int>& remaining, int batch_size, int started) {
+    std::vector<Leaf> leaves;
+    std::vector<const ChessBoard*> boards;
+    std::vector<Evaluation> results;
+    std::vector<std::unique_ptr<ChessBoard>> scratch; // One reusable position per batch slot
+
+    while (!over_budget()) {
+        if (limit_reached(remaining.load(std::memory_order_relaxed), started)) {
+            remaining.store(0);
+            return;
+        }
+        leaves.clear();
+        boards.clear();
+        gather_batch(remaining, batch_size, leaves, boards, scratch);
+
+        if (leaves.empty()) {
+            if (remaining.load(std::memory_order_relaxed) <= 0) {
+                return;
+            }
+            // Every selection hit a leaf another thread is evaluating; let it finish
+            std::this_thread::yield();
+            continue;
+        }
+
+        results.assign(leaves.size(), Evaluation());
+        try {
+            evaluator(boards, results);
+        } catch (...) {
+            release_batch(leaves);
+            throw;
+        }
+        expand_batch(leaves, results.data());
+    }
+}
+
+void MCTS::gather_batch(std::atomic<int>& remaining, int batch_size, std::vector<Leaf>& leaves,
+                        std::vector<const ChessBoard*>& boards, std::vector<std::unique_ptr<ChessBoard>>& scratch) {
+    int collisions = 0;
+
+    // Terminal leaves need no evaluation and are backed up right away
+    while (static_cast<int>(leaves.size()) < batch_size && collisions < batch_size) {
+        if (!claim_simulation(remaining)) {
+            break;
+        }
+        Leaf leaf;
+        select_leaf(leaf);
+        if (leaf.repetition) {
+            remove_virtual_loss(leaf.path);
+            backup(leaf.path, NO_NODE, 0.0f);
+            continue;
+        }
+        NodeBlock& block = nodes.block(leaf.node);
+        uint32_t n = NodeArena::slot(leaf.node);
+
+        uint8_t expected = NEW;
+        if (block.state[n].load(std::memory_order_acquire) != EXPANDED &&
+            !block.state[n].compare_exchange_strong(expected, CLAIMED, std::memory_order_acq_rel)) {
+            // Already being evaluated, by this batch or another thread: give the simulation back
+            remove_virtual_loss(leaf.path);
+            remaining.fetch_add(1, std::memory_order_relaxed);
+            collisions++;
+            continue;
+        }
+        if (block.state[n].load(std::memory_order_acquire) == EXPANDED) {
+            remove_virtual_loss(leaf.path);
+            backup(leaf.path, leaf.node, block.value[n]); // Terminal node, reached again
+            continue;
+        }
+
+        if (scratch.size() <= leaves.size()) {
+            scratch.emplace_back(new ChessBoard(*root_position));
+        }
+        leaf.board = scratch[leaves.size()].get();
+        replay(leaf.path, *leaf.board);
+        if (table && !leaf.path.empty()) {
+            uint32_t existing = find_or_insert(leaf.board->hash(), leaf.node);
+            if (existing != leaf.node) {
+                remove_virtual_loss(leaf.path);
+                // Another move order reached this position first: share its node (ours is dropped)
+                edges.block(leaf.path.back().second).child[EdgeArena::slot(leaf.path.back().second)].store(existing, std::memory_order_release);
+                if (on_path(leaf.path, existing)) {
+                    // Repeats a position earlier on this path: a draw for this simulation only, since other
+                    // move orders reaching the parent need not repeat it (as in select_leaf)
+                    backup(leaf.path, NO_NODE, 0.0f);
+                    continue;
+                }
+                hit_count.fetch_add(1, std::memory_order_relaxed);
+                NodeBlock& shared = nodes.block(existing);
+                uint32_t s = NodeArena::slot(existing);
+                if (shared.state[s].load(std::memory_order_acquire) != EXPANDED) {
+                    remaining.fetch_add(1, std::memory_order_relaxed); // Still being evaluated; try again later
+                    collisions++;
+                    continue;
+                }
+                int visits = shared.visits[s].load(std::memory_order_relaxed);
+                float estimate = shared.terminal[s] || visits == 0 ? shared.value[s] : shared.value_sum[s].load(std::memory_order_relaxed) / visits;
+                backup(leaf.path, existing, estimate);
+                continue;
+            }
+        }
+        if (check_terminal(leaf.node, *leaf.board)) {
+            remove_virtual_loss(leaf.path);
+            backup(leaf.path, leaf.node, expand(leaf.node, leaf.board, nullptr));
+            continue;
+        }
+        boards.push_back(leaf.board);
+        leaves.push_back(std::move(leaf));
+    }
+    collision_count.fetch_add(collisions, std::memory_order_relaxed);
+}
+
+void MCTS::expand_batch(std::vector<Leaf>& leaves, const Evaluation* results) {
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        Leaf& leaf = leaves[i];
+        float value = expand(leaf.node, leaf.board, &results[i]);
+        remove_virtual_loss(leaf.path);
+        backup(leaf.path, leaf.node, value);
+    }
+    leaves.clear();
+}
+
+void MCTS::release_batch(std::vector<Leaf>& leaves) {
+    for (Leaf& leaf : leaves) {
+        remove_virtual_loss(leaf.path);
+        nodes.block(leaf.node).state[NodeArena::slot(leaf.node)].store(NEW, std::memory_order_release);
+    }
+    leaves.clear();
+}
+
+void MCTS::select_leaf(Leaf& leaf) {
+    uint32_t node = root;
+    while (true) {
+        NodeBlock& block = nodes.block(node);
+        uint32_t n = NodeArena::slot(node);
+        if (block.state[n].load(std::memory_order_acquire) != EXPANDED || block.terminal[n]) {
+            leaf.node = node;
+            return;
+        }
+
+        uint32_t edge = select_edge(node);
+        leaf.path.emplace_back(node, edge);
+        EdgeBlock& edge_block = edges.block(edge);
+        uint32_t e = EdgeArena::slot(edge);
+        edge_block.in_flight[e].fetch_add(1, std::memory_order_relaxed);
+        block.in_flight[n].fetch_add(1, std::memory_order_relaxed);
+
+        uint32_t child = edge_block.child[e].load(std::memory_order_acquire);
+        if (child == NO_NODE) {
+            // Publish a fresh node; if another thread got there first, use theirs (ours stays unused)
+            uint32_t fresh = allocate_node();
+            if (edge_block.child[e].compare_exchange_strong(child, fresh, std::memory_order_acq_rel)) {
+                leaf.node = fresh;
+                return;
+            }
+        }
+        if (table && on_path(leaf.path, child)) {
+            leaf.node = child;
+            leaf.repetition = true;
+            return;
+        }
+        node = child;
+    }
+}
+
+void MCTS::replay(const std::vector<std::pair<uint32_t, uint32_t>>& path, ChessBoard& board) const {
+    board = *root_position;
+    if (path.empty()) {
+        return;
+    }
+    for (const auto& step : path) {
+        board.play_unchecked(policy_index_to_move(edges.block(step.second).move[EdgeArena::slot(step.second)]));
+    }
+    board.refresh();
+}
+
+void MCTS::remove_virtual_loss(const std::vector<std::pair<uint32_t, uint32_t>>& path) {
+    for (const auto& step : path) {
+        edges.block(step.second).in_flight[EdgeArena::slot(step.second)].fetch_sub(1, std::memory_order_relaxed);
+        nodes.block(step.first).in_flight[NodeArena::slot(step.first)].fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+// PUCT score of one edge; the vector kernel below must compute exactly the same expression
+static inline float puct_score(float prior, int32_t visits, float value_sum, int32_t in_flight,
+                               float c_puct, float sqrt_visits, float virtual_loss) {
+    int32_t n = visits + in_flight;
+    float q = (value_sum - in_flight * virtual_loss) / std::max(n, 1);
+    return q + c_puct * prior * sqrt_visits / (1.0f + n);
+}
+
+static uint32_t puct_argmax_scalar(const uint16_t* prior, const std::atomic<int32_t>* visits, const std::atomic<float>* value_sum,
+                                   const std::atomic<int32_t>* in_flight, uint32_t begin, uint32_t count,
+                                   float c_puct, float sqrt_visits, float virtual_loss, uint32_t best, float best_score) {
+    for (uint32_t i = begin; i < count; ++i) {
+        float score = puct_score(half_to_float(prior[i]), visits[i].load(std::memory_order_relaxed),
+                                 value_sum[i].load(std::memory_order_relaxed), in_flight[i].load(std::memory_order_relaxed),
+                                 c_puct, sqrt_visits, virtual_loss);
+        if (score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+#if defined(CHESS_X86) && !defined(__SANITIZE_THREAD__)
+#define MCTS_SIMD_SELECT 1
+static_assert(sizeof(std::atomic<int32_t>) == 4 && sizeof(std::atomic<float>) == 4, "vector loads assume plain 4-byte atomics");
+
+// Scores 8 edges per step. The statistics are read with plain vector loads: every lane is an
+// aligned 4-byte value, which x86 never tears, so this sees what relaxed loads would.
+__attribute__((target("avx2,f16c")))
+static uint32_t puct_argmax_avx2(const uint16_t* prior, const std::atomic<int32_t>* visits, const std::atomic<float>* value_sum,
+                                 const std::atomic<int32_t>* in_flight, uint32_t count,
+                                 float c_puct, float sqrt_visits, float virtual_loss) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 c = _mm256_set1_ps(c_puct);
+    const __m256 root = _mm256_set1_ps(sqrt_visits);
+    const __m256 loss = _mm256_set1_ps(virtual_loss);
+    const __m256i one_i = _mm256_set1_epi32(1);
+    __m256 best = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+    __m256i best_index = _mm256_setzero_si256();
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 p = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prior + i)));
+        __m256i pending = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in_flight + i));
+        __m256i n = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(visits + i)), pending);
+        __m256 w = _mm256_loadu_ps(reinterpret_cast<const float*>(value_sum + i));
+        __m256 q = _mm256_div_ps(_mm256_sub_ps(w, _mm256_mul_ps(_mm256_cvtepi32_ps(pending), loss)),
+                                 _mm256_cvtepi32_ps(_mm256_max_epi32(n, one_i)));
+        __m256 u = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(c, p), root), _mm256_add_ps(one, _mm256_cvtepi32_ps(n)));
+        __m256 score = _mm256_add_ps(q, u);
+        __m256 better = _mm256_cmp_ps(score, best, _CMP_GT_OQ);
+        best = _mm256_blendv_ps(best, score, better);
+        best_index = _mm256_blendv_epi8(best_index, index, _mm256_castps_si256(better));
+        index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+    }
+
+    // Each lane holds its first maximum; take the best lane, preferring the lowest index on ties
+    alignas(32) float lane_score[8];
+    alignas(32) int32_t lane_index[8];
+    _mm256_store_ps(lane_score, best);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane_index), best_index);
+    uint32_t best_edge = 0;
+    float best_score = -std::numeric_limits<float>::infinity();
+    for (int lane = 0; lane < 8; ++lane) {
+        if (lane_score[lane] > best_score || (lane_score[lane] == best_score && static_cast<uint32_t>(lane_index[lane]) < best_edge)) {
+            best_score = lane_score[lane];
+            best_edge = static_cast<uint32_t>(lane_index[lane]);
+        }
+    }
+    return puct_argmax_scalar(prior, visits, value_sum, in_flight, i, count, c_puct, sqrt_visits, virtual_loss, best_edge, best_score);
+}
+#endif
+
+uint32_t MCTS::select_edge(uint32_t node) const {
+    const NodeBlock& block = nodes.block(node);
+    uint32_t n = NodeArena::slot(node);
+    int node_visits = block.visits[n].load(std::memory_order_relaxed) + block.in_flight[n].load(std::memory_order_relaxed);
+    const float sqrt_visits = std::sqrt(static_cast<float>(std::max(node_visits, 1)));
+
+    // A node's edges are contiguous within one edge block, so each statistic is a plain array
+    uint32_t begin = block.edge_begin[n];
+    const EdgeBlock& edge_block = edges.block(begin);
+    uint32_t first = EdgeArena::slot(begin);
+    uint32_t count = block.num_edges[n];
+    const uint16_t* prior = edge_block.prior + first;
+    const std::atomic<int32_t>* visits = edge_block.visits + first;
+    const std::atomic<float>* value_sum = edge_block.value_sum + first;
+    const std::atomic<int32_t>* in_flight = edge_block.in_flight + first;
+
+#ifdef MCTS_SIMD_SELECT
+    if (count >= 8 && cpu_has_avx2()) {
+        return begin + puct_argmax_avx2(prior, visits, value_sum, in_flight, count, c_puct, sqrt_visits, virtual_loss);
+    }
+#endif
+    return begin + puct_argmax_scalar(prior, visits, value_sum, in_flight, 0, count, c_puct, sqrt_visits, virtual_loss,
+                                      0, -std::numeric_limits<float>::infinity());
+}
+
+bool MCTS::check_terminal(uint32_t node, const ChessBoard& board) {
+    if (!board.is_game_over()) {
+        return false;
+    }
+    NodeBlock& block = nodes.block(node);
+    uint32_t n = NodeArena::slot(node);
+    int side = board.get_turn() == Color::WHITE ? 1 : -1;
+    block.terminal[n] = 1;
+    block.value[n] = static_cast<float>(board.get_outcome() * side);
+    return true;
+}
+
+float MCTS::expand(uint32_t node, const ChessBoard* board, const Evaluation* evaluation) {
+    NodeBlock& block = nodes.block(node);
+    uint32_t n = NodeArena::slot(node);
+    if (block.state[n].load(std::memory_order_acquire) == EXPANDED) {
+        return block.value[n]; // Terminal node, reached again
+    }
+    if (!block.terminal[n] && evaluation != nullptr) {
+        const std::vector<Move>& moves = board->legal_moves();
+        uint32_t count = static_cast<uint32_t>(moves.size());
+        if (count == 0) {
+            block.terminal[n] = 1; // No moves but not flagged game over (e.g. a hand-built root); nothing to search
+        } else {
+            uint32_t begin = allocate_edges(count);
+            EdgeBlock& edge_block = edges.block(begin);
+            uint32_t first = EdgeArena::slot(begin);
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t e = first + i;
+                edge_block.move[e] = static_cast<uint16_t>(move_to_policy_index(moves[i]));
+                edge_block.prior[e] = float_to_half(i < evaluation->priors.size() ? evaluation->priors[i] : 0.0f);
+                edge_block.visits[e].store(0, std::memory_order_relaxed);
+                edge_block.value_sum[e].store(0.0f, std::memory_order_relaxed);
+                edge_block.in_flight[e].store(0, std::memory_order_relaxed);
+                edge_block.child[e].store(NO_NODE, std::memory_order_relaxed);
+            }
+            block.edge_begin[n] = begin;
+        }
+        block.num_edges[n] = static_cast<uint16_t>(count);
+        block.value[n] = evaluation->value;
+    }
+    block.state[n].store(EXPANDED, std::memory_order_release);
+    return block.value[n];
+}
+
+uint32_t MCTS::find_or_insert(uint64_t key, uint32_t node) {
+    TableShard& shard = table[key % TABLE_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.entries.emplace(key, node).first->second;
+}
+
+void MCTS::backup(const std::vector<std::pair<uint32_t, uint32_t>>& path, uint32_t leaf, float value) {
+    if (leaf != NO_NODE) {
+        NodeBlock& leaf_block = nodes.block(leaf);
+        leaf_block.visits[NodeArena::slot(leaf)].fetch_add(1, std::memory_order_relaxed);
+        atomic_add(leaf_block.value_sum[NodeArena::slot(leaf)], value);
+    }
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        value = -value; // Parent's perspective
+        EdgeBlock& edge_block = edges.block(it->second);
+        uint32_t e = EdgeArena::slot(it->second);
+        edge_block.visits[e].fetch_add(1, std::memory_order_relaxed);
+        atomic_add(edge_block.value_sum[e], value);
+        NodeBlock& block = nodes.block(it->first);
+        uint32_t n = NodeArena::slot(it->first);
+        block.visits[n].fetch_add(1, std::memory_order_relaxed);
+        atomic_add(block.value_sum[n], value);
+    }
+}
+
+bool MCTS::advance(const Move& move) {
+    ChessBoard* next = root_position->step(move);
+    if (next == nullptr) {
+        return false;
+    }
+
+    uint32_t child = NO_NODE;
+    const NodeBlock& block = nodes.block(root);
+    uint32_t n = NodeArena::slot(root);
+    if (block.state[n].load() == EXPANDED) {
+        uint32_t begin = block.edge_begin[n];
+        for (uint32_t i = 0; i < block.num_edges[n]; ++i) {
+            const EdgeBlock& edge_block = edges.block(begin + i);
+            if (edge_block.move[EdgeArena::slot(begin + i)] == move_to_policy_index(move)) {
+                child = edge_block.child[EdgeArena::slot(begin + i)].load();
+                break;
+            }
+        }
+    }
+
+    root_position.reset(next);
+    compact(child); // Keeps the played child's subtree (or starts a fresh root) and frees the siblings
+    return true;
+}
+
+void MCTS::compact(uint32_t new_root) {
+    NodeArena kept_nodes;
+    EdgeArena kept_edges;
+    kept_nodes.allocate(1); // NO_NODE sentinel
+    uint32_t kept_root = new_node(kept_nodes);
+
+    // Copy reachable nodes breadth-first, remapping indices; the map also handles shared children
+    std::unordered_map<uint32_t, uint32_t> remap;
+    long long kept_edge_count = 0;
+    if (new_root != NO_NODE) {
+        remap.emplace(new_root, kept_root);
+        std::vector<uint32_t> queue{new_root};
+        for (size_t q = 0; q < queue.size(); ++q) {
+            uint32_t old_index = queue[q];
+            uint32_t new_index = remap[old_index];
+            const NodeBlock& src = nodes.block(old_index);
+            NodeBlock& dst = kept_nodes.block(new_index);
+            uint32_t s = NodeArena::slot(old_index);
+            uint32_t d = NodeArena::slot(new_index);
+
+            dst.terminal[d] = src.terminal[s];
+            dst.value[d] = src.value[s];
+            dst.visits[d].store(src.visits[s].load());
+            dst.value_sum[d].store(src.value_sum[s].load());
+            dst.state[d].store(src.state[s].load() == EXPANDED ? EXPANDED : NEW);
+            dst.num_edges[d] = src.state[s].load() == EXPANDED ? src.num_edges[s] : 0;
+            if (dst.num_edges[d] == 0) {
+                continue;
+            }
+
+            uint32_t src_begin = src.edge_begin[s];
+            uint32_t dst_begin = kept_edges.allocate(dst.num_edges[d]);
+            kept_edge_count += dst.num_edges[d];
+            dst.edge_begin[d] = dst_begin;
+            const EdgeBlock& src_edges = edges.block(src_begin);
+            EdgeBlock& dst_edges = kept_edges.block(dst_begin);
+            for (uint32_t i = 0; i < dst.num_edges[d]; ++i) {
+                uint32_t se = EdgeArena::slot(src_begin) + i;
+                uint32_t de = EdgeArena::slot(dst_begin) + i;
+                dst_edges.move[de] = src_edges.move[se];
+                dst_edges.prior[de] = src_edges.prior[se];
+                dst_edges.visits[de].store(src_edges.visits[se].load());
+                dst_edges.value_sum[de].store(src_edges.value_sum[se].load());
+                dst_edges.in_flight[de].store(0);
+
+                uint32_t old_child = src_edges.child[se].load();
+                uint32_t new_child = NO_NODE;
+                if (old_child != NO_NODE) {
+                    auto found = remap.find(old_child);
+                    if (found == remap.end()) {
+                        new_child = new_node(kept_nodes);
+                        remap.emplace(old_child, new_child);
+                        queue.push_back(old_child);
+                    } else {
+                        new_child = found->second;
+                    }
+                }
+                dst_edges.child[de].store(new_child);
+            }
+        }
+    }
+
+    nodes.swap(kept_nodes);
+    edges.swap(kept_edges);
+    root = kept_root;
+    reset_free_lists();
+    live_nodes.store(static_cast<long long>(remap.size()) + (new_root == NO_NODE ? 1 : 0));
+    live_edges.store(kept_edge_count);
+
+    if (table) {
+        for (size_t i = 0; i < TABLE_SHARDS; ++i) {
+            std::unordered_map<uint64_t, uint32_t> kept;
+            for (const auto& entry : table[i].entries) {
+                auto found = remap.find(entry.second);
+                if (found != remap.end()) {
+                    kept.emplace(entry.first, found->second);
+                }
+            }
+            table[i].entries.swap(kept);
+        }
+        find_or_insert(root_position->hash(), root);
+    }
+}
+
+std::vector<std::pair<Move, int>> MCTS::root_visit_counts() const {
+    std::vector<std::pair<Move, int>> counts;
+    const NodeBlock& block = nodes.block(root);
+    uint32_t n = NodeArena::slot(root);
+    if (block.state[n].load() != EXPANDED) {
+        return counts;
+    }
+    uint32_t begin = block.edge_begin[n];
+    for (uint32_t i = 0; i < block.num_edges[n]; ++i) {
+        const EdgeBlock& edge_block = edges.block(begin + i);
+        uint32_t e = EdgeArena::slot(begin + i);
+        counts.emplace_back(policy_index_to_move(edge_block.move[e]), edge_block.visits[e].load());
+    }
+    return counts;
+}
+
+Move MCTS::best_move() const {
+    std::vector<std::pair<Move, int>> counts = root_visit_counts();
+    if (counts.empty()) {
+        return Move(Coords(-1, -1), Coords(-1, -1));
+    }
+    auto best = std::max_element(counts.begin(), counts.end(),
+                                 [](const std::pair<Move, int>& a, const std::pair<Move, int>& b) { return a.second < b.second; });
+    return best->first;
+}
+
+float MCTS::root_value() const {
+    const NodeBlock& block = nodes.block(root);
+    uint32_t n = NodeArena::slot(root);
+    int visits = block.visits[n].load();
+    return visits > 0 ? block.value_sum[n].load() / visits : block.value[n];
+}
+
+int MCTS::root_visits() const {
+    return nodes.block(root).visits[NodeArena::slot(root)].load();
+}
+
+const ChessBoard& MCTS::root_board() const {
+    return *root_position;
+}
+
+size_t MCTS::num_nodes() const {
+    return static_cast<size_t>(nodes.size() - 1);
+}
+
+size_t MCTS::memory_usage() const {
+    return nodes.memory_bytes() + edges.memory_bytes();
+}
+
+void MCTS::set_c_puct(float c_puct) {
+    this->c_puct = c_puct;
+}
+
+void MCTS::set_virtual_loss(float virtual_loss) {
+    this->virtual_loss = virtual_loss;
+}
+
+long long MCTS::collisions() const {
+    return collision_count.load();
+}
+
+void MCTS::reset_free_lists() {
+    free_nodes.clear();
+    free_node_count.store(0);
+    for (uint32_t count = 0; count < MAX_EDGES; ++count) {
+        free_edges[count].clear();
+        free_edge_count[count].store(0);
+    }
+}
+
+long long MCTS::prune() {
+    // Free lists may have been partly consumed (or overdrawn) since the last prune
+    free_nodes.resize(std::max(free_node_count.load(), 0LL));
+    for (uint32_t count = 0; count < MAX_EDGES; ++count) {
+        free_edges[count].resize(std::max(free_edge_count[count].load(), 0LL));
+    }
+
+    const size_t target = memory_budget - memory_budget / 4;
+    long long freed = 0;
+    std::vector<uint8_t> reachable;
+    std::vector<uint32_t> stack;
+    for (int threshold = 1; live_memory() > target; threshold *= 2) {
+        // Mark what stays reachable, cutting every edge with at most threshold visits on the way.
+        // A cut edge keeps its visits and value sum, so its statistics survive in the parent;
+        // selecting it again creates and evaluates a fresh child.
+        reachable.assign(nodes.size(), 0);
+        reachable[root] = 1;
+        stack.assign(1, root);
+        while (!stack.empty()) {
+            uint32_t node = stack.back();
+            stack.pop_back();
+            const NodeBlock& block = nodes.block(node);
+            uint32_t n = NodeArena::slot(node);
+            if (block.state[n].load() != EXPANDED) {
+                continue;
+            }
+            for (uint32_t i = 0; i < block.num_edges[n]; ++i) {
+                EdgeBlock& edge_block = edges.block(block.edge_begin[n] + i);
+                uint32_t e = EdgeArena::slot(block.edge_begin[n] + i);
+                uint32_t child = edge_block.child[e].load();
+                if (child == NO_NODE) {
+                    continue;
+                }
+                if (edge_block.visits[e].load() <= threshold) {
+                    edge_block.child[e].store(NO_NODE);
+                } else if (!reachable[child]) {
+                    reachable[child] = 1;
+                    stack.push_back(child);
+                }
+            }
+        }
+
+        // Sweep every other node (pruned subtrees, and slots orphaned by lost races) onto the free lists
+        long long swept = 0;
+        for (uint32_t node = 1; node < reachable.size(); ++node) {
+            NodeBlock& block = nodes.block(node);
+            uint32_t n = NodeArena::slot(node);
+            if (reachable[node] || block.state[n].load() == FREE) {
+                continue;
+            }
+            uint32_t count = block.num_edges[n];
+            if (block.state[n].load() == EXPANDED && count > 0) {
+                free_edges[count].push_back(block.edge_begin[n]);
+                live_edges.fetch_sub(count);
+            }
+            block.state[n].store(FREE);
+            free_nodes.push_back(node);
+            live_nodes.fetch_sub(1);
+            swept++;
+        }
+        freed += swept;
+
+        if (threshold > root_visits()) {
+            break; // Everything but the root's own edges is already cut
+        }
+    }
+
+    if (table) {
+        for (size_t i = 0; i < TABLE_SHARDS; ++i) {
+            for (auto it = table[i].entries.begin(); it != table[i].entries.end();) {
+                if (nodes.block(it->second).state[NodeArena::slot(it->second)].load() == FREE) {
+                    it = table[i].entries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    free_node_count.store(static_cast<long long>(free_nodes.size()));
+    for (uint32_t count = 0; count < MAX_EDGES; ++count) {
+        free_edge_count[count].store(static_cast<long long>(free_edges[count].size()));
+    }
+    pruned_count.fetch_add(freed);
+    return freed;
+}
+
+bool MCTS::over_budget() const {
+    return memory_budget != 0 && !budget_exhausted && live_memory() > memory_budget;
+}
+
+void MCTS::set_memory_budget(size_t bytes) {
+    memory_budget = bytes;
+}
+
+size_t MCTS::live_memory() const {
+    return static_cast<size_t>(live_nodes.load(std::memory_order_relaxed)) * NODE_BYTES +
+           static_cast<size_t>(live_edges.load(std::memory_order_relaxed)) * EDGE_BYTES;
+}
+
+long long MCTS::pruned_nodes() const {
+    return pruned_count.load();
+}
+
+void MCTS::set_transpositions(bool enabled) {
+    if (!enabled) {
+        table.reset();
+        return;
+    }
+    if (!table) {
+        table.reset(new TableShard[TABLE_SHARDS]);
+        find_or_insert(root_position->hash(), root);
+    }
+}
+
+long long MCTS::transposition_hits() const {
+    return hit_count.load();
+}
@@ -0,0 +1,499 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include "ChessBoard.h"
+#include "Arena.h"
+#include "types.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Network output for a single position.
+ * value is from the perspective of the side to move (1 = winning), and priors are aligned with
+ * the board's legal_moves().
+ */
+struct Evaluation {
+    float value = 0.0f;
+    std::vector<float> priors;
+};
+
+/**
+ * @brief Callback that evaluates a batch of positions, filling results[i] for boards[i].
+ * results is already sized to match boards.
+ */
+using Evaluator = std::function<void(const std::vector<const ChessBoard*>& boards, std::vector<Evaluation>& results)>;
+
+/**
+ * @brief Returns an evaluator that assigns uniform priors and a value of 0 to every position.
+ * Useful for benchmarking the search itself and for testing without a trained network.
+ */
+Evaluator uniform_evaluator();
+
+/**
+ * @brief Limits for an anytime search. The search stops at whichever limit is hit first; 0 means
+ * no limit, except for simulations, which is always the upper bound.
+ */
+struct SearchLimits {
+    int simulations = 800;          // Most simulations to run
+    double time_ms = 0.0;           // Wall-clock limit
+    long long nodes = 0;            // Stop once the tree holds this many nodes
+    size_t memory = 0;              // Stop once the tree's nodes and edges take this many bytes (see MCTS::live_memory(),
+                                    // which does not count the arenas' unused and freed slots)
+    bool early_stop = false;        // Stop once the most visited root move can no longer be overtaken
+};
+
+/**
+ * @brief Why a search stopped.
+ */
+enum class StopReason { SIMULATIONS, TIME, NODES, MEMORY, DECIDED };
+
+/**
+ * @brief What a limited search did.
+ */
+struct SearchStats {
+    float value = 0.0f;             // Root value (side to move perspective)
+    int simulations = 0;            // Simulations run
+    int saved = 0;                  // Simulations left unused out of SearchLimits::simulations
+    double elapsed_ms = 0.0;
+    StopReason reason = StopReason::SIMULATIONS;
+};
+
+/**
+ * @brief Monte Carlo Tree Search over ChessBoard positions guided by a policy/value evaluator.
+ *
+ * This is the native counterpart of MCTS_Deep in MCTS.py: nodes are selected with the PUCT
+ * formula, leaves are expanded with priors from the evaluator and the leaf value is backed up
+ * the path, flipping sign at every ply. Statistics live on the edges (visit count and value sum
+ * from the perspective of the player making the move).
+ *
+ * Leaves can be evaluated in batches: each iteration selects up to batch_size leaves, applying a
+ * virtual loss along every selected path so later selections in the same batch are pushed
+ * towards other parts of the tree, then evaluates them with one evaluator call.
+ *
+ * Several worker threads can search the same tree at once (tree parallelism). Node and edge
+ * statistics are lock-free atomics, each node is expanded by exactly one thread (claimed with a
+ * compare-and-swap on its state) and the virtual loss keeps the workers on different paths.
+ * The evaluator is then called concurrently from the workers and must be thread-safe.
+ *
+ * The tree is stored compactly: nodes and edges live in chunked struct-of-arrays arenas and refer
+ * to each other by 32-bit index, edges keep a packed 16-bit move and an fp16 prior, and nodes keep
+ * no position at all. A worker rebuilds a leaf's position by replaying the path's moves from the
+ * root (without move generation until the leaf). A node costs 24 bytes plus 20 bytes per edge.
+ *
+ * With transpositions enabled the tree becomes a DAG: a leaf whose position (ChessBoard::hash())
+ * already has a node is redirected to that node instead of being evaluated again, so all move
+ * orders share one set of statistics. This is safe for backup because Q values and visit counts
+ * live on the edges; a shared node only pools the parent visit count used for exploration. A move
+ * that repeats a position earlier on the current path still leads to that position's node (other
+ * move orders reaching the parent need not repeat it), but the simulation that took it is scored as
+ * a draw, which also keeps selection from cycling.
+ *
+ * An optional memory budget bounds the tree. When the nodes and edges in use exceed it, the workers
+ * pause and the least visited subtrees are cut off until usage drops to three quarters of the
+ * budget. A cut edge keeps its own visit count and value sum, so nothing learned about the move
+ * itself is lost, only the detail below it. Freed nodes and edge ranges go onto free lists and are
+ * reused before the arenas grow. The budget bounds the live tree, not the arenas: they grow in chunks,
+ * never shrink and keep the freed slots, so memory_usage() can end up well above the budget.
+ */
+class MCTS {
+public:
+    /**
+     * @brief Creates a search tree rooted at a copy of the given position.
+     * @param root The position to search from.
+     * @param evaluator Callback used to evaluate leaf positions.
+     * @param c_puct Exploration constant of the PUCT formula.
+     */
+    MCTS(const ChessBoard& root, Evaluator evaluator, float c_puct = 1.0f);
+    ~MCTS();
+
+    MCTS(const MCTS&) = delete;
+    MCTS& operator=(const MCTS&) = delete;
+
+    /**
+     * @brief Runs the given number of simulations from the root.
+     * @param num_simulations Number of leaves to evaluate and back up.
+     * @param batch_size Maximum number of leaves sent to the evaluator per call. Selections that
+     * land on a leaf already waiting for evaluation are discarded (a collision) and the batch is
+     * sent early once collisions reach batch_size, so batches can be smaller than this.
+     * @param num_threads Number of threads searching the tree; the calling thread is one of them.
+     * @return The root value estimate from the perspective of the side to move at the root.
+     */
+    float search(int num_simulations, int batch_size = 1, int num_threads = 1);
+
+    /**
+     * @brief Anytime search: runs until one of the limits is reached.
+     * With early_stop, the search ends as soon as the runner-up root move could not catch the most
+     * visited one even if it got every remaining simulation. Under a time limit the remaining
+     * simulations are estimated from the rate so far. The move chosen by best_move() can then no
+     * longer change, so the unused simulations are pure savings.
+     * @param limits When to stop.
+     * @param batch_size See search().
+     * @param num_threads See search().
+     * @return The root value, the simulations run and saved, the time taken and the reason for stopping.
+     */
+    SearchStats search(const SearchLimits& limits, int batch_size = 1, int num_threads = 1);
+
+    /**
+     * @brief Starts a search that the caller drives batch by batch instead of search(), so that one
+     * thread can interleave the leaves of many trees into common evaluator calls. Repeatedly call
+     * gather(), evaluate the positions it appended and pass the results to expand_gathered(), until
+     * gather() returns false; then call end_search(). The tree's own evaluator is not used. Only one
+     * thread may drive the search, and the tree must not be advanced or searched otherwise meanwhile.
+     * @param limits When to stop, as for search(); copied.
+     */
+    void begin_search(const SearchLimits& limits);
+
+    /**
+     * @brief Selects up to batch_size leaves for the search started by begin_search() and appends
+     * the positions needing evaluation to boards. Leaves that need none (terminal positions,
+     * repetitions, transpositions) are backed up right away, so a batch may append no positions.
+     * The positions stay valid until the batch is expanded or released.
+     * @return False once a limit is reached (nothing is appended then).
+     */
+    bool gather(int batch_size, std::vector<const ChessBoard*>& boards);
+
+    /**
+     * @brief Expands and backs up the leaves of the last gather() with their evaluations, one per
+     * position it appended, in order.
+     */
+    void expand_gathered(const Evaluation* results);
+
+    /**
+     * @brief Gives back the leaves of the last gather() unevaluated, e.g. when the evaluator failed.
+     */
+    void release_gathered();
+
+    /**
+     * @brief Finishes the search started by begin_search(), releasing any leaves still gathered.
+     * @return As for search().
+     */
+    SearchStats end_search();
+
+    /**
+     * @brief Moves the root to the position after the given move, keeping the statistics gathered
+     * for it. The played child's subtree (visits, priors and children) becomes the new tree and all
+     * sibling subtrees are freed. Must not be called while a search is running.
+     * @param move The move that was played from the current root.
+     * @return True on success, false if the move is not legal at the root (the tree is unchanged).
+     */
+    bool advance(const Move& move);
+
+    /**
+     * @brief Returns the visit count of every legal root move, in legal_moves() order.
+     */
+    std::vector<std::pair<Move, int>> root_visit_counts() const;
+
+    /**
+     * @brief Returns the most visited root move, or Move(-1, -1, -1, -1) if the root has no moves.
+     */
+    Move best_move() const;
+
+    /**
+     * @brief Returns the root value estimate (mean of all backed up values, side to move perspective).
+     */
+    float root_value() const;
+
+    /**
+     * @brief Returns the number of simulations that have passed through the root.
+     */
+    int root_visits() const;
+
+    /**
+     * @brief Returns the position at the root of the tree.
+     */
+    const ChessBoard& root_board() const;
+
+    /**
+     * @brief Returns the number of node slots allocated so far.
+     */
+    size_t num_nodes() const;
+
+    /**
+     * @brief Returns the bytes held by the node and edge arenas.
+     */
+    size_t memory_usage() const;
+
+    /**
+     * @brief Caps the bytes of nodes and edges in use (see live_memory()); 0 means no limit.
+     * If pruning cannot get under the budget (the tree is too shallow to cut), the search finishes
+     * over budget rather than stopping. Only live memory is capped: the arenas holding the tree
+     * (memory_usage()) never shrink and also keep the pruned slots, so they are larger than the budget.
+     */
+    void set_memory_budget(size_t bytes);
+
+    /**
+     * @brief Returns the bytes taken by the nodes and edges currently in the tree. The arenas
+     * (memory_usage()) also hold freed slots waiting for reuse and room not used yet, so they are larger.
+     */
+    size_t live_memory() const;
+
+    /**
+     * @brief Returns the number of nodes freed by pruning so far.
+     */
+    long long pruned_nodes() const;
+
+    /**
+     * @brief Turns the transposition table on or off. Nodes created before it is turned on are not
+     * in the table, so it is best set before the first search. Must not be called during a search.
+     */
+    void set_transpositions(bool enabled);
+
+    /**
+     * @brief Returns the number of leaves that were redirected to an existing node for the same position.
+     */
+    long long transposition_hits() const;
+
+    /**
+     * @brief Changes the PUCT exploration constant used by subsequent simulations.
+     */
+    void set_c_puct(float c_puct);
+
+    /**
+     * @brief Sets the virtual loss: the value assumed for every pending visit while a batch is selected.
+     */
+    void set_virtual_loss(float virtual_loss);
+
+    /**
+     * @brief Returns the number of selections discarded because they hit a leaf already being evaluated.
+     */
+    long long collisions() const;
+
+private:
+    // Expansion state of a node. Exactly one thread moves a node from NEW to CLAIMED; it then evaluates
+    // the node and publishes the edges by storing EXPANDED (release), so readers must load state first.
+    // FREE marks a pruned node waiting on the free list.
+    enum NodeState : uint8_t { NEW = 0, CLAIMED = 1, EXPANDED = 2, FREE = 3 };
+
+    // Node index 0 is a reserved sentinel, so a zeroed child slot means "no child yet".
+    static constexpr uint32_t NO_NODE = 0;
+
+    // Statistics are atomics so that worker threads can update them without locks
+    struct NodeBlock {
+        static constexpr uint32_t SIZE = 1u << 12;
+        uint32_t edge_begin[SIZE];              // Index of the node's first edge; its edges are contiguous
+        uint16_t num_edges[SIZE];
+        uint8_t terminal[SIZE];
+        std::atomic<uint8_t> state[SIZE];
+        float value[SIZE];                      // Evaluator (or terminal) value, side to move perspective
+        std::atomic<int32_t> visits[SIZE];
+        std::atomic<float> value_sum[SIZE];     // Sum of all values backed up through this node
+        std::atomic<int32_t> in_flight[SIZE];
+    };
+
+    struct EdgeBlock {
+        static constexpr uint32_t SIZE = 1u << 14;
+        uint16_t move[SIZE];                    // from_square * 64 + to_square, i.e. the policy index
+        uint16_t prior[SIZE];                   // fp16 (see Half.h)
+        std::atomic<int32_t> visits[SIZE];
+        std::atomic<float> value_sum[SIZE];     // Sum of backed up values, from the perspective of the player making the move
+        std::atomic<int32_t> in_flight[SIZE];   // Selected simulations still waiting for their leaf evaluation (virtual loss)
+        std::atomic<uint32_t> child[SIZE];      // Created the first time the edge is selected
+    };
+
+    using NodeArena = ChunkedArena<NodeBlock>;
+    using EdgeArena = ChunkedArena<EdgeBlock>;
+
+    static constexpr size_t NODE_BYTES = sizeof(NodeBlock) / NodeBlock::SIZE;
+    static constexpr size_t EDGE_BYTES = sizeof(EdgeBlock) / EdgeBlock::SIZE;
+    static constexpr uint32_t MAX_EDGES = 256;  // More than any chess position has legal moves
+
+    struct Leaf {
+        std::vector<std::pair<uint32_t, uint32_t>> path;   // (node, edge) pairs from the root
+        uint32_t node;
+        ChessBoard* board;
+        bool repetition = false;                           // node is already on the path (a cycle in the DAG)
+    };
+
+    // Transposition table: position hash -> node, split into shards with their own lock
+    struct TableShard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, uint32_t> entries;
+    };
+    static constexpr size_t TABLE_SHARDS = 64;
+
+    NodeArena nodes;
+    EdgeArena edges;
+    std::unique_ptr<ChessBoard> root_position;
+    uint32_t root;
+    Evaluator evaluator;
+    float c_puct;
+    float virtual_loss = 1.0f;
+    std::atomic<long long> collision_count{0};
+    std::unique_ptr<TableShard[]> table;    // Null while transpositions are off
+    std::atomic<long long> hit_count{0};
+
+    // Limits of the search in progress, checked by the workers before every batch
+    const SearchLimits* active_limits = nullptr;
+    std::chrono::steady_clock::time_point search_start;
+    std::atomic<int> stop_reason{static_cast<int>(StopReason::SIMULATIONS)};
+
+    // Search driven through begin_search() / gather()
+    SearchLimits step_limits;
+    int step_started = 0;
+    int step_visits_before = 0;
+    std::atomic<int> step_remaining{0};
+    std::vector<Leaf> step_leaves;
+    std::vector<std::unique_ptr<ChessBoard>> step_boards;
+
+    // Memory budget. The free lists are only filled by prune(), while no worker runs; workers take
+    // entries by decrementing the counts, which may go negative once a list is used up.
+    size_t memory_budget = 0;
+    bool budget_exhausted = false;
+    std::atomic<long long> live_nodes{0};
+    std::atomic<long long> live_edges{0};
+    std::atomic<long long> pruned_count{0};
+    std::vector<uint32_t> free_nodes;
+    std::atomic<long long> free_node_count{0};
+    std::vector<uint32_t> free_edges[MAX_EDGES];       // Indexed by the number of edges in the range
+    std::atomic<long long> free_edge_count[MAX_EDGES];
+
+    /**
+     * @brief Initializes a node slot to an unexpanded state.
+     */
+    static void init_node(NodeBlock& block, uint32_t n);
+
+    /**
+     * @brief Allocates a node in the given arena and initializes it to an unexpanded state.
+     */
+    static uint32_t new_node(NodeArena& arena);
+
+    /**
+     * @brief Allocates a tree node, reusing a pruned one if there is any.
+     */
+    uint32_t allocate_node();
+
+    /**
+     * @brief Allocates count contiguous edges, reusing a pruned range of the same length if there is any.
+     */
+    uint32_t allocate_edges(uint32_t count);
+
+    /**
+     * @brief Runs the workers until the budget of simulations is used up or the tree is over its memory budget.
+     */
+    void run_workers(std::atomic<int>& remaining, int batch_size, int num_threads, int started);
+
+    /**
+     * @brief Checks the active search limits and records the reason if one has been reached.
+     * @param remaining Simulations not yet claimed.
+     * @param started Simulations in the budget when the search started.
+     */
+    bool limit_reached(int remaining, int started);
+
+    /**
+     * @brief Whether the most visited root move can no longer be overtaken within the given number of simulations.
+     */
+    bool decided(double remaining) const;
+
+    /**
+     * @brief Whether the workers should stop so the tree can be pruned.
+     */
+    bool over_budget() const;
+
+    /**
+     * @brief Cuts the least visited subtrees until the tree is back under 3/4 of the memory budget
+     * and moves the freed nodes and edges to the free lists. Must not run during a search.
+     * @return The number of nodes freed.
+     */
+    long long prune();
+
+    /**
+     * @brief Empties the free lists (after compact() has rebuilt the arenas).
+     */
+    void reset_free_lists();
+
+    /**
+     * @brief Body of a search thread: gathers batches of leaves until the shared budget is used up.
+     * @param remaining Simulations not yet claimed by any thread.
+     * @param batch_size Maximum leaves per evaluator call.
+     * @param started Simulations in the budget when the search started (for the limits).
+     */
+    void run_worker(std::atomic<int>& remaining, int batch_size, int started);
+
+    /**
+     * @brief Selects leaves until batch_size of them need evaluation (or as many selections collided),
+     * claiming them and appending them and their positions to leaves and boards.
+     * @param scratch Reusable positions, one per leaf in the batch.
+     */
+    void gather_batch(std::atomic<int>& remaining, int batch_size, std::vector<Leaf>& leaves,
+                      std::vector<const ChessBoard*>& boards, std::vector<std::unique_ptr<ChessBoard>>& scratch);
+
+    /**
+     * @brief Expands the gathered leaves with results[i] for leaves[i], backs them up and clears leaves.
+     */
+    void expand_batch(std::vector<Leaf>& leaves, const Evaluation* results);
+
+    /**
+     * @brief Removes the virtual loss and claims of gathered leaves without evaluating them and clears leaves.
+     */
+    void release_batch(std::vector<Leaf>& leaves);
+
+    /**
+     * @brief Summarizes the search that started with the given budget and root visit count.
+     */
+    SearchStats search_stats(int started, int visits_before) const;
+
+    /**
+     * @brief Picks the edge maximizing Q + c_puct * P * sqrt(N) / (1 + n).
+     * Pending visits count as visits that returned -virtual_loss.
+     * @return The global index of the chosen edge.
+     */
+    uint32_t select_edge(uint32_t node) const;
+
+    /**
+     * @brief Walks from the root to a leaf, creating the leaf's node if needed and adding a
+     * virtual loss to every edge on the way. Stops early if the walk returns to a node already on
+     * the path, which can only happen with transpositions.
+     * @param leaf Receives the path from the root to the leaf's parent, the leaf node and whether it is a repetition.
+     */
+    void select_leaf(Leaf& leaf);
+
+    /**
+     * @brief Rebuilds the position at the end of a path by replaying its moves from the root.
+     */
+    void replay(const std::vector<std::pair<uint32_t, uint32_t>>& path, ChessBoard& board) const;
+
+    /**
+     * @brief Removes the virtual loss added by select_leaf() along a path.
+     */
+    void remove_virtual_loss(const std::vector<std::pair<uint32_t, uint32_t>>& path);
+
+    /**
+     * @brief Marks a claimed node terminal or fills its edges from an evaluation, then publishes it.
+     * @return The node's value from the perspective of its side to move.
+     */
+    float expand(uint32_t node, const ChessBoard* board, const Evaluation* evaluation);
+
+    /**
+     * @brief Sets the terminal flag and value if the position is game over.
+     * @return True if the node is terminal.
+     */
+    bool check_terminal(uint32_t node, const ChessBoard& board);
+
+    /**
+     * @brief Returns the node stored for a position key, storing the given node if there is none.
+     */
+    uint32_t find_or_insert(uint64_t key, uint32_t node);
+
+    /**
+     * @brief Adds a leaf value to every node and edge along the path.
+     * @param path The (node, edge) pairs from the root to the leaf's parent.
+     * @param leaf The leaf node, or NO_NODE to update the path only.
+     * @param value Leaf value from the perspective of the leaf's side to move.
+     */
+    void backup(const std::vector<std::pair<uint32_t, uint32_t>>& path, uint32_t leaf, float value);
+
+    /**
+     * @brief Copies the subtree below a node into fresh arenas and makes it the whole tree,
+     * releasing everything else.
+     */
+    void compact(uint32_t new_root);
+};
+
+#endif // MCTS_H
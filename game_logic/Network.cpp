@@ -0,0 +1,1049 @@
+#include "Network.h"
+#include "Cpu.h"
+#include "Kernels.h"
+#include "Policy.h"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef CHESS_X86
+#include <immintrin.h>
+#endif
+
+static constexpr int SQUARES = 64;
+static constexpr int POLICY_PLANES = 4;
+static constexpr int VALUE_PLANES = 2;
+static constexpr int HEAD_PLANES = POLICY_PLANES + VALUE_PLANES;
+static constexpr int CHUNK = 8;    // Positions per pass; bounds the im2col buffer to CHUNK * 64 rows
+
+// C[M][N] = act(A[M][K] B[K][N] + bias[N]), all row-major and dense. Columns [from, N) only.
+void gemm_scalar(const float* A, const float* B, const float* bias, float* C, int M, int N, int K, bool relu, int from) {
+    for (int i = 0; i < M; ++i) {
+        float* row = C + static_cast<size_t>(i) * N;
+        for (int j = from; j < N; ++j) {
+            row[j] = bias[j];
+        }
+        for (int k = 0; k < K; ++k) {
+            float a = A[static_cast<size_t>(i) * K + k];
+            const float* b = B + static_cast<size_t>(k) * N;
+            for (int j = from; j < N; ++j) {
+                row[j] += a * b[j];
+            }
+        }
+        if (relu) {
+            for (int j = from; j < N; ++j) {
+                row[j] = std::max(row[j], 0.0f);
+            }
+        }
+    }
+}
+
+#ifdef CHESS_X86
+// R rows x 32 columns of C in 2R zmm accumulators: per k, two loads of B and R broadcasts of A
+template <int R>
+__attribute__((target("avx512f")))
+static void tile_avx512(const float* A, const float* B, const float* bias, float* C, int N, int K, bool relu) {
+    __m512 acc[R][2];
+#pragma GCC unroll 8
+    for (int r = 0; r < R; ++r) {
+        acc[r][0] = _mm512_loadu_ps(bias);
+        acc[r][1] = _mm512_loadu_ps(bias + 16);
+    }
+    for (int k = 0; k < K; ++k) {
+        const float* b = B + static_cast<size_t>(k) * N;
+        __m512 b0 = _mm512_loadu_ps(b);
+        __m512 b1 = _mm512_loadu_ps(b + 16);
+#pragma GCC unroll 8
+        for (int r = 0; r < R; ++r) {
+            __m512 a = _mm512_set1_ps(A[static_cast<size_t>(r) * K + k]);
+            acc[r][0] = _mm512_fmadd_ps(a, b0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_ps(a, b1, acc[r][1]);
+        }
+    }
+    const __m512 zero = _mm512_setzero_ps();
+#pragma GCC unroll 8
+    for (int r = 0; r < R; ++r) {
+        if (relu) { // maskz form: GCC 12 warns about the undefined passthrough of _mm512_max_ps
+            acc[r][0] = _mm512_maskz_max_ps(0xFFFF, acc[r][0], zero);
+            acc[r][1] = _mm512_maskz_max_ps(0xFFFF, acc[r][1], zero);
+        }
+        _mm512_storeu_ps(C + static_cast<size_t>(r) * N, acc[r][0]);
+        _mm512_storeu_ps(C + static_cast<size_t>(r) * N + 16, acc[r][1]);
+    }
+}
+
+__attribute__((target("avx512f")))
+void gemm_avx512(const float* A, const float* B, const float* bias, float* C, int M, int N, int K, bool relu) {
+    int vector_cols = N - N % 32;
+    // Column slabs outermost, so each K x 32 slab of B stays in cache while every row tile uses it
+    for (int j = 0; j < vector_cols; j += 32) {
+        for (int i = 0; i < M; i += 8) {
+            const float* a = A + static_cast<size_t>(i) * K;
+            float* c = C + static_cast<size_t>(i) * N + j;
+            switch (std::min(8, M - i)) {
+                case 8: tile_avx512<8>(a, B + j, bias + j, c, N, K, relu); break;
+                case 7: tile_avx512<7>(a, B + j, bias + j, c, N, K, relu); break;
+                case 6: tile_avx512<6>(a, B + j, bias + j, c, N, K, relu); break;
+                case 5: tile_avx512<5>(a, B + j, bias + j, c, N, K, relu); break;
+                case 4: tile_avx512<4>(a, B + j, bias + j, c, N, K, relu); break;
+                case 3: tile_avx512<3>(a, B + j, bias + j, c, N, K, relu); break;
+                case 2: tile_avx512<2>(a, B + j, bias + j, c, N, K, relu); break;
+                default: tile_avx512<1>(a, B + j, bias + j, c, N, K, relu); break;
+            }
+        }
+    }
+    if (vector_cols < N) {
+        gemm_scalar(A, B, bias, C, M, N, K, relu, vector_cols);
+    }
+}
+
+// R rows x 16 columns in 2R ymm accumulators (R <= 6 leaves room for the B and A registers)
+template <int R>
+__attribute__((target("avx2,fma")))
+static void tile_avx2(const float* A, const float* B, const float* bias, float* C, int N, int K, bool relu) {
+    __m256 acc[R][2];
+#pragma GCC unroll 6
+    for (int r = 0; r < R; ++r) {
+        acc[r][0] = _mm256_loadu_ps(bias);
+        acc[r][1] = _mm256_loadu_ps(bias + 8);
+    }
+    for (int k = 0; k < K; ++k) {
+        const float* b = B + static_cast<size_t>(k) * N;
+        __m256 b0 = _mm256_loadu_ps(b);
+        __m256 b1 = _mm256_loadu_ps(b + 8);
+#pragma GCC unroll 6
+        for (int r = 0; r < R; ++r) {
+            __m256 a = _mm256_broadcast_ss(A + static_cast<size_t>(r) * K + k);
+            acc[r][0] = _mm256_fmadd_ps(a, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(a, b1, acc[r][1]);
+        }
+    }
+    const __m256 zero = _mm256_setzero_ps();
+#pragma GCC unroll 6
+    for (int r = 0; r < R; ++r) {
+        if (relu) {
+            acc[r][0] = _mm256_max_ps(acc[r][0], zero);
+            acc[r][1] = _mm256_max_ps(acc[r][1], zero);
+        }
+        _mm256_storeu_ps(C + static_cast<size_t>(r) * N, acc[r][0]);
+        _mm256_storeu_ps(C + static_cast<size_t>(r) * N + 8, acc[r][1]);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void gemm_avx2(const float* A, const float* B, const float* bias, float* C, int M, int N, int K, bool relu) {
+    int vector_cols = N - N % 16;
+    for (int j = 0; j < vector_cols; j += 16) {
+        for (int i = 0; i < M; i += 6) {
+            const float* a = A + static_cast<size_t>(i) * K;
+            float* c = C + static_cast<size_t>(i) * N + j;
+            switch (std::min(6, M - i)) {
+                case 6: tile_avx2<6>(a, B + j, bias + j, c, N, K, relu); break;
+                case 5: tile_avx2<5>(a, B + j, bias + j, c, N, K, relu); break;
+                case 4: tile_avx2<4>(a, B + j, bias + j, c, N, K, relu); break;
+                case 3: tile_avx2<3>(a, B + j, bias + j, c, N, K, relu); break;
+                case 2: tile_avx2<2>(a, B + j, bias + j, c, N, K, relu); break;
+                default: tile_avx2<1>(a, B + j, bias + j, c, N, K, relu); break;
+            }
+        }
+    }
+    if (vector_cols < N) {
+        gemm_scalar(A, B, bias, C, M, N, K, relu, vector_cols);
+    }
+}
+#endif
+
+void gemm(const float* A, const float* B, const float* bias, float* C, int M, int N, int K, bool relu) {
+#ifdef CHESS_X86
+    if (cpu_has_avx512()) {
+        gemm_avx512(A, B, bias, C, M, N, K, relu);
+        return;
+    }
+    if (cpu_has_avx2_fma()) {
+        gemm_avx2(A, B, bias, C, M, N, K, relu);
+        return;
+    }
+#endif
+    gemm_scalar(A, B, bias, C, M, N, K, relu);
+}
+
+const char* Network::kernel() {
+#ifdef CHESS_X86
+    if (cpu_has_avx512()) {
+        return "avx512";
+    }
+    if (cpu_has_avx2_fma()) {
+        return "avx2";
+    }
+#endif
+    return "scalar";
+}
+
+// INT8 GEMM: C[M][N] = act(sum(A[M][K] B[K][N]) * scales[N] + bias[N]), A unsigned 7-bit codes, B signed and
+// packed in groups of 4 inputs ((K / 4) x N x 4, K a multiple of 4). Columns [from, N) only.
+void gemm_int8_scalar(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C,
+                      int M, int N, int K, bool relu, int from) {
+    std::vector<int32_t> sums(N);
+    for (int i = 0; i < M; ++i) {
+        std::fill(sums.begin() + from, sums.end(), 0);
+        const uint8_t* a = A + static_cast<size_t>(i) * K;
+        for (int g = 0; g < K / 4; ++g) {
+            const int8_t* b = B + static_cast<size_t>(g) * N * 4;
+            for (int j = from; j < N; ++j) {
+                for (int t = 0; t < 4; ++t) {
+                    sums[j] += a[g * 4 + t] * b[j * 4 + t];
+                }
+            }
+        }
+        float* row = C + static_cast<size_t>(i) * N;
+        for (int j = from; j < N; ++j) {
+            row[j] = sums[j] * scales[j] + bias[j];
+            if (relu) {
+                row[j] = std::max(row[j], 0.0f);
+            }
+        }
+    }
+}
+
+#ifdef CHESS_X86
+static inline int32_t load_group(const uint8_t* codes) {
+    int32_t group;
+    std::memcpy(&group, codes, sizeof(group));
+    return group;
+}
+
+// R rows x 32 columns: per group of 4 inputs, two loads of B and R broadcast dot products
+template <int R>
+__attribute__((target("avx512f,avx512vnni")))
+static void tile_vnni(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C, int N, int K, bool relu) {
+    __m512i acc[R][2];
+#pragma GCC unroll 8
+    for (int r = 0; r < R; ++r) {
+        acc[r][0] = _mm512_setzero_si512();
+        acc[r][1] = _mm512_setzero_si512();
+    }
+    for (int g = 0; g < K / 4; ++g) {
+        const int8_t* b = B + static_cast<size_t>(g) * N * 4;
+        __m512i b0 = _mm512_loadu_si512(b);
+        __m512i b1 = _mm512_loadu_si512(b + 64);
+#pragma GCC unroll 8
+        for (int r = 0; r < R; ++r) {
+            __m512i a = _mm512_set1_epi32(load_group(A + static_cast<size_t>(r) * K + g * 4));
+            acc[r][0] = _mm512_dpbusd_epi32(acc[r][0], a, b0);
+            acc[r][1] = _mm512_dpbusd_epi32(acc[r][1], a, b1);
+        }
+    }
+    const __m512 s0 = _mm512_loadu_ps(scales), s1 = _mm512_loadu_ps(scales + 16);
+    const __m512 c0 = _mm512_loadu_ps(bias), c1 = _mm512_loadu_ps(bias + 16);
+    const __m512 zero = _mm512_setzero_ps();
+#pragma GCC unroll 8
+    for (int r = 0; r < R; ++r) {
+        __m512 out0 = _mm512_fmadd_ps(_mm512_maskz_cvtepi32_ps(0xFFFF, acc[r][0]), s0, c0);
+        __m512 out1 = _mm512_fmadd_ps(_mm512_maskz_cvtepi32_ps(0xFFFF, acc[r][1]), s1, c1);
+        if (relu) {
+            out0 = _mm512_maskz_max_ps(0xFFFF, out0, zero);
+            out1 = _mm512_maskz_max_ps(0xFFFF, out1, zero);
+        }
+        _mm512_storeu_ps(C + static_cast<size_t>(r) * N, out0);
+        _mm512_storeu_ps(C + static_cast<size_t>(r) * N + 16, out1);
+    }
+}
+
+__attribute__((target("avx512f,avx512vnni")))
+void gemm_int8_vnni(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C,
+                    int M, int N, int K, bool relu) {
+    int vector_cols = N - N % 32;
+    for (int j = 0; j < vector_cols; j += 32) {
+        const int8_t* b = B + static_cast<size_t>(j) * 4;
+        for (int i = 0; i < M; i += 8) {
+            const uint8_t* a = A + static_cast<size_t>(i) * K;
+            float* c = C + static_cast<size_t>(i) * N + j;
+            switch (std::min(8, M - i)) {
+                case 8: tile_vnni<8>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                case 7: tile_vnni<7>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                case 6: tile_vnni<6>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                case 5: tile_vnni<5>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                case 4: tile_vnni<4>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                case 3: tile_vnni<3>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                case 2: tile_vnni<2>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                default: tile_vnni<1>(a, b, scales + j, bias + j, c, N, K, relu); break;
+            }
+        }
+    }
+    if (vector_cols < N) {
+        gemm_int8_scalar(A, B, scales, bias, C, M, N, K, relu, vector_cols);
+    }
+}
+
+// R rows x 16 columns without VNNI: u8 x s8 pair sums to 16 bits (maddubs), then pairs of those to 32 bits (madd).
+// R <= 4 keeps the accumulators, B, A, the ones and a temporary within the 16 ymm registers.
+template <int R>
+__attribute__((target("avx2,fma")))
+static void tile_int8_avx2(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C, int N, int K, bool relu) {
+    __m256i acc[R][2];
+#pragma GCC unroll 4
+    for (int r = 0; r < R; ++r) {
+        acc[r][0] = _mm256_setzero_si256();
+        acc[r][1] = _mm256_setzero_si256();
+    }
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int g = 0; g < K / 4; ++g) {
+        const int8_t* b = B + static_cast<size_t>(g) * N * 4;
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 32));
+#pragma GCC unroll 4
+        for (int r = 0; r < R; ++r) {
+            __m256i a = _mm256_set1_epi32(load_group(A + static_cast<size_t>(r) * K + g * 4));
+            acc[r][0] = _mm256_add_epi32(acc[r][0], _mm256_madd_epi16(_mm256_maddubs_epi16(a, b0), ones));
+            acc[r][1] = _mm256_add_epi32(acc[r][1], _mm256_madd_epi16(_mm256_maddubs_epi16(a, b1), ones));
+        }
+    }
+    const __m256 s0 = _mm256_loadu_ps(scales), s1 = _mm256_loadu_ps(scales + 8);
+    const __m256 c0 = _mm256_loadu_ps(bias), c1 = _mm256_loadu_ps(bias + 8);
+    const __m256 zero = _mm256_setzero_ps();
+#pragma GCC unroll 4
+    for (int r = 0; r < R; ++r) {
+        __m256 out0 = _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc[r][0]), s0, c0);
+        __m256 out1 = _mm256_fmadd_ps(_mm256_cvtepi32_ps(acc[r][1]), s1, c1);
+        if (relu) {
+            out0 = _mm256_max_ps(out0, zero);
+            out1 = _mm256_max_ps(out1, zero);
+        }
+        _mm256_storeu_ps(C + static_cast<size_t>(r) * N, out0);
+        _mm256_storeu_ps(C + static_cast<size_t>(r) * N + 8, out1);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void gemm_int8_avx2(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C,
+                    int M, int N, int K, bool relu) {
+    int vector_cols = N - N % 16;
+    for (int j = 0; j < vector_cols; j += 16) {
+        const int8_t* b = B + static_cast<size_t>(j) * 4;
+        for (int i = 0; i < M; i += 4) {
+            const uint8_t* a = A + static_cast<size_t>(i) * K;
+            float* c = C + static_cast<size_t>(i) * N + j;
+            switch (std::min(4, M - i)) {
+                case 4: tile_int8_avx2<4>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                case 3: tile_int8_avx2<3>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                case 2: tile_int8_avx2<2>(a, b, scales + j, bias + j, c, N, K, relu); break;
+                default: tile_int8_avx2<1>(a, b, scales + j, bias + j, c, N, K, relu); break;
+            }
+        }
+    }
+    if (vector_cols < N) {
+        gemm_int8_scalar(A, B, scales, bias, C, M, N, K, relu, vector_cols);
+    }
+}
+#endif
+
+void gemm_int8(const uint8_t* A, const int8_t* B, const float* scales, const float* bias, float* C,
+               int M, int N, int K, bool relu) {
+#ifdef CHESS_X86
+    if (cpu_has_avx512_vnni()) {
+        gemm_int8_vnni(A, B, scales, bias, C, M, N, K, relu);
+        return;
+    }
+    if (cpu_has_avx2_fma()) {
+        gemm_int8_avx2(A, B, scales, bias, C, M, N, K, relu);
+        return;
+    }
+#endif
+    gemm_int8_scalar(A, B, scales, bias, C, M, N, K, relu);
+}
+
+// Dot products for gathering single policy outputs
+float dot_scalar(const float* a, const float* b, int n) {
+    float sums[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (int t = 0; t < 4; ++t) {
+            sums[t] += a[i + t] * b[i + t];
+        }
+    }
+    for (; i < n; ++i) {
+        sums[0] += a[i] * b[i];
+    }
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+int32_t dot_int8_scalar(const uint8_t* a, const int8_t* b, int n) {
+    int32_t sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+#ifdef CHESS_X86
+__attribute__((target("avx2,fma")))
+static inline float horizontal_sum(__m256 v) {
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_movehdup_ps(half));
+    return _mm_cvtss_f32(half);
+}
+
+__attribute__((target("avx2,fma")))
+static inline int32_t horizontal_sum(__m256i v) {
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+}
+
+// Halves via maskz extracts: GCC 12 warns about the undefined passthrough of _mm512_reduce_* and the 512 -> 256 casts
+__attribute__((target("avx512f")))
+float dot_avx512(const float* a, const float* b, int n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    __m512 acc = _mm512_add_ps(acc0, acc1);
+    __m256 lower = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(acc), 0));
+    __m256 upper = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(acc), 1));
+    float sum = horizontal_sum(_mm256_add_ps(lower, upper));
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+float dot_avx2(const float* a, const float* b, int n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    float sum = horizontal_sum(_mm256_add_ps(acc0, acc1));
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f,avx512vnni")))
+int32_t dot_int8_vnni(const uint8_t* a, const int8_t* b, int n) {
+    __m512i acc = _mm512_setzero_si512();
+    int i = 0;
+    for (; i + 64 <= n; i += 64) {
+        acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+    }
+    __m256i lower = _mm512_maskz_extracti64x4_epi64(0xF, acc, 0);
+    __m256i upper = _mm512_maskz_extracti64x4_epi64(0xF, acc, 1);
+    return horizontal_sum(_mm256_add_epi32(lower, upper)) + dot_int8_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+int32_t dot_int8_avx2(const uint8_t* a, const int8_t* b, int n) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i pairs = _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                             _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, ones));
+    }
+    return horizontal_sum(acc) + dot_int8_scalar(a + i, b + i, n - i);
+}
+#endif
+
+float dot(const float* a, const float* b, int n) {
+#ifdef CHESS_X86
+    if (cpu_has_avx512()) {
+        return dot_avx512(a, b, n);
+    }
+    if (cpu_has_avx2_fma()) {
+        return dot_avx2(a, b, n);
+    }
+#endif
+    return dot_scalar(a, b, n);
+}
+
+int32_t dot_int8(const uint8_t* a, const int8_t* b, int n) {
+#ifdef CHESS_X86
+    if (cpu_has_avx512_vnni()) {
+        return dot_int8_vnni(a, b, n);
+    }
+    if (cpu_has_avx2_fma()) {
+        return dot_int8_avx2(a, b, n);
+    }
+#endif
+    return dot_int8_scalar(a, b, n);
+}
+
+const char* Network::int8_kernel() {
+#ifdef CHESS_X86
+    if (cpu_has_avx512_vnni()) {
+        return "avx512vnni";
+    }
+    if (cpu_has_avx2_fma()) {
+        return "avx2";
+    }
+#endif
+    return "scalar";
+}
+
+// Rows of 3x3 patches: row (b, y, x) holds the 9 neighbours' channel vectors, zeros off the board.
+// Rows are stride values apart; anything past the 9 patches is zeroed (the INT8 rows are padded to groups of 4).
+template <typename T>
+static void im2col(const T* input, int batch, int channels, int stride, T* columns) {
+    size_t bytes = sizeof(T) * channels;
+    for (int b = 0; b < batch; ++b) {
+        for (int y = 0; y < 8; ++y) {
+            for (int x = 0; x < 8; ++x) {
+                T* row = columns + static_cast<size_t>((b * SQUARES + y * 8 + x)) * stride;
+                for (int ky = 0; ky < 3; ++ky) {
+                    for (int kx = 0; kx < 3; ++kx) {
+                        int sy = y + ky - 1;
+                        int sx = x + kx - 1;
+                        T* patch = row + (ky * 3 + kx) * channels;
+                        if (sy < 0 || sy >= 8 || sx < 0 || sx >= 8) {
+                            std::memset(patch, 0, bytes);
+                        } else {
+                            std::memcpy(patch, input + static_cast<size_t>(b * SQUARES + sy * 8 + sx) * channels, bytes);
+                        }
+                    }
+                }
+                std::memset(row + 9 * channels, 0, sizeof(T) * (stride - 9 * channels));
+            }
+        }
+    }
+}
+
+// 7-bit codes of rows x cols non-negative activations, written stride codes apart with zero padding
+static void quantize_activations(const float* x, size_t rows, int cols, int stride, float scale, uint8_t* codes) {
+    float inverse = 1.0f / scale;
+    for (size_t r = 0; r < rows; ++r) {
+        const float* in = x + r * cols;
+        uint8_t* out = codes + r * stride;
+        for (int c = 0; c < cols; ++c) {
+            out[c] = static_cast<uint8_t>(std::min(127.0f, in[c] * inverse + 0.5f));
+        }
+        std::memset(out + cols, 0, stride - cols);
+    }
+}
+
+static float largest(const float* values, size_t count) {
+    float result = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        result = std::max(result, values[i]);
+    }
+    return result;
+}
+
+static int round_up4(int n) {
+    return (n + 3) & ~3;
+}
+
+namespace {
+struct Scratch {
+    std::vector<float> input, columns, activations[2], heads, policy_in, value_in, hidden;
+    std::vector<uint8_t> codes, code_columns;
+};
+
+Scratch& thread_scratch() {
+    thread_local Scratch scratch;
+    return scratch;
+}
+
+// Sequential reads from a version 1 file
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    uint32_t word() {
+        uint32_t value = 0;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    std::vector<float> floats(size_t count) {
+        std::vector<float> values(count);
+        read(values.data(), count * sizeof(float));
+        return values;
+    }
+
+    bool at_end() const {
+        return offset == size;
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+
+    void read(void* out, size_t bytes) {
+        if (size - offset < bytes) {
+            throw std::runtime_error("network file is truncated");
+        }
+        std::memcpy(out, data + offset, bytes);
+        offset += bytes;
+    }
+};
+
+// Where each tensor of a version 2 file starts, in floats from the start of the file
+struct FileLayout {
+    size_t convs[3][2];
+    size_t heads[2];
+    size_t policy_fc[2];
+    size_t policy_rows;
+    size_t value_fc1[2];
+    size_t value_fc2[2];
+    size_t total;
+};
+
+FileLayout file_layout(int input_channels, int channels, int value_hidden) {
+    const size_t align = Network::FILE_ALIGNMENT / sizeof(float);
+    size_t offset = Network::FILE_HEADER_BYTES / sizeof(float);
+    auto take = [&offset, align](size_t count) {
+        size_t start = offset;
+        offset = (offset + count + align - 1) / align * align;
+        return start;
+    };
+    FileLayout layout;
+    for (int l = 0; l < 3; ++l) {
+        layout.convs[l][0] = take(static_cast<size_t>(9) * (l == 0 ? input_channels : channels) * channels);
+        layout.convs[l][1] = take(channels);
+    }
+    layout.heads[0] = take(static_cast<size_t>(channels) * HEAD_PLANES);
+    layout.heads[1] = take(HEAD_PLANES);
+    layout.policy_fc[0] = take(static_cast<size_t>(POLICY_PLANES) * SQUARES * POLICY_SIZE);
+    layout.policy_fc[1] = take(POLICY_SIZE);
+    layout.policy_rows = take(static_cast<size_t>(POLICY_SIZE) * POLICY_PLANES * SQUARES);
+    layout.value_fc1[0] = take(static_cast<size_t>(VALUE_PLANES) * SQUARES * value_hidden);
+    layout.value_fc1[1] = take(value_hidden);
+    layout.value_fc2[0] = take(value_hidden);
+    layout.value_fc2[1] = take(1);
+    layout.total = offset;
+    return layout;
+}
+
+std::shared_ptr<const uint8_t> map_file(const std::string& path, size_t& size) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open network file: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(2 * sizeof(uint32_t))) {
+        close(fd);
+        throw std::runtime_error("not a ChessCNN export: " + path);
+    }
+    size = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("cannot map network file: " + path);
+    }
+    madvise(data, size, MADV_WILLNEED);
+    return std::shared_ptr<const uint8_t>(static_cast<const uint8_t*>(data), [size](const uint8_t* p) {
+        munmap(const_cast<uint8_t*>(p), size);
+    });
+}
+}
+
+Network::Network(const std::string& path) {
+    size_t size = 0;
+    mapping = map_file(path, size);
+    load(size, path);
+}
+
+Network::Network(std::shared_ptr<const uint8_t> image, size_t size) : mapping(std::move(image)) {
+    if (reinterpret_cast<uintptr_t>(mapping.get()) % FILE_ALIGNMENT != 0) {
+        throw std::invalid_argument("network image must be 64-byte aligned");
+    }
+    load(size, "network image");
+}
+
+void Network::load(size_t size, const std::string& source) {
+    uint32_t header[5] = {0, 0, 0, 0, 0};
+    std::memcpy(header, mapping.get(), std::min(size, sizeof(header)));
+    if (header[0] != FILE_MAGIC) {
+        throw std::runtime_error("not a ChessCNN export: " + source);
+    }
+    if (header[1] == 1) {
+        convert_version1(mapping.get(), size);
+        mapping.reset();
+        bind(converted.data());
+        return;
+    }
+    if (header[1] != FILE_VERSION) {
+        throw std::runtime_error("unsupported network file version " + std::to_string(header[1]));
+    }
+    if (size < FILE_HEADER_BYTES) {
+        throw std::runtime_error("network file is truncated");
+    }
+    input_channels = static_cast<int>(header[2]);
+    num_channels = static_cast<int>(header[3]);
+    value_hidden = static_cast<int>(header[4]);
+    if (input_channels * SQUARES != STATE_TENSOR_SIZE || num_channels <= 0 || value_hidden <= 0) {
+        throw std::runtime_error("network file has unsupported dimensions");
+    }
+    if (size != file_layout(input_channels, num_channels, value_hidden).total * sizeof(float)) {
+        throw std::runtime_error("network file size does not match its dimensions");
+    }
+    bind(reinterpret_cast<const float*>(mapping.get()));
+}
+
+void Network::bind(const float* image) {
+    FileLayout layout = file_layout(input_channels, num_channels, value_hidden);
+    auto set = [image](Layer& layer, const size_t* offsets, int inputs, int outputs) {
+        layer.weights = image + offsets[0];
+        layer.bias = image + offsets[1];
+        layer.inputs = inputs;
+        layer.outputs = outputs;
+    };
+    for (int l = 0; l < 3; ++l) {
+        set(convs[l], layout.convs[l], 9 * (l == 0 ? input_channels : num_channels), num_channels);
+    }
+    set(heads, layout.heads, num_channels, HEAD_PLANES);
+    set(policy_fc, layout.policy_fc, POLICY_PLANES * SQUARES, POLICY_SIZE);
+    set(value_fc1, layout.value_fc1, VALUE_PLANES * SQUARES, value_hidden);
+    set(value_fc2, layout.value_fc2, value_hidden, 1);
+    policy_rows = image + layout.policy_rows;
+}
+
+void Network::convert_version1(const uint8_t* data, size_t size) {
+    Reader reader(data, size);
+    reader.word();
+    reader.word();
+    input_channels = static_cast<int>(reader.word());
+    num_channels = static_cast<int>(reader.word());
+    value_hidden = static_cast<int>(reader.word());
+    if (input_channels * SQUARES != STATE_TENSOR_SIZE || num_channels <= 0 || value_hidden <= 0) {
+        throw std::runtime_error("network file has unsupported dimensions");
+    }
+    FileLayout layout = file_layout(input_channels, num_channels, value_hidden);
+    converted.assign(layout.total, 0.0f);
+    float* image = converted.data();
+
+    // Exported in PyTorch layout (outputs x inputs [x 3 x 3]); stored here as inputs x outputs for the GEMM
+    for (int l = 0; l < 3; ++l) {
+        int in_channels = l == 0 ? input_channels : num_channels;
+        std::vector<float> weights = reader.floats(static_cast<size_t>(num_channels) * in_channels * 9);
+        std::vector<float> bias = reader.floats(num_channels);
+        float* conv = image + layout.convs[l][0];
+        for (int o = 0; o < num_channels; ++o) {
+            for (int c = 0; c < in_channels; ++c) {
+                for (int k = 0; k < 9; ++k) {
+                    conv[static_cast<size_t>(k * in_channels + c) * num_channels + o] = weights[(static_cast<size_t>(o) * in_channels + c) * 9 + k];
+                }
+            }
+        }
+        std::copy(bias.begin(), bias.end(), image + layout.convs[l][1]);
+    }
+
+    for (int head = 0; head < 2; ++head) {
+        int planes = head == 0 ? POLICY_PLANES : VALUE_PLANES;
+        int offset = head == 0 ? 0 : POLICY_PLANES;
+        std::vector<float> weights = reader.floats(static_cast<size_t>(planes) * num_channels);
+        std::vector<float> bias = reader.floats(planes);
+        for (int o = 0; o < planes; ++o) {
+            for (int c = 0; c < num_channels; ++c) {
+                image[layout.heads[0] + static_cast<size_t>(c) * HEAD_PLANES + offset + o] = weights[static_cast<size_t>(o) * num_channels + c];
+            }
+            image[layout.heads[1] + offset + o] = bias[o];
+        }
+    }
+
+    auto linear = [&reader, image](const size_t* offsets, int inputs, int outputs) {
+        std::vector<float> weights = reader.floats(static_cast<size_t>(outputs) * inputs);
+        std::vector<float> bias = reader.floats(outputs);
+        for (int o = 0; o < outputs; ++o) {
+            for (int i = 0; i < inputs; ++i) {
+                image[offsets[0] + static_cast<size_t>(i) * outputs + o] = weights[static_cast<size_t>(o) * inputs + i];
+            }
+        }
+        std::copy(bias.begin(), bias.end(), image + offsets[1]);
+        return weights;
+    };
+    std::vector<float> policy = linear(layout.policy_fc, POLICY_PLANES * SQUARES, POLICY_SIZE);
+    std::copy(policy.begin(), policy.end(), image + layout.policy_rows);
+    linear(layout.value_fc1, VALUE_PLANES * SQUARES, value_hidden);
+    linear(layout.value_fc2, value_hidden, 1);
+    if (!reader.at_end()) {
+        throw std::runtime_error("network file has trailing data");
+    }
+}
+
+void Network::evaluate(const float* states, int batch, float* values, float* logits) const {
+    evaluate(states, batch, values, logits, active_precision);
+}
+
+void Network::evaluate(const float* states, int batch, float* values, float* logits, Precision precision) const {
+    if (precision == Precision::INT8 && !is_quantized) {
+        throw std::logic_error("network has not been quantized");
+    }
+    for (int start = 0; start < batch; start += CHUNK) {
+        int count = std::min(CHUNK, batch - start);
+        evaluate_chunk(states + static_cast<size_t>(start) * STATE_TENSOR_SIZE, count,
+                       values + start, logits + static_cast<size_t>(start) * POLICY_SIZE, precision, nullptr);
+    }
+}
+
+void Network::evaluate_moves(const float* states, const std::vector<const std::vector<Move>*>& moves, std::vector<Evaluation>& results) const {
+    int batch = static_cast<int>(moves.size());
+    bool int8 = active_precision == Precision::INT8;
+    float values[CHUNK];
+    for (int start = 0; start < batch; start += CHUNK) {
+        int count = std::min(CHUNK, batch - start);
+        evaluate_chunk(states + static_cast<size_t>(start) * STATE_TENSOR_SIZE, count, values, nullptr, active_precision, nullptr);
+        Scratch& scratch = thread_scratch();
+        for (int b = 0; b < count; ++b) {
+            const float* features = scratch.policy_in.data() + static_cast<size_t>(b) * policy_fc.inputs;
+            const std::vector<Move>& legal = *moves[start + b];
+            Evaluation& result = results[start + b];
+            result.value = values[b];
+            result.priors.resize(legal.size());
+            if (int8) {
+                const QuantizedLayer& policy = int8_policy_fc;
+                quantize_activations(features, 1, policy_fc.inputs, policy.inputs, policy.input_scale, scratch.codes.data());
+                for (size_t m = 0; m < legal.size(); ++m) {
+                    int index = move_to_policy_index(legal[m]);
+                    int32_t sum = dot_int8(scratch.codes.data(), int8_policy_rows.data() + static_cast<size_t>(index) * policy.inputs, policy.inputs);
+                    result.priors[m] = sum * policy.scales[index] + policy.bias[index];
+                }
+            } else {
+                for (size_t m = 0; m < legal.size(); ++m) {
+                    int index = move_to_policy_index(legal[m]);
+                    result.priors[m] = dot(features, policy_rows + static_cast<size_t>(index) * policy_fc.inputs, policy_fc.inputs) + policy_fc.bias[index];
+                }
+            }
+            softmax(result.priors.data(), result.priors.size());
+        }
+    }
+}
+
+void Network::evaluate_chunk(const float* states, int batch, float* values, float* logits, Precision precision, float* ranges) const {
+    Scratch& scratch = thread_scratch();
+    bool int8 = precision == Precision::INT8;
+    size_t rows = static_cast<size_t>(batch) * SQUARES;
+    int widest = std::max(input_channels, num_channels);
+    scratch.input.resize(rows * input_channels);
+    scratch.columns.resize(rows * 9 * widest);
+    scratch.activations[0].resize(rows * num_channels);
+    scratch.activations[1].resize(rows * num_channels);
+    scratch.heads.resize(rows * HEAD_PLANES);
+    scratch.policy_in.resize(static_cast<size_t>(batch) * POLICY_PLANES * SQUARES);
+    scratch.value_in.resize(static_cast<size_t>(batch) * VALUE_PLANES * SQUARES);
+    scratch.hidden.resize(static_cast<size_t>(batch) * value_hidden);
+    if (int8) {
+        scratch.codes.resize(rows * round_up4(num_channels));
+        scratch.code_columns.resize(rows * round_up4(9 * num_channels));
+    }
+
+    // Planes (channel, square) -> channels-last (square, channel)
+    for (int b = 0; b < batch; ++b) {
+        for (int c = 0; c < input_channels; ++c) {
+            for (int s = 0; s < SQUARES; ++s) {
+                scratch.input[(static_cast<size_t>(b) * SQUARES + s) * input_channels + c] = states[static_cast<size_t>(b) * STATE_TENSOR_SIZE + c * SQUARES + s];
+            }
+        }
+    }
+
+    const float* x = scratch.input.data();
+    int channels = input_channels;
+    for (int l = 0; l < 3; ++l) {
+        float* out = scratch.activations[l % 2].data();
+        if (l > 0 && ranges) {
+            ranges[l - 1] = std::max(ranges[l - 1], largest(x, rows * channels));
+        }
+        if (l > 0 && int8) {
+            const QuantizedLayer& conv = int8_convs[l - 1];
+            quantize_activations(x, rows, channels, channels, conv.input_scale, scratch.codes.data());
+            im2col(scratch.codes.data(), batch, channels, conv.inputs, scratch.code_columns.data());
+            gemm_int8(scratch.code_columns.data(), conv.weights.data(), conv.scales.data(), conv.bias.data(), out,
+                      static_cast<int>(rows), num_channels, conv.inputs, true);
+        } else {
+            im2col(x, batch, channels, 9 * channels, scratch.columns.data());
+            gemm(scratch.columns.data(), convs[l].weights, convs[l].bias, out,
+                 static_cast<int>(rows), num_channels, convs[l].inputs, true);
+        }
+        x = out;
+        channels = num_channels;
+    }
+    gemm(x, heads.weights, heads.bias, scratch.heads.data(), static_cast<int>(rows), HEAD_PLANES, num_channels, true);
+
+    // Flatten the head planes in ChessCNN's (channel, square) order
+    for (int b = 0; b < batch; ++b) {
+        for (int s = 0; s < SQUARES; ++s) {
+            const float* planes = scratch.heads.data() + (static_cast<size_t>(b) * SQUARES + s) * HEAD_PLANES;
+            for (int c = 0; c < POLICY_PLANES; ++c) {
+                scratch.policy_in[(static_cast<size_t>(b) * POLICY_PLANES + c) * SQUARES + s] = planes[c];
+            }
+            for (int c = 0; c < VALUE_PLANES; ++c) {
+                scratch.value_in[(static_cast<size_t>(b) * VALUE_PLANES + c) * SQUARES + s] = planes[POLICY_PLANES + c];
+            }
+        }
+    }
+
+    if (ranges) {
+        ranges[2] = std::max(ranges[2], largest(scratch.policy_in.data(), scratch.policy_in.size()));
+        ranges[3] = std::max(ranges[3], largest(scratch.value_in.data(), scratch.value_in.size()));
+    }
+    if (int8) {
+        const QuantizedLayer& policy = int8_policy_fc;
+        const QuantizedLayer& value = int8_value_fc1;
+        if (logits) {
+            quantize_activations(scratch.policy_in.data(), batch, policy_fc.inputs, policy.inputs, policy.input_scale, scratch.codes.data());
+            gemm_int8(scratch.codes.data(), policy.weights.data(), policy.scales.data(), policy.bias.data(), logits,
+                      batch, POLICY_SIZE, policy.inputs, false);
+        }
+        quantize_activations(scratch.value_in.data(), batch, value_fc1.inputs, value.inputs, value.input_scale, scratch.codes.data());
+        gemm_int8(scratch.codes.data(), value.weights.data(), value.scales.data(), value.bias.data(), scratch.hidden.data(),
+                  batch, value_hidden, value.inputs, true);
+    } else {
+        if (logits) {
+            gemm(scratch.policy_in.data(), policy_fc.weights, policy_fc.bias, logits, batch, POLICY_SIZE, policy_fc.inputs, false);
+        }
+        gemm(scratch.value_in.data(), value_fc1.weights, value_fc1.bias, scratch.hidden.data(), batch, value_hidden, value_fc1.inputs, true);
+    }
+    gemm(scratch.hidden.data(), value_fc2.weights, value_fc2.bias, values, batch, 1, value_hidden, false);
+    for (int b = 0; b < batch; ++b) {
+        values[b] = std::tanh(values[b]);
+    }
+}
+
+Network::QuantizedLayer Network::quantize_layer(const Layer& layer, float input_range) {
+    QuantizedLayer result;
+    result.inputs = round_up4(layer.inputs);
+    result.outputs = layer.outputs;
+    result.input_scale = input_range > 0.0f ? input_range / 127.0f : 1.0f;
+    result.bias.assign(layer.bias, layer.bias + layer.outputs);
+    result.scales.resize(layer.outputs);
+    result.weights.assign(static_cast<size_t>(result.inputs) * layer.outputs, 0);
+    for (int o = 0; o < layer.outputs; ++o) {
+        float range = 0.0f;
+        for (int i = 0; i < layer.inputs; ++i) {
+            range = std::max(range, std::fabs(layer.weights[static_cast<size_t>(i) * layer.outputs + o]));
+        }
+        float scale = range > 0.0f ? range / 127.0f : 1.0f;
+        result.scales[o] = scale * result.input_scale;
+        for (int i = 0; i < layer.inputs; ++i) {
+            float code = std::round(layer.weights[static_cast<size_t>(i) * layer.outputs + o] / scale);
+            result.weights[(static_cast<size_t>(i / 4) * layer.outputs + o) * 4 + i % 4] = static_cast<int8_t>(code);
+        }
+    }
+    return result;
+}
+
+void Network::quantize(const float* states, int count) {
+    if (count <= 0) {
+        throw std::invalid_argument("quantization needs at least one calibration position");
+    }
+    float ranges[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    std::vector<float> values(CHUNK);
+    std::vector<float> logits(static_cast<size_t>(CHUNK) * POLICY_SIZE);
+    for (int start = 0; start < count; start += CHUNK) {
+        evaluate_chunk(states + static_cast<size_t>(start) * STATE_TENSOR_SIZE, std::min(CHUNK, count - start),
+                       values.data(), logits.data(), Precision::FP32, ranges);
+    }
+    int8_convs[0] = quantize_layer(convs[1], ranges[0]);
+    int8_convs[1] = quantize_layer(convs[2], ranges[1]);
+    int8_policy_fc = quantize_layer(policy_fc, ranges[2]);
+    int8_value_fc1 = quantize_layer(value_fc1, ranges[3]);
+    int inputs = int8_policy_fc.inputs;
+    int8_policy_rows.resize(static_cast<size_t>(POLICY_SIZE) * inputs);
+    for (int g = 0; g < inputs / 4; ++g) {
+        for (int o = 0; o < POLICY_SIZE; ++o) {
+            std::memcpy(&int8_policy_rows[static_cast<size_t>(o) * inputs + g * 4],
+                        &int8_policy_fc.weights[(static_cast<size_t>(g) * POLICY_SIZE + o) * 4], 4);
+        }
+    }
+    is_quantized = true;
+    active_precision = Precision::INT8;
+}
+
+QuantizationReport Network::compare_precision(const std::vector<const ChessBoard*>& boards) const {
+    if (!is_quantized) {
+        throw std::logic_error("network has not been quantized");
+    }
+    QuantizationReport report;
+    int batch = static_cast<int>(boards.size());
+    report.positions = batch;
+    if (batch == 0) {
+        return report;
+    }
+    std::vector<float> states(static_cast<size_t>(batch) * STATE_TENSOR_SIZE);
+    for (int b = 0; b < batch; ++b) {
+        boards[b]->copy_state_tensor(states.data() + static_cast<size_t>(b) * STATE_TENSOR_SIZE);
+    }
+    std::vector<float> values[2] = {std::vector<float>(batch), std::vector<float>(batch)};
+    std::vector<float> logits[2];
+    double* seconds[2] = {&report.fp32_seconds, &report.int8_seconds};
+    for (int p = 0; p < 2; ++p) {
+        logits[p].resize(static_cast<size_t>(batch) * POLICY_SIZE);
+        auto start = std::chrono::steady_clock::now();
+        evaluate(states.data(), batch, values[p].data(), logits[p].data(), p == 0 ? Precision::FP32 : Precision::INT8);
+        *seconds[p] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::vector<std::vector<float>> reference = masked_softmax_batch(logits[0].data(), boards);
+    std::vector<std::vector<float>> quantized = masked_softmax_batch(logits[1].data(), boards);
+    int agreements = 0;
+    for (int b = 0; b < batch; ++b) {
+        double error = std::fabs(values[1][b] - values[0][b]);
+        report.value_mae += error;
+        report.value_max_error = std::max(report.value_max_error, error);
+        const std::vector<float>& p = reference[b];
+        const std::vector<float>& q = quantized[b];
+        for (size_t m = 0; m < p.size(); ++m) {
+            if (p[m] > 0.0f) {
+                report.policy_kl += p[m] * std::log(p[m] / std::max(q[m], 1e-12f));
+            }
+        }
+        if (!p.empty() && std::max_element(p.begin(), p.end()) - p.begin() == std::max_element(q.begin(), q.end()) - q.begin()) {
+            agreements++;
+        }
+    }
+    report.value_mae /= batch;
+    report.policy_kl /= batch;
+    report.top1_agreement = static_cast<double>(agreements) / batch;
+    return report;
+}
+
+void Network::set_precision(Precision precision) {
+    if (precision == Precision::INT8 && !is_quantized) {
+        throw std::logic_error("network has not been quantized");
+    }
+    active_precision = precision;
+}
+
+Precision Network::precision() const {
+    return active_precision;
+}
+
+bool Network::quantized() const {
+    return is_quantized;
+}
+
+int Network::channels() const {
+    return num_channels;
+}
+
+bool Network::mapped() const {
+    return mapping != nullptr;
+}
+
+BatchNetwork native_network(std::shared_ptr<const Network> network) {
+    return [network](const float* states, int batch, float* values, float* logits) {
+        network->evaluate(states, batch, values, logits);
+    };
+}
+
+LegalNetwork legal_network(std::shared_ptr<const Network> network) {
+    return [network](const float* states, const std::vector<const std::vector<Move>*>& moves, std::vector<Evaluation>& results) {
+        network->evaluate_moves(states, moves, results);
+    };
+}
@@ -0,0 +1,201 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include "InferenceServer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Arithmetic used by Network::evaluate().
+ */
+enum class Precision {
+    FP32,
+    INT8        // Quantized by Network::quantize(); the first convolution, the 1x1 heads and value_fc2 stay fp32
+};
+
+/**
+ * @brief How far INT8 inference is from FP32 on a set of positions (see Network::compare_precision()).
+ */
+struct QuantizationReport {
+    int positions = 0;
+    double value_mae = 0.0;         // Mean |value_int8 - value_fp32|
+    double value_max_error = 0.0;
+    double policy_kl = 0.0;         // Mean KL(fp32 || int8) of the priors over the legal moves, in nats
+    double top1_agreement = 0.0;    // Fraction of positions whose most likely legal move is the same
+    double fp32_seconds = 0.0;      // Time to evaluate all positions in one batch
+    double int8_seconds = 0.0;
+};
+
+/**
+ * @brief ChessCNN evaluated natively on the CPU.
+ *
+ * Loads weights exported by ChessCNN.export_native() (batch norm already folded into the
+ * convolutions) and runs the same network as ChessCNN._network_forward: three 3x3 convolutions,
+ * then the policy head (1x1 convolution, 4096 logits) and the value head (1x1 convolution, two
+ * fully connected layers, tanh). Activations are kept channels-last, convolutions run as
+ * im2col + GEMM, and the GEMM kernel is picked at run time: AVX-512, AVX2/FMA or portable C++.
+ * quantize() adds an INT8 mode for the second and third convolutions, policy_fc and value_fc1, which
+ * hold nearly all of the weights and multiply-adds (integer dot products with AVX-512 VNNI or AVX2).
+ *
+ * evaluate() has the BatchNetwork signature, so the network plugs into network_evaluator() or an
+ * InferenceServer and search runs without Python. evaluate_moves() (the LegalNetwork signature) is the
+ * cheaper way to do that: it skips the policy logits of moves that are not legal, about 99% of them.
+ * Both are const and keep their scratch buffers per thread, so any number of threads may evaluate at once.
+ *
+ * File format (version 2): a 64-byte header of little-endian uint32 words (magic, version,
+ * input_channels, channels, value_hidden, zero padding), then the float32 tensors in the layouts used
+ * here, each starting on a FILE_ALIGNMENT boundary: conv1, conv2, conv3 (weights, bias), heads (weights,
+ * bias), policy_fc (weights, bias), policy_fc transposed, value_fc1 and value_fc2 (weights, bias).
+ * The file is mapped read-only and evaluated in place, so loading takes no copies and every process
+ * using the same file shares one copy of the weights in the page cache. Replace a published file by
+ * renaming a new one over it, never by rewriting it in place. Version 1 files (PyTorch layouts, packed)
+ * are still read, by converting them into memory.
+ */
+class Network {
+public:
+    static constexpr uint32_t FILE_MAGIC = 0x4E4E4343;  // "CCNN"
+    static constexpr uint32_t FILE_VERSION = 2;
+    static constexpr size_t FILE_ALIGNMENT = 64;
+    static constexpr size_t FILE_HEADER_BYTES = 64;
+
+    /**
+     * @brief Maps (version 2) or reads (version 1) an exported network.
+     * @throws std::runtime_error if the file cannot be read or is not a valid export.
+     */
+    explicit Network(const std::string& path);
+
+    /**
+     * @brief Uses an export already in memory (e.g. read from a WeightSlot) in place.
+     * @param image The file contents, aligned to FILE_ALIGNMENT; kept alive by the network.
+     * @throws std::invalid_argument if the image is misaligned, std::runtime_error if it is not a valid export.
+     */
+    Network(std::shared_ptr<const uint8_t> image, size_t size);
+
+    Network(const Network&) = delete;
+    Network& operator=(const Network&) = delete;
+
+    /**
+     * @brief Runs batch positions (batch x STATE_TENSOR_SIZE floats, as from copy_state_tensor())
+     * and writes one value and POLICY_SIZE policy logits per position.
+     */
+    void evaluate(const float* states, int batch, float* values, float* logits) const;
+
+    /**
+     * @brief As evaluate(), at the given precision instead of precision().
+     * @throws std::logic_error if INT8 is asked for before quantize().
+     */
+    void evaluate(const float* states, int batch, float* values, float* logits, Precision precision) const;
+
+    /**
+     * @brief Evaluates positions but computes only the policy logits of the given moves: one gathered
+     * row of policy_fc per move instead of all POLICY_SIZE, softmaxed over those moves alone.
+     * Has the LegalNetwork signature; results[b] gets the value and priors aligned with *moves[b].
+     */
+    void evaluate_moves(const float* states, const std::vector<const std::vector<Move>*>& moves, std::vector<Evaluation>& results) const;
+
+    /**
+     * @brief Post-training quantization to INT8, then switches evaluate() to it.
+     *
+     * The calibration positions are run in FP32 to record the largest input of every quantized layer;
+     * activations (all ReLU outputs) are then coded as 7-bit unsigned integers over that range, and the
+     * weights as 8-bit signed integers with one scale per output. 7 bits keep the AVX2 kernel's 16-bit
+     * pair sums from saturating, so every kernel computes exactly the same result.
+     * Must not run while other threads evaluate the network.
+     * @param states count positions, as for evaluate(); a few hundred positions from real games is enough.
+     * @throws std::invalid_argument if count is not positive.
+     */
+    void quantize(const float* states, int count);
+
+    /**
+     * @brief Evaluates boards at both precisions and measures the difference.
+     * @throws std::logic_error if the network has not been quantized.
+     */
+    QuantizationReport compare_precision(const std::vector<const ChessBoard*>& boards) const;
+
+    /**
+     * @brief Selects the precision evaluate() uses. Must not change while other threads evaluate the network.
+     * @throws std::logic_error if INT8 is selected before quantize().
+     */
+    void set_precision(Precision precision);
+    Precision precision() const;
+    bool quantized() const;
+
+    int channels() const;
+
+    /**
+     * @brief True if the weights are used in place from the mapped file (version 2), false if they were converted.
+     */
+    bool mapped() const;
+
+    /**
+     * @brief Name of the GEMM kernel in use: "avx512", "avx2" or "scalar".
+     */
+    static const char* kernel();
+
+    /**
+     * @brief Name of the INT8 GEMM kernel in use: "avx512vnni", "avx2" or "scalar".
+     */
+    static const char* int8_kernel();
+
+private:
+    struct Layer {
+        const float* weights = nullptr; // inputs x outputs, row-major (one row per input)
+        const float* bias = nullptr;    // outputs
+        int inputs = 0;
+        int outputs = 0;
+    };
+
+    struct QuantizedLayer {
+        std::vector<int8_t> weights;    // (inputs / 4) x outputs x 4: each 32-bit lane holds 4 consecutive inputs of one output
+        std::vector<float> scales;      // outputs; input scale x weight scale, turns the int32 sums back into floats
+        std::vector<float> bias;        // outputs
+        int inputs = 0;                 // Padded to a multiple of 4
+        int outputs = 0;
+        float input_scale = 1.0f;       // Activation x = input_scale * code, code in [0, 127]
+    };
+
+    std::shared_ptr<const uint8_t> mapping;     // The mapped file (or in-memory image); released when the network goes away
+    std::vector<float> converted;               // A version 1 file, converted into the version 2 layout
+    int input_channels = 0;
+    int num_channels = 0;
+    int value_hidden = 0;
+    Layer convs[3];                     // 3x3 convolutions; input index (ky * 3 + kx) * in_channels + c
+    Layer heads;                        // Policy (4) and value (2) 1x1 convolutions side by side
+    Layer policy_fc;                    // 4 * 64 -> POLICY_SIZE, inputs in ChessCNN's (channel, square) order
+    Layer value_fc1;                    // 2 * 64 -> value_hidden
+    Layer value_fc2;                    // value_hidden -> 1
+    const float* policy_rows = nullptr; // policy_fc transposed (POLICY_SIZE x inputs), so one output's weights are contiguous
+
+    Precision active_precision = Precision::FP32;
+    bool is_quantized = false;
+    QuantizedLayer int8_convs[2];       // convs[1] and convs[2]
+    QuantizedLayer int8_policy_fc;
+    QuantizedLayer int8_value_fc1;
+    std::vector<int8_t> int8_policy_rows;   // int8_policy_fc transposed (POLICY_SIZE x padded inputs)
+
+    static QuantizedLayer quantize_layer(const Layer& layer, float input_range);
+
+    // Checks the header of the export in mapping and binds it (converting a version 1 export)
+    void load(size_t size, const std::string& source);
+    // Points the layers at the tensors of a version 2 image (the mapped file or the converted buffer)
+    void bind(const float* image);
+    void convert_version1(const uint8_t* data, size_t size);
+
+    // ranges (if given) receives the largest input seen by each quantized layer, in the order above.
+    // Without logits the policy head stops at its inputs, which are left in the thread's scratch buffers.
+    void evaluate_chunk(const float* states, int batch, float* values, float* logits, Precision precision, float* ranges) const;
+};
+
+/**
+ * @brief Wraps a native network as a BatchNetwork.
+ */
+BatchNetwork native_network(std::shared_ptr<const Network> network);
+
+/**
+ * @brief Wraps a native network as a LegalNetwork (see Network::evaluate_moves()).
+ */
+LegalNetwork legal_network(std::shared_ptr<const Network> network);
+
+#endif // NETWORK_H
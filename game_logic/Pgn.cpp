@@ -0,0 +1,450 @@
+#include "Pgn.h"
+#include "Policy.h"
+#include "Replay.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char UNDERPROMOTION[] = "underpromotion is not supported";
+
+static bool is_file(char c) { return c >= 'a' && c <= 'h'; }
+static bool is_rank(char c) { return c >= '1' && c <= '8'; }
+
+// Finds the legal move written as san. Returns nullptr on success, otherwise why it failed
+// (UNDERPROMOTION for a promotion the engine cannot play)
+static const char* resolve_san(const ChessBoard& board, std::string_view san, Move& move) {
+    while (!san.empty() && std::strchr("+#!?", san.back()) != nullptr) {
+        san.remove_suffix(1);
+    }
+    if (san.empty()) {
+        return "empty move";
+    }
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        int home = board.get_turn() == Color::WHITE ? 0 : 7;
+        Move castle(home, 4, home, san.size() == 3 ? 6 : 2);
+        const Piece* king = board._board[home][4];
+        const std::vector<Move>& moves = board.legal_moves();
+        if (king == nullptr || king->get_type() != 'k' || std::find(moves.begin(), moves.end(), castle) == moves.end()) {
+            return "illegal castling";
+        }
+        move = castle;
+        return nullptr;
+    }
+
+    char type = 'p';
+    if (std::strchr("KQRBNP", san.front()) != nullptr) {
+        type = static_cast<char>(san.front() - 'A' + 'a');
+        san.remove_prefix(1);
+    }
+    char promotion = 0;
+    size_t equals = san.find('=');
+    if (equals != std::string_view::npos) {
+        promotion = equals + 1 < san.size() ? san[equals + 1] : '?';
+        san = san.substr(0, equals);
+    } else if (!san.empty() && std::strchr("QRBNqrbn", san.back()) != nullptr) {
+        promotion = san.back();
+        san.remove_suffix(1);
+    }
+    if (promotion != 0 && promotion != 'Q' && promotion != 'q') {
+        return std::strchr("RBNrbn", promotion) != nullptr ? UNDERPROMOTION : "bad promotion";
+    }
+
+    if (san.size() < 2 || !is_file(san[san.size() - 2]) || !is_rank(san[san.size() - 1])) {
+        return "not a SAN move";
+    }
+    Coords to(san[san.size() - 1] - '1', san[san.size() - 2] - 'a');
+    san.remove_suffix(2);
+    int from_file = -1;
+    int from_rank = -1;
+    for (char c : san) {
+        if (is_file(c)) {
+            from_file = c - 'a';
+        } else if (is_rank(c)) {
+            from_rank = c - '1';
+        } else if (c != 'x' && c != '-' && c != ':') {
+            return "not a SAN move";
+        }
+    }
+
+    const Move* match = nullptr;
+    for (const Move& candidate : board.legal_moves()) {
+        if (candidate.to != to || (from_file >= 0 && candidate.from.y != from_file) || (from_rank >= 0 && candidate.from.x != from_rank)) {
+            continue;
+        }
+        const Piece* piece = board._board[candidate.from.x][candidate.from.y];
+        if (piece == nullptr || piece->get_type() != type) {
+            continue;
+        }
+        if (match != nullptr) {
+            return "ambiguous move";
+        }
+        match = &candidate;
+    }
+    if (match == nullptr) {
+        return "illegal move";
+    }
+    move = *match;
+    return nullptr;
+}
+
+Move parse_san(const ChessBoard& board, const std::string& san) {
+    Move move;
+    if (const char* error = resolve_san(board, san, move)) {
+        throw std::invalid_argument(std::string(error) + ": " + san);
+    }
+    return move;
+}
+
+namespace {
+
+// The parts of a PGN game that ingestion needs, pointing into the mapped file
+struct PgnGame {
+    std::string_view result;        // Result tag, or the termination marker if there is no tag
+    bool custom_start = false;      // FEN or SetUp tag
+    bool variant = false;           // Variant tag other than standard chess
+    bool has_content = false;
+    std::vector<std::string_view> moves;
+
+    void clear() {
+        result = std::string_view();
+        custom_start = false;
+        variant = false;
+        has_content = false;
+        moves.clear();
+    }
+};
+
+bool is_result(std::string_view token) {
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+}
+
+// Start of the first game at or after offset: a line opening a tag section, i.e. starting with '['
+// with no tag line right before it
+size_t next_game_start(const char* data, size_t size, size_t offset) {
+    if (offset == 0) {
+        return 0;
+    }
+    size_t line = offset;
+    while (line < size && data[line - 1] != '\n') {
+        line++;
+    }
+    while (line < size) {
+        if (data[line] == '[') {
+            size_t previous = line;
+            while (previous > 0 && std::strchr(" \t\r\n", data[previous - 1]) != nullptr) {
+                previous--;
+            }
+            if (previous == 0) {
+                return line;
+            }
+            size_t previous_line = previous - 1;
+            while (previous_line > 0 && data[previous_line - 1] != '\n') {
+                previous_line--;
+            }
+            if (data[previous_line] != '[') {
+                return line;
+            }
+        }
+        const void* newline = std::memchr(data + line, '\n', size - line);
+        line = newline == nullptr ? size : static_cast<size_t>(static_cast<const char*>(newline) - data) + 1;
+    }
+    return size;
+}
+
+// Replays games on one board and appends their positions to one shard
+class GameIngester {
+public:
+    GameIngester(const std::string& path, const IngestConfig& config, std::atomic<uint32_t>& next_game)
+        : writer(path), config(config), next_game(next_game) {}
+
+    void ingest(const PgnGame& game) {
+        int outcome;
+        if (game.result == "1-0") {
+            outcome = 1;
+        } else if (game.result == "0-1") {
+            outcome = -1;
+        } else if (game.result == "1/2-1/2") {
+            outcome = 0;
+        } else {
+            stats.skipped++;
+            return;
+        }
+        if (game.custom_start || game.variant || static_cast<int>(game.moves.size()) < config.min_plies) {
+            stats.skipped++;
+            return;
+        }
+
+        board = start;
+        positions.clear();
+        moves.clear();
+        bool truncated = false;
+        for (std::string_view san : game.moves) {
+            Move move;
+            if (const char* error = resolve_san(board, san, move)) {
+                if (error != UNDERPROMOTION) {
+                    stats.skipped++;
+                    return;
+                }
+                truncated = true;
+                break;
+            }
+            positions.push_back(pack_position(board));
+            moves.push_back(static_cast<uint16_t>(move_to_policy_index(move)));
+            board.play_unchecked(move);
+            board.refresh();
+        }
+        if (positions.empty()) {
+            stats.skipped++;
+            return;
+        }
+
+        int plies = static_cast<int>(positions.size());
+        uint32_t id = next_game.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 0; i < plies; ++i) {
+            int side = positions[i].flags & PackedPosition::BLACK_TO_MOVE ? -1 : 1;
+            played[0].move = moves[i];
+            writer.append(positions[i], played, outcome * side, id, i, plies, config.generation);
+        }
+        stats.games++;
+        stats.positions += plies;
+        if (truncated) {
+            stats.truncated++;
+        }
+    }
+
+    IngestStats finish() {
+        writer.flush();
+        return stats;
+    }
+
+private:
+    ShardWriter writer;
+    IngestConfig config;
+    std::atomic<uint32_t>& next_game;       // Game ids, shared by every thread's ingester
+    const ChessBoard start;
+    ChessBoard board;
+    std::vector<PackedPosition> positions;
+    std::vector<uint16_t> moves;
+    std::vector<VisitCount> played{{0, 1}};    // One-hot policy target
+    IngestStats stats;
+};
+
+// Parses the games in data[begin, end) and hands each to the ingester
+void parse_games(const char* data, size_t begin, size_t end, GameIngester& ingester) {
+    PgnGame game;
+    size_t p = begin;
+    auto finish_game = [&]() {
+        if (game.has_content) {
+            ingester.ingest(game);
+        }
+        game.clear();
+    };
+
+    while (p < end) {
+        char c = data[p];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            p++;
+        } else if (c == '[') {
+            // A tag after movetext starts the next game (the previous one had no termination marker)
+            if (!game.moves.empty()) {
+                finish_game();
+            }
+            game.has_content = true;
+            size_t close = p;
+            while (close < end && data[close] != '\n') {
+                close++;
+            }
+            std::string_view tag(data + p + 1, close - p - 1);
+            size_t space = tag.find(' ');
+            size_t open_quote = tag.find('"');
+            size_t close_quote = tag.rfind('"');
+            if (space != std::string_view::npos && open_quote != std::string_view::npos && close_quote > open_quote) {
+                std::string_view name = tag.substr(0, space);
+                std::string_view value = tag.substr(open_quote + 1, close_quote - open_quote - 1);
+                if (name == "Result") {
+                    game.result = value;
+                } else if ((name == "FEN" && !value.empty()) || (name == "SetUp" && value == "1")) {
+                    game.custom_start = true;
+                } else if (name == "Variant" && value != "Standard" && value != "standard" && value != "Chess") {
+                    game.variant = true;
+                }
+            }
+            p = close;
+        } else if (c == '{') {
+            const void* close = std::memchr(data + p, '}', end - p);
+            p = close == nullptr ? end : static_cast<size_t>(static_cast<const char*>(close) - data) + 1;
+        } else if (c == ';' || (c == '%' && (p == 0 || data[p - 1] == '\n'))) {
+            const void* newline = std::memchr(data + p, '\n', end - p);
+            p = newline == nullptr ? end : static_cast<size_t>(static_cast<const char*>(newline) - data) + 1;
+        } else if (c == '(') {
+            int depth = 0;
+            for (; p < end; ++p) {
+                if (data[p] == '{') {
+                    const void* close = std::memchr(data + p, '}', end - p);
+                    p = close == nullptr ? end - 1 : static_cast<size_t>(static_cast<const char*>(close) - data);
+                } else if (data[p] == '(') {
+                    depth++;
+                } else if (data[p] == ')' && --depth == 0) {
+                    p++;
+                    break;
+                }
+            }
+        } else {
+            size_t token_end = p;
+            while (token_end < end && std::strchr(" \t\r\n{}();[", data[token_end]) == nullptr) {
+                token_end++;
+            }
+            std::string_view token(data + p, token_end - p);
+            p = token_end == p ? p + 1 : token_end; // Skip a stray ')' or ']'
+            game.has_content = true;
+            if (token.empty() || token.front() == '$' || token == "e.p.") {
+                continue;
+            }
+            if (is_result(token)) {
+                if (game.result.empty() || !is_result(game.result)) {
+                    game.result = token;
+                }
+                finish_game();
+                continue;
+            }
+            // Move numbers ("12.", "12...") may be glued to the move ("12.e4")
+            size_t digits = 0;
+            while (digits < token.size() && token[digits] >= '0' && token[digits] <= '9') {
+                digits++;
+            }
+            if (digits > 0 && digits < token.size() && token[digits] == '.') {
+                token.remove_prefix(digits);
+            }
+            while (!token.empty() && token.front() == '.') {
+                token.remove_prefix(1);
+            }
+            if (!token.empty() && (token.front() < '0' || token.front() > '9' || token.front() == '0')) {
+                game.moves.push_back(token);
+            }
+        }
+    }
+    finish_game();
+}
+
+// Path of a shard `<out_prefix>-<digits>.shard` that already exists, or an empty string
+std::string existing_shard(const std::string& out_prefix) {
+    std::filesystem::path prefix(out_prefix);
+    std::filesystem::path directory = prefix.parent_path().empty() ? "." : prefix.parent_path();
+    std::string stem = prefix.filename().string() + "-";
+    std::error_code failure;
+    std::filesystem::directory_iterator listing(directory, failure);
+    if (failure) {
+        return "";  // Left to the ShardWriter to report
+    }
+    for (const auto& entry : listing) {
+        std::string name = entry.path().filename().string();
+        if (name.size() <= stem.size() + 6 || name.compare(0, stem.size(), stem) != 0 ||
+            name.compare(name.size() - 6, 6, ".shard") != 0) {
+            continue;
+        }
+        std::string_view number(name.data() + stem.size(), name.size() - stem.size() - 6);
+        if (std::all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            return entry.path().string();
+        }
+    }
+    return "";
+}
+
+} // namespace
+
+IngestStats ingest_pgn(const std::string& pgn_path, const std::string& out_prefix, const IngestConfig& config) {
+    auto start = std::chrono::steady_clock::now();
+    // Appending to the shards of an earlier run would duplicate its games
+    std::string existing = existing_shard(out_prefix);
+    if (!existing.empty()) {
+        throw std::runtime_error("shard already exists: " + existing + " (remove it or use another out_prefix)");
+    }
+    int fd = open(pgn_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open PGN file: " + pgn_path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot read PGN file: " + pgn_path);
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    IngestStats total;
+    total.bytes = static_cast<long long>(size);
+    if (size == 0) {
+        close(fd);
+        return total;
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("cannot map PGN file: " + pgn_path);
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    const char* data = static_cast<const char*>(mapped);
+
+    // One range of whole games per thread; small files get fewer threads
+    int threads = config.num_threads > 0 ? config.num_threads : static_cast<int>(std::thread::hardware_concurrency());
+    threads = static_cast<int>(std::max<size_t>(1, std::min<size_t>(std::max(threads, 1), size / 4096 + 1)));
+    std::vector<size_t> bounds(threads + 1, size);
+    bounds[0] = 0;
+    for (int t = 1; t < threads; ++t) {
+        bounds[t] = std::max(bounds[t - 1], next_game_start(data, size, size * t / threads));
+    }
+
+    std::mutex result_mutex;
+    std::exception_ptr error;
+    std::atomic<uint32_t> next_game{0};
+    auto worker = [&](int t) {
+        try {
+            if (bounds[t] == bounds[t + 1]) {
+                return;
+            }
+            char suffix[16];
+            std::snprintf(suffix, sizeof(suffix), "-%03d.shard", t);
+            GameIngester ingester(out_prefix + suffix, config, next_game);
+            parse_games(data, bounds[t], bounds[t + 1], ingester);
+            IngestStats local = ingester.finish();
+            std::lock_guard<std::mutex> lock(result_mutex);
+            total.games += local.games;
+            total.positions += local.positions;
+            total.skipped += local.skipped;
+            total.truncated += local.truncated;
+            total.shards++;
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(result_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    munmap(mapped, size);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total;
+}
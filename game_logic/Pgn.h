@@ -0,0 +1,54 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include "ChessBoard.h"
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Resolves a move in standard algebraic notation (e.g. "Nbd7", "exd5", "O-O-O", "e8=Q+")
+ * against the legal moves of a board. Check and annotation suffixes are ignored.
+ * @throws std::invalid_argument if the text is not SAN, matches no legal move or several, or
+ * promotes to anything but a queen (the engine always promotes to a queen).
+ */
+Move parse_san(const ChessBoard& board, const std::string& san);
+
+/**
+ * @brief Settings for PGN ingestion.
+ */
+struct IngestConfig {
+    int num_threads = 0;            // Worker threads; 0 uses every hardware thread
+    uint32_t generation = 0;        // Stored in every record, e.g. to tell data sources apart
+    int min_plies = 1;              // Shorter games are skipped
+};
+
+/**
+ * @brief Counts of a PGN ingestion.
+ */
+struct IngestStats {
+    long long games = 0;            // Games written
+    long long positions = 0;        // Records written
+    long long skipped = 0;          // Games with an unknown result, a custom start position or variant, an illegal move, or too short
+    long long truncated = 0;        // Games written only up to an underpromotion
+    long long bytes = 0;            // Size of the PGN file
+    double seconds = 0.0;
+    int shards = 0;                 // Files written (one per thread)
+};
+
+/**
+ * @brief Converts the games of a PGN file into training shards.
+ *
+ * The file is memory-mapped and cut into one range of whole games per thread. Each thread replays
+ * its games on a ChessBoard, resolving every SAN move with parse_san(), and appends one record per
+ * position to its own shard `<out_prefix>-<thread>.shard`, the thread number zero-padded to three
+ * digits (`games-000.shard`, `games-001.shard`, ...): the position, the move played as a one-hot
+ * visit count and the game result from the side to move's perspective. Written games are numbered
+ * 0, 1, ... across all shards (the records' game field) in the order the threads finish them, which
+ * is file order with one thread. Comments, NAGs and variations are skipped. Games must start from
+ * the standard position.
+ * @throws std::runtime_error if the PGN file cannot be read, a shard cannot be written, or shards
+ * with this prefix already exist (from an earlier run, whose games would otherwise be appended again).
+ */
+IngestStats ingest_pgn(const std::string& pgn_path, const std::string& out_prefix, const IngestConfig& config = IngestConfig());
+
+#endif // PGN_H
@@ -0,0 +1,152 @@
+#include "Playout.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static int piece_value(char type) {
+    switch (type) {
+        case 'p': return 1;
+        case 'n': return 3;
+        case 'b': return 3;
+        case 'r': return 5;
+        case 'q': return 9;
+        default: return 0;
+    }
+}
+
+// Picks a capture of the most valuable piece on offer (ties at random), or returns -1 if there is no capture
+static int best_capture(const ChessBoard& board, const std::vector<Move>& moves, Xoshiro256& rng) {
+    int best = -1;
+    int best_value = 0;
+    uint32_t ties = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        const Piece* victim = board._board[moves[i].to.x][moves[i].to.y];
+        if (victim == nullptr) {
+            continue;
+        }
+        int value = piece_value(victim->get_type());
+        if (value > best_value) {
+            best = static_cast<int>(i);
+            best_value = value;
+            ties = 1;
+        } else if (value == best_value && rng.bounded(++ties) == 0) {
+            best = static_cast<int>(i); // Reservoir sampling among equal captures
+        }
+    }
+    return best;
+}
+
+int play_out(ChessBoard& board, Xoshiro256& rng, int max_plies, float capture_bias) {
+    int plies = 0;
+    while (!board.is_game_over() && plies < max_plies) {
+        const std::vector<Move>& moves = board.legal_moves();
+        int chosen = -1;
+        if (capture_bias > 0.0f && rng.uniform() < capture_bias) {
+            chosen = best_capture(board, moves, rng);
+        }
+        if (chosen < 0) {
+            chosen = static_cast<int>(rng.bounded(static_cast<uint32_t>(moves.size())));
+        }
+        board.play_unchecked(moves[chosen]);
+        board.refresh();
+        plies++;
+    }
+    return plies;
+}
+
+PlayoutResult playout(const ChessBoard& board, int games, const PlayoutConfig& config) {
+    auto start = std::chrono::steady_clock::now();
+    int threads = config.num_threads > 0 ? config.num_threads : static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, games));
+
+    std::atomic<int> next_game(0);
+    std::mutex result_mutex;
+    std::exception_ptr error;
+    PlayoutResult result;
+
+    auto worker = [&]() {
+        try {
+            PlayoutResult local;
+            ChessBoard game(board);
+            while (true) {
+                int index = next_game.fetch_add(1, std::memory_order_relaxed);
+                if (index >= games) {
+                    break;
+                }
+                game = board;
+                Xoshiro256 rng(config.seed + static_cast<uint64_t>(index));
+                int plies = play_out(game, rng, config.max_plies, config.capture_bias);
+                int outcome = game.is_game_over() ? game.get_outcome() : 0;
+                local.games++;
+                local.plies += plies;
+                if (!game.is_game_over()) {
+                    local.unfinished++;
+                }
+                if (outcome == 1) {
+                    local.white_wins++;
+                } else if (outcome == -1) {
+                    local.black_wins++;
+                } else {
+                    local.draws++;
+                }
+                if (outcome != 0) {
+                    local.decisive_plies += plies;
+                }
+            }
+            std::lock_guard<std::mutex> lock(result_mutex);
+            result.games += local.games;
+            result.white_wins += local.white_wins;
+            result.draws += local.draws;
+            result.black_wins += local.black_wins;
+            result.unfinished += local.unfinished;
+            result.plies += local.plies;
+            result.decisive_plies += local.decisive_plies;
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(result_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            next_game.store(games);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+Evaluator playout_evaluator(int playouts_per_leaf, int max_plies, float capture_bias) {
+    playouts_per_leaf = std::max(playouts_per_leaf, 1);
+    return [playouts_per_leaf, max_plies, capture_bias](const std::vector<const ChessBoard*>& boards, std::vector<Evaluation>& results) {
+        Xoshiro256& rng = thread_rng();
+        for (size_t i = 0; i < boards.size(); ++i) {
+            ChessBoard game(*boards[i]);
+            int total = 0;
+            for (int p = 0; p < playouts_per_leaf; ++p) {
+                if (p > 0) {
+                    game = *boards[i];
+                }
+                play_out(game, rng, max_plies, capture_bias);
+                total += game.is_game_over() ? game.get_outcome() : 0;
+            }
+            float white = static_cast<float>(total) / playouts_per_leaf;
+            results[i].value = boards[i]->get_turn() == Color::WHITE ? white : -white;
+            size_t moves = boards[i]->legal_moves().size();
+            results[i].priors.assign(moves, moves > 0 ? 1.0f / moves : 0.0f);
+        }
+    };
+}
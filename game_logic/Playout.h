@@ -0,0 +1,80 @@
+#ifndef PLAYOUT_H
+#define PLAYOUT_H
+
+#include "ChessBoard.h"
+#include "MCTS.h"
+#include "Random.h"
+#include <cstdint>
+
+/**
+ * @brief How playouts pick their moves.
+ */
+struct PlayoutConfig {
+    int max_plies = 512;            // Games still running after this many plies are scored as draws
+    uint64_t seed = 0;              // Game g draws its moves from a generator seeded with seed + g
+    int num_threads = 0;            // Worker threads; 0 uses every hardware thread
+    float capture_bias = 0.0f;      // Chance of playing a capture (of the most valuable piece) when one is available
+};
+
+/**
+ * @brief Outcomes of a set of playouts.
+ */
+struct PlayoutResult {
+    long long games = 0;
+    long long white_wins = 0;
+    long long draws = 0;            // Includes the unfinished games
+    long long black_wins = 0;
+    long long unfinished = 0;       // Games cut off at max_plies
+    long long plies = 0;            // Total over all games
+    long long decisive_plies = 0;   // Total over the won and lost games
+    double seconds = 0.0;
+
+    double mean_plies() const { return games > 0 ? static_cast<double>(plies) / games : 0.0; }
+    double mean_decisive_plies() const {
+        long long decisive = white_wins + black_wins;
+        return decisive > 0 ? static_cast<double>(decisive_plies) / decisive : 0.0;
+    }
+    /**
+     * @brief Mean outcome (1 win, 0 draw, -1 loss) for the given side.
+     */
+    double score(Color side) const {
+        if (games == 0) {
+            return 0.0;
+        }
+        double white = static_cast<double>(white_wins - black_wins) / games;
+        return side == Color::WHITE ? white : -white;
+    }
+};
+
+/**
+ * @brief Plays one game from the current position of board to the end (or max_plies) in place.
+ * @param board The position to play from; it is left at the final position.
+ * @param rng Generator the moves are drawn from.
+ * @param max_plies Longest game to play.
+ * @param capture_bias See PlayoutConfig.
+ * @return The number of plies played. The result is board.get_outcome() if board.is_game_over(),
+ * otherwise a draw.
+ */
+int play_out(ChessBoard& board, Xoshiro256& rng, int max_plies, float capture_bias = 0.0f);
+
+/**
+ * @brief Plays a number of random (or lightly guided) games from a position.
+ *
+ * The games are shared out between worker threads; each thread plays all of its games on one board,
+ * copying the starting position into it before each game. Moves are played in place, so no board is
+ * created per ply, but the copy re-allocates the pieces once per game. Game g uses the same random
+ * stream, so the result only depends on the seed, not on the thread count.
+ * @param board The starting position (not modified).
+ * @param games Number of games to play.
+ * @param config Move choice, length limit, seed and threads.
+ */
+PlayoutResult playout(const ChessBoard& board, int games, const PlayoutConfig& config = PlayoutConfig());
+
+/**
+ * @brief Returns an evaluator for model-free search: the value of a position is the mean outcome
+ * of playouts_per_leaf playouts from it (side to move perspective) and the priors are uniform.
+ * Playouts run in the calling search thread, drawing from its thread_rng().
+ */
+Evaluator playout_evaluator(int playouts_per_leaf, int max_plies = 200, float capture_bias = 0.5f);
+
+#endif // PLAYOUT_H
@@ -0,0 +1,47 @@
+#include "Policy.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void softmax(float* logits, size_t n) {
+    if (n == 0) {
+        return;
+    }
+
+    float max_logit = -std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < n; ++i) {
+        max_logit = std::max(max_logit, logits[i]);
+    }
+
+    float total = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        logits[i] = std::exp(logits[i] - max_logit);
+        total += logits[i];
+    }
+
+    if (!std::isfinite(total) || total <= 0.0f) {
+        // Logits were NaN/inf; assign uniform probability like the Python fallback does
+        std::fill(logits, logits + n, 1.0f / n);
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        logits[i] /= total;
+    }
+}
+
+void masked_softmax(const float* logits, const std::vector<Move>& moves, float* priors) {
+    for (size_t i = 0; i < moves.size(); ++i) {
+        priors[i] = logits[move_to_policy_index(moves[i])];
+    }
+    softmax(priors, moves.size());
+}
+
+std::vector<std::vector<float>> masked_softmax_batch(const float* logits, const std::vector<const ChessBoard*>& boards) {
+    std::vector<std::vector<float>> priors(boards.size());
+    for (size_t b = 0; b < boards.size(); ++b) {
+        const std::vector<Move>& moves = boards[b]->legal_moves();
+        priors[b].resize(moves.size());
+        masked_softmax(logits + b * POLICY_SIZE, moves, priors[b].data());
+    }
+    return priors;
+}
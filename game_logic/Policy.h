@@ -0,0 +1,57 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include "ChessBoard.h"
+#include "types.h"
+#include <vector>
+
+/**
+ * Helpers for the network's inputs and policy head. The input is the 9x8x8 tensor from
+ * ChessBoard::get_state_tensor(). The head has one logit per (from_row, from_col, to_row,
+ * to_col) combination, flattened in that order, which is the same layout as
+ * ChessBoard::get_policy_mask().
+ */
+
+constexpr int STATE_TENSOR_SIZE = 9 * 8 * 8;
+constexpr int POLICY_SIZE = 8 * 8 * 8 * 8;
+
+/**
+ * @brief Maps a move to its flat index in the policy head.
+ */
+inline int move_to_policy_index(const Move& move) {
+    return (move.from.x * 8 * 8 * 8) + (move.from.y * 8 * 8) + (move.to.x * 8) + move.to.y;
+}
+
+/**
+ * @brief Maps a flat policy index back to the move it represents.
+ */
+inline Move policy_index_to_move(int index) {
+    return Move(index >> 9, (index >> 6) & 7, (index >> 3) & 7, index & 7);
+}
+
+/**
+ * @brief In-place softmax of n logits.
+ * Falls back to a uniform distribution if the logits are not finite.
+ */
+void softmax(float* logits, size_t n);
+
+/**
+ * @brief Softmax of the policy logits restricted to the given moves.
+ * This equals a softmax over all POLICY_SIZE logits followed by masking and renormalizing,
+ * but only touches the legal entries and cannot underflow to an all-zero distribution.
+ * Falls back to a uniform distribution if the logits are not finite.
+ * @param logits Row of POLICY_SIZE logits.
+ * @param moves The moves to score (usually the board's legal moves).
+ * @param priors Output array of moves.size() probabilities, aligned with moves.
+ */
+void masked_softmax(const float* logits, const std::vector<Move>& moves, float* priors);
+
+/**
+ * @brief Batched masked_softmax: row b of the logits is scored against the legal moves of boards[b].
+ * @param logits boards.size() rows of POLICY_SIZE logits, stored contiguously.
+ * @param boards The positions the logits were computed for.
+ * @return One vector of priors per board, aligned with that board's legal_moves().
+ */
+std::vector<std::vector<float>> masked_softmax_batch(const float* logits, const std::vector<const ChessBoard*>& boards);
+
+#endif // POLICY_H
@@ -0,0 +1,91 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief Small, fast xoshiro256** pseudo-random generator.
+ * Each instance owns its whole state, so generators used by different threads never interfere
+ * and a given seed always reproduces the same sequence. Satisfies UniformRandomBitGenerator,
+ * so it can be handed to <random> distributions and std::shuffle.
+ */
+class Xoshiro256 {
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed = 0) { this->seed(seed); }
+
+    /**
+     * @brief Re-seeds the generator. The 64-bit seed is expanded with splitmix64 so that
+     * nearby seeds (0, 1, 2, ...) still give unrelated streams.
+     */
+    void seed(uint64_t seed) {
+        for (int i = 0; i < 4; ++i) {
+            seed += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            s[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    /**
+     * @brief Returns a uniformly distributed integer in [0, n). n must be non-zero.
+     */
+    uint32_t bounded(uint32_t n) {
+        return static_cast<uint32_t>(((next() >> 32) * static_cast<uint64_t>(n)) >> 32);
+    }
+
+    /**
+     * @brief Returns a uniformly distributed double in [0, 1).
+     */
+    double uniform() {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+    result_type operator()() { return next(); }
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+/**
+ * @brief Returns the calling thread's generator.
+ * Threads are seeded in the order they first ask for a generator (thread n gets seed n), so a
+ * driver that starts its workers in a fixed order gets reproducible results without seeding
+ * each one explicitly. Use seed_thread_rng() to pin a thread to a specific stream.
+ */
+inline Xoshiro256& thread_rng() {
+    static std::atomic<uint64_t> next_thread_seed{0};
+    thread_local Xoshiro256 rng(next_thread_seed.fetch_add(1, std::memory_order_relaxed));
+    return rng;
+}
+
+/**
+ * @brief Re-seeds the calling thread's generator.
+ */
+inline void seed_thread_rng(uint64_t seed) {
+    thread_rng().seed(seed);
+}
+
+#endif // RANDOM_H
@@ -0,0 +1,439 @@
+#include "Replay.h"
+#include "Policy.h"
+#include "SelfPlay.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PackedPosition pack_position(const ChessBoard& board) {
+    float state[STATE_TENSOR_SIZE];
+    board.copy_state_tensor(state);
+    bool white = board.get_turn() == Color::WHITE;
+
+    PackedPosition packed{};
+    packed.en_passant = NO_SQUARE;
+    for (int square = 0; square < 64; ++square) {
+        for (int type = 0; type < 6; ++type) {
+            float value = state[type * 64 + square];
+            if (value != 0.0f) {
+                bool white_piece = (value > 0.0f) == white;
+                uint8_t code = static_cast<uint8_t>(type + 1 + (white_piece ? 0 : 8));
+                packed.squares[square / 2] |= square % 2 == 0 ? code : static_cast<uint8_t>(code << 4);
+                break;
+            }
+        }
+        if (state[8 * 64 + square] != 0.0f) {
+            packed.en_passant = static_cast<uint8_t>(square);
+        }
+    }
+    if (!white) {
+        packed.flags |= PackedPosition::BLACK_TO_MOVE;
+    }
+    if (state[6 * 64] != 0.0f) {
+        packed.flags |= PackedPosition::KING_SIDE_CASTLE;
+    }
+    if (state[7 * 64] != 0.0f) {
+        packed.flags |= PackedPosition::QUEEN_SIDE_CASTLE;
+    }
+    return packed;
+}
+
+void unpack_state(const PackedPosition& position, float* out) {
+    std::fill(out, out + STATE_TENSOR_SIZE, 0.0f);
+    bool black_to_move = position.flags & PackedPosition::BLACK_TO_MOVE;
+    for (int square = 0; square < 64; ++square) {
+        uint8_t code = square % 2 == 0 ? position.squares[square / 2] & 0x0F : position.squares[square / 2] >> 4;
+        int type = code & 7;
+        if (type == 0 || type > 6) {
+            continue;
+        }
+        bool black_piece = code & 8;
+        out[(type - 1) * 64 + square] = black_piece == black_to_move ? 1.0f : -1.0f;
+    }
+    if (position.flags & PackedPosition::KING_SIDE_CASTLE) {
+        std::fill(out + 6 * 64, out + 7 * 64, 1.0f);
+    }
+    if (position.flags & PackedPosition::QUEEN_SIDE_CASTLE) {
+        std::fill(out + 7 * 64, out + 8 * 64, 1.0f);
+    }
+    if (position.en_passant < 64) {
+        out[8 * 64 + position.en_passant] = 1.0f;
+    }
+}
+
+void decode_record(const RecordView& record, float* state, float* policy, float* value) {
+    unpack_state(record.header->position, state);
+    std::fill(policy, policy + POLICY_SIZE, 0.0f);
+    long long total = 0;
+    for (uint16_t i = 0; i < record.header->num_visits; ++i) {
+        total += record.visits[i].visits;
+    }
+    if (total > 0) {
+        float scale = 1.0f / static_cast<float>(total);
+        for (uint16_t i = 0; i < record.header->num_visits; ++i) {
+            policy[record.visits[i].move] = record.visits[i].visits * scale;
+        }
+    }
+    *value = static_cast<float>(record.header->result);
+}
+
+std::vector<VisitCount> pack_visits(const std::vector<std::pair<Move, int>>& counts) {
+    int most = 0;
+    for (const auto& entry : counts) {
+        most = std::max(most, entry.second);
+    }
+    double scale = most > 0xFFFF ? static_cast<double>(0xFFFF) / most : 1.0;
+
+    std::vector<VisitCount> visits;
+    visits.reserve(counts.size());
+    for (const auto& entry : counts) {
+        int scaled = static_cast<int>(entry.second * scale + 0.5);
+        if (entry.second > 0) {
+            scaled = std::max(scaled, 1); // Keep every visited move in the target
+        }
+        visits.push_back({static_cast<uint16_t>(move_to_policy_index(entry.first)), static_cast<uint16_t>(scaled)});
+    }
+    return visits;
+}
+
+// Size of the record starting at data[offset], or 0 if the file ends before it does
+static size_t record_bytes(const uint8_t* data, size_t offset, size_t size) {
+    if (offset + sizeof(RecordHeader) > size) {
+        return 0;
+    }
+    RecordHeader header;
+    std::memcpy(&header, data + offset, sizeof(header));
+    if (header.num_visits > POLICY_SIZE) {
+        throw std::runtime_error("corrupt shard record");
+    }
+    size_t bytes = sizeof(RecordHeader) + header.num_visits * sizeof(VisitCount);
+    if (offset + bytes > size) {
+        return 0;
+    }
+    // decode_record() indexes the policy by these, so a bad one must not get past indexing
+    for (uint16_t i = 0; i < header.num_visits; ++i) {
+        VisitCount visit;
+        std::memcpy(&visit, data + offset + sizeof(RecordHeader) + i * sizeof(VisitCount), sizeof(visit));
+        if (visit.move >= POLICY_SIZE) {
+            throw std::runtime_error("corrupt shard record");
+        }
+    }
+    return bytes;
+}
+
+void encode_record(std::vector<uint8_t>& out, const PackedPosition& position, const std::vector<VisitCount>& visits,
+                   int result, uint32_t game, int ply, int game_plies, uint32_t generation) {
+    if (visits.size() > POLICY_SIZE) {
+        throw std::invalid_argument("a record holds at most 4096 visit counts");
+    }
+    RecordHeader header{};
+    header.position = position;
+    header.result = static_cast<int8_t>(std::clamp(result, -1, 1));
+    header.num_visits = static_cast<uint16_t>(visits.size());
+    header.game = game;
+    header.ply = static_cast<uint16_t>(std::clamp(ply, 0, 0xFFFF));
+    header.game_plies = static_cast<uint16_t>(std::clamp(game_plies, 0, 0xFFFF));
+    header.generation = generation;
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+    out.insert(out.end(), bytes, bytes + sizeof(header));
+    bytes = reinterpret_cast<const uint8_t*>(visits.data());
+    out.insert(out.end(), bytes, bytes + visits.size() * sizeof(VisitCount));
+}
+
+void encode_game(std::vector<uint8_t>& out, const GameRecord& game, uint32_t generation) {
+    for (int i = 0; i < game.plies; ++i) {
+        encode_record(out, game.positions[i], game.visits[i], static_cast<int>(game.values[i]), static_cast<uint32_t>(game.index),
+                      i, game.plies, generation);
+    }
+}
+
+size_t count_records(const uint8_t* data, size_t size) {
+    size_t records = 0;
+    size_t offset = 0;
+    while (offset < size) {
+        size_t bytes = record_bytes(data, offset, size);
+        if (bytes == 0) {
+            throw std::invalid_argument("data does not end on a record boundary");
+        }
+        offset += bytes;
+        records++;
+    }
+    return records;
+}
+
+static void check_header(const uint8_t* data, const std::string& path) {
+    uint32_t header[2];
+    std::memcpy(header, data, sizeof(header));
+    if (header[0] != SHARD_MAGIC) {
+        throw std::runtime_error("not a shard file: " + path);
+    }
+    if (header[1] != SHARD_VERSION) {
+        throw std::runtime_error("unsupported shard version " + std::to_string(header[1]) + ": " + path);
+    }
+}
+
+Shard::Shard(const std::string& path) : file_path(path) {
+    refresh();
+}
+
+size_t Shard::refresh() {
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open shard: " + file_path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(SHARD_HEADER_BYTES)) {
+        close(fd);
+        throw std::runtime_error("not a shard file: " + file_path);
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size > mapped_bytes) {
+        void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("cannot map shard: " + file_path);
+        }
+        mapping.reset(static_cast<const uint8_t*>(data), [size](const uint8_t* p) {
+            munmap(const_cast<uint8_t*>(p), size);
+        });
+        mapped_bytes = size;
+    } else {
+        close(fd);
+    }
+    if (offsets.empty() && indexed_bytes == SHARD_HEADER_BYTES) {
+        check_header(mapping.get(), file_path);
+    }
+
+    size_t before = offsets.size();
+    const uint8_t* data = mapping.get();
+    while (size_t bytes = record_bytes(data, indexed_bytes, mapped_bytes)) {
+        offsets.push_back(indexed_bytes);
+        indexed_bytes += bytes;
+    }
+    return offsets.size() - before;
+}
+
+size_t Shard::size() const {
+    return offsets.size();
+}
+
+size_t Shard::bytes() const {
+    return indexed_bytes;
+}
+
+RecordView Shard::record(size_t index) const {
+    const uint8_t* data = mapping.get() + offsets[index];
+    RecordView view;
+    view.header = reinterpret_cast<const RecordHeader*>(data);
+    view.visits = reinterpret_cast<const VisitCount*>(data + sizeof(RecordHeader));
+    return view;
+}
+
+const std::string& Shard::path() const {
+    return file_path;
+}
+
+ShardWriter::ShardWriter(const std::string& path) : file_path(path) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open shard for writing: " + path + " (" + std::strerror(errno) + ")");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot open shard for writing: " + path);
+    }
+    if (info.st_size == 0) {
+        uint8_t header[SHARD_HEADER_BYTES] = {};
+        std::memcpy(header, &SHARD_MAGIC, sizeof(uint32_t));
+        std::memcpy(header + sizeof(uint32_t), &SHARD_VERSION, sizeof(uint32_t));
+        buffer.assign(header, header + SHARD_HEADER_BYTES);
+        flush_locked();
+        return;
+    }
+
+    try {
+        // Index the existing records and cut off a record torn by a crashed writer
+        Shard existing(path);
+        record_count = static_cast<long long>(existing.size());
+        if (existing.bytes() < static_cast<size_t>(info.st_size) && ftruncate(fd, static_cast<off_t>(existing.bytes())) != 0) {
+            throw std::runtime_error("cannot truncate torn record of shard: " + path);
+        }
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+ShardWriter::~ShardWriter() {
+    try {
+        flush();
+    } catch (...) {
+        // Nothing sensible to do with a failed write while destroying
+    }
+    close(fd);
+}
+
+void ShardWriter::append(const PackedPosition& position, const std::vector<VisitCount>& visits, int result,
+                         uint32_t game, int ply, int game_plies, uint32_t generation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    encode_record(buffer, position, visits, result, game, ply, game_plies, generation);
+    record_count++;
+    if (buffer.size() >= (1 << 20)) {
+        flush_locked();
+    }
+}
+
+size_t ShardWriter::append_records(const uint8_t* data, size_t size) {
+    size_t records = count_records(data, size);
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer.insert(buffer.end(), data, data + size);
+    record_count += static_cast<long long>(records);
+    if (buffer.size() >= (1 << 20)) {
+        flush_locked();
+    }
+    return records;
+}
+
+void ShardWriter::write_game(const GameRecord& game, uint32_t generation) {
+    std::vector<uint8_t> encoded;
+    encode_game(encoded, game, generation);
+    append_records(encoded.data(), encoded.size());
+    flush();
+}
+
+void ShardWriter::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    flush_locked();
+}
+
+void ShardWriter::flush_locked() {
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t n = write(fd, buffer.data() + written, buffer.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("cannot write shard: " + file_path + " (" + std::strerror(errno) + ")");
+        }
+        written += static_cast<size_t>(n);
+    }
+    buffer.clear();
+}
+
+long long ShardWriter::records() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return record_count;
+}
+
+const std::string& ShardWriter::path() const {
+    return file_path;
+}
+
+ReplayBuffer::ReplayBuffer(const std::string& directory, size_t window) : directory(directory), window_size(window) {
+    if (window == 0) {
+        throw std::invalid_argument("window must be at least 1");
+    }
+    refresh();
+}
+
+size_t ReplayBuffer::refresh() {
+    for (auto& shard : shards) {
+        shard->refresh();
+    }
+
+    // Shards named after the newest one seen so far are new; earlier names were dropped or are ignored
+    std::vector<std::string> paths;
+    std::error_code failure;
+    std::filesystem::directory_iterator listing(directory, failure);
+    if (failure) {
+        throw std::runtime_error("cannot list shard directory: " + directory + " (" + failure.message() + ")");
+    }
+    for (const auto& entry : listing) {
+        if (entry.is_regular_file() && entry.path().extension() == ".shard") {
+            std::string path = entry.path().string();
+            if (path > newest) {
+                paths.push_back(std::move(path));
+            }
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const std::string& path : paths) {
+        // A shard whose writer has not written the header yet is picked up by a later refresh, and the
+        // shards named after it wait for it so that they stay in name order
+        std::error_code missing;
+        std::uintmax_t bytes = std::filesystem::file_size(path, missing);
+        if (missing || bytes < SHARD_HEADER_BYTES) {
+            break;
+        }
+        shards.push_back(std::make_unique<Shard>(path));
+        newest = path;
+    }
+
+    ends.resize(shards.size());
+    size_t total = 0;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        total += shards[i]->size();
+        ends[i] = total;
+    }
+    first = total > window_size ? total - window_size : 0;
+
+    // Unmap shards that slid out of the window
+    size_t dropped = 0;
+    while (dropped + 1 < shards.size() && ends[dropped] <= first) {
+        dropped++;
+    }
+    if (dropped > 0) {
+        size_t offset = ends[dropped - 1];
+        shards.erase(shards.begin(), shards.begin() + dropped);
+        ends.erase(ends.begin(), ends.begin() + dropped);
+        for (size_t& end : ends) {
+            end -= offset;
+        }
+        first -= offset;
+    }
+    return size();
+}
+
+size_t ReplayBuffer::size() const {
+    return ends.empty() ? 0 : ends.back() - first;
+}
+
+RecordView ReplayBuffer::record(size_t index) const {
+    if (index >= size()) {
+        throw std::out_of_range("replay buffer index out of range");
+    }
+    size_t global = first + index;
+    size_t shard = static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), global) - ends.begin());
+    return shards[shard]->record(global - (shard == 0 ? 0 : ends[shard - 1]));
+}
+
+std::vector<size_t> ReplayBuffer::sample(size_t count, Xoshiro256& rng) const {
+    size_t n = size();
+    if (n == 0) {
+        throw std::logic_error("cannot sample from an empty replay buffer");
+    }
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    std::vector<size_t> indices(count);
+    for (size_t& index : indices) {
+        index = pick(rng);
+    }
+    return indices;
+}
+
+size_t ReplayBuffer::window() const {
+    return window_size;
+}
+
+size_t ReplayBuffer::num_shards() const {
+    return shards.size();
+}
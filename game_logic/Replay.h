@@ -0,0 +1,267 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "ChessBoard.h"
+#include "Random.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Binary storage for training positions.
+ *
+ * A shard is an append-only file: a 64-byte header (uint32 SHARD_MAGIC, uint32 SHARD_VERSION, zero
+ * padding) followed by records, each a RecordHeader and then its num_visits VisitCount entries. All
+ * fields are little-endian and every record is a multiple of 4 bytes, so records can be read in place
+ * from a memory map. Readers index a shard by walking the record sizes once; a record cut short by a
+ * crashed writer is ignored by readers and cut off by the next ShardWriter that opens the file.
+ */
+
+constexpr uint32_t SHARD_MAGIC = 0x4C505243;    // "CRPL"
+constexpr uint32_t SHARD_VERSION = 1;
+constexpr size_t SHARD_HEADER_BYTES = 64;
+constexpr uint8_t NO_SQUARE = 0xFF;
+
+/**
+ * @brief A position in 36 bytes, holding everything ChessBoard::copy_state_tensor() encodes.
+ */
+struct PackedPosition {
+    enum Flags : uint8_t {
+        BLACK_TO_MOVE = 1,
+        KING_SIDE_CASTLE = 2,       // The side to move can castle king side in this position
+        QUEEN_SIDE_CASTLE = 4,
+    };
+
+    uint8_t squares[32];            // Square s = rank * 8 + file in the low (even s) or high (odd s) nibble:
+                                    // 0 empty, 1-6 white p n b r q k, 9-14 the black ones
+    uint8_t flags;
+    uint8_t en_passant;             // Target square of a legal en passant capture, or NO_SQUARE
+    uint16_t reserved;
+};
+static_assert(sizeof(PackedPosition) == 36, "PackedPosition is part of the shard format");
+
+/**
+ * @brief Root visit count of one move (saturates at 65535).
+ */
+struct VisitCount {
+    uint16_t move;                  // Policy index (move_to_policy_index())
+    uint16_t visits;
+};
+static_assert(sizeof(VisitCount) == 4, "VisitCount is part of the shard format");
+
+/**
+ * @brief Fixed part of a shard record.
+ */
+struct RecordHeader {
+    PackedPosition position;
+    int8_t result;                  // Game result from the side to move's perspective: 1, 0 or -1
+    uint8_t reserved;
+    uint16_t num_visits;            // VisitCount entries following this header
+    uint32_t game;                  // Game number given by the writer
+    uint16_t ply;                   // Ply of this position within its game
+    uint16_t game_plies;            // Length of the game
+    uint32_t generation;            // Network generation that played the game (caller-defined)
+};
+static_assert(sizeof(RecordHeader) == 52, "RecordHeader is part of the shard format");
+
+/**
+ * @brief A record read in place from a mapped shard.
+ */
+struct RecordView {
+    const RecordHeader* header = nullptr;
+    const VisitCount* visits = nullptr;
+};
+
+/**
+ * @brief Packs the current position of a board (its legal moves must be up to date).
+ */
+PackedPosition pack_position(const ChessBoard& board);
+
+/**
+ * @brief Writes the network input of a packed position, identical to ChessBoard::copy_state_tensor().
+ * @param out Buffer of STATE_TENSOR_SIZE floats.
+ */
+void unpack_state(const PackedPosition& position, float* out);
+
+/**
+ * @brief Decodes a record into training targets.
+ * @param state STATE_TENSOR_SIZE floats (see unpack_state()).
+ * @param policy POLICY_SIZE floats: the visit distribution, zero for moves that were not visited.
+ * @param value The game result from the side to move's perspective.
+ */
+void decode_record(const RecordView& record, float* state, float* policy, float* value);
+
+/**
+ * @brief Converts root visit counts to records, scaling them down proportionally if one exceeds 65535.
+ */
+std::vector<VisitCount> pack_visits(const std::vector<std::pair<Move, int>>& counts);
+
+struct GameRecord;
+
+/**
+ * @brief Appends a record in the shard format to a byte buffer.
+ */
+void encode_record(std::vector<uint8_t>& out, const PackedPosition& position, const std::vector<VisitCount>& visits,
+                   int result, uint32_t game, int ply, int game_plies, uint32_t generation);
+
+/**
+ * @brief Appends a record for every position of a finished self-play game.
+ */
+void encode_game(std::vector<uint8_t>& out, const GameRecord& game, uint32_t generation = 0);
+
+/**
+ * @brief Counts the records in a buffer of encoded records.
+ * @throws std::invalid_argument if the buffer does not end on a record boundary.
+ * @throws std::runtime_error if a record is corrupt (too many visit counts, or a move that is not a
+ * policy index).
+ */
+size_t count_records(const uint8_t* data, size_t size);
+
+/**
+ * @brief Appends records to a shard, creating it if needed. Thread-safe.
+ *
+ * Records are buffered and written with one write() per flush(), so readers only ever see whole
+ * records, apart from a torn record left behind by a crash.
+ */
+class ShardWriter {
+public:
+    /**
+     * @throws std::runtime_error if the file cannot be opened or is not a shard.
+     */
+    explicit ShardWriter(const std::string& path);
+    ~ShardWriter();
+
+    ShardWriter(const ShardWriter&) = delete;
+    ShardWriter& operator=(const ShardWriter&) = delete;
+
+    void append(const PackedPosition& position, const std::vector<VisitCount>& visits, int result,
+                uint32_t game, int ply, int game_plies, uint32_t generation);
+
+    /**
+     * @brief Appends records encoded with encode_record() (e.g. received from another process).
+     * @return Number of records appended.
+     * @throws std::invalid_argument if the data is not a sequence of whole records.
+     * @throws std::runtime_error if a record is corrupt (see count_records()).
+     */
+    size_t append_records(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Appends every position of a finished self-play game and flushes.
+     */
+    void write_game(const GameRecord& game, uint32_t generation = 0);
+
+    void flush();
+
+    /**
+     * @brief Records in the shard, including those written before it was opened.
+     */
+    long long records() const;
+
+    const std::string& path() const;
+
+private:
+    std::string file_path;
+    int fd = -1;
+    std::vector<uint8_t> buffer;
+    long long record_count = 0;
+    mutable std::mutex mutex;
+
+    void flush_locked();
+};
+
+/**
+ * @brief Read-only view of a shard through a memory map.
+ */
+class Shard {
+public:
+    /**
+     * @throws std::runtime_error if the file cannot be mapped or is not a shard.
+     */
+    explicit Shard(const std::string& path);
+
+    Shard(const Shard&) = delete;
+    Shard& operator=(const Shard&) = delete;
+
+    size_t size() const;
+    RecordView record(size_t index) const;
+
+    /**
+     * @brief Bytes taken by the header and the complete records.
+     */
+    size_t bytes() const;
+
+    /**
+     * @brief Maps and indexes records appended since the last call. Invalidates earlier RecordViews
+     * if the file grew, so it must not run while other threads read the shard.
+     * @return Number of new records.
+     */
+    size_t refresh();
+
+    const std::string& path() const;
+
+private:
+    std::string file_path;
+    std::shared_ptr<const uint8_t> mapping;
+    size_t mapped_bytes = 0;
+    size_t indexed_bytes = SHARD_HEADER_BYTES;
+    std::vector<uint64_t> offsets;  // Byte offset of each complete record
+};
+
+/**
+ * @brief Uniform sampling over the most recent positions of a directory of shards.
+ *
+ * Shards are the *.shard files of the directory, ordered by name (so name them with increasing
+ * sequence numbers or timestamps), and records within a shard in file order. The window holds the
+ * last `window` records of that sequence; shards that fall entirely out of it are unmapped. Only
+ * shards named after the newest one already opened are picked up by refresh(). A shard file still
+ * shorter than its header (just created by a writer) is left for a later refresh(), together with
+ * the shards named after it.
+ */
+class ReplayBuffer {
+public:
+    /**
+     * @param directory Where the shards are written.
+     * @param window Number of most recent positions to sample from.
+     */
+    ReplayBuffer(const std::string& directory, size_t window);
+
+    /**
+     * @brief Picks up new shards and records and slides the window. Must not run while other threads
+     * read the buffer.
+     * @return size() afterwards.
+     * @throws std::runtime_error if a shard is not a shard file or holds a corrupt record.
+     */
+    size_t refresh();
+
+    /**
+     * @brief Positions in the window.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Record i of the window, 0 being the oldest.
+     */
+    RecordView record(size_t index) const;
+
+    /**
+     * @brief Draws count window indices uniformly at random (with replacement).
+     */
+    std::vector<size_t> sample(size_t count, Xoshiro256& rng) const;
+
+    size_t window() const;
+    size_t num_shards() const;
+
+private:
+    std::string directory;
+    size_t window_size;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<size_t> ends;       // Cumulative record counts: shard i holds [ends[i - 1], ends[i])
+    size_t first = 0;               // Index of the oldest record in the window
+    std::string newest;             // Path of the newest shard opened; only later names are picked up
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,218 @@
+#include "SelfPlay.h"
+#include "Random.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+static long long now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SelfPlay::SelfPlay(Evaluator evaluator, SelfPlayConfig config) : evaluator(std::move(evaluator)), config(config) {
+    // A search without simulations has no visits to pick a move from, so every game would end as a 0-ply draw
+    if (config.simulations < 1 || config.concurrent_games < 1 || config.batch_size < 1) {
+        throw std::invalid_argument("simulations, concurrent_games and batch_size must be at least 1");
+    }
+}
+
+// A game in progress: its position, its search tree and what has been recorded so far
+struct SelfPlay::Game {
+    GameRecord record;
+    Xoshiro256 rng;
+    ChessBoard board;
+    MCTS tree;
+    std::vector<int> sides;         // Side to move at each recorded position
+    size_t first = 0;               // Where the game's positions start in the worker's current batch
+
+    Game(int index, uint64_t seed, const Evaluator& evaluator, float c_puct)
+        : rng(seed + static_cast<uint64_t>(index)), tree(board, evaluator, c_puct) {
+        record.index = index;
+    }
+};
+
+SelfPlayStats SelfPlay::run(const std::function<void(GameRecord&)>& on_game) {
+    next_game.store(0);
+    games_done.store(0);
+    positions_done.store(0);
+    simulations_done.store(0);
+    simulations_saved.store(0);
+    for (auto& count : outcomes) {
+        count.store(0);
+    }
+    failed.store(false);
+    start_ns.store(now_ns());
+    end_ns.store(0);
+
+    std::exception_ptr error;
+    int concurrent = std::max(1, std::min(config.concurrent_games, config.games));
+    int threads = config.threads > 0 ? config.threads : static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, concurrent));
+    auto worker = [&](int slots) {
+        try {
+            work(slots, on_game);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(output_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed.store(true); // Stop the other workers
+        }
+    };
+
+    // Share out the concurrent games as evenly as possible
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(worker, concurrent / threads + (t < concurrent % threads));
+    }
+    worker(concurrent / threads + (0 < concurrent % threads));
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    end_ns.store(now_ns());
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return stats();
+}
+
+void SelfPlay::work(int slots, const std::function<void(GameRecord&)>& on_game) {
+    std::vector<std::unique_ptr<Game>> games(slots);
+    std::vector<const ChessBoard*> boards;
+    std::vector<Evaluation> results;
+
+    while (!failed.load(std::memory_order_relaxed)) {
+        // Gather a batch of leaves from every game, moving on (and refilling the slot) whenever a search finishes
+        boards.clear();
+        bool active = false;
+        for (std::unique_ptr<Game>& game : games) {
+            while (true) {
+                if (!game) {
+                    int index = next_game.fetch_add(1);
+                    if (index >= config.games) {
+                        break;
+                    }
+                    game.reset(new Game(index, config.seed, evaluator, config.c_puct));
+                    if (!begin_move(*game)) {
+                        finish_game(*game, on_game);
+                        game.reset();
+                        continue;
+                    }
+                }
+                game->first = boards.size();
+                if (game->tree.gather(config.batch_size, boards)) {
+                    break;
+                }
+                if (!play_move(*game)) {
+                    finish_game(*game, on_game);
+                    game.reset();
+                }
+            }
+            active = active || game;
+        }
+        if (!active) {
+            return;
+        }
+        if (boards.empty()) {
+            continue; // Every leaf was terminal or a transposition
+        }
+
+        results.assign(boards.size(), Evaluation());
+        evaluator(boards, results);
+        for (std::unique_ptr<Game>& game : games) {
+            if (game) {
+                game->tree.expand_gathered(results.data() + game->first);
+            }
+        }
+    }
+}
+
+bool SelfPlay::begin_move(Game& game) {
+    if (game.board.is_game_over() || game.record.plies >= config.max_plies) {
+        return false;
+    }
+    SearchLimits limits;
+    limits.simulations = config.simulations;
+    limits.early_stop = config.early_stop && game.record.plies >= config.temperature_plies;
+    game.tree.begin_search(limits);
+    return true;
+}
+
+bool SelfPlay::play_move(Game& game) {
+    GameRecord& record = game.record;
+    SearchStats search = game.tree.end_search();
+    simulations_done.fetch_add(search.simulations, std::memory_order_relaxed);
+    simulations_saved.fetch_add(search.saved, std::memory_order_relaxed);
+    std::vector<std::pair<Move, int>> counts = game.tree.root_visit_counts();
+    int total = 0;
+    for (const auto& entry : counts) {
+        total += entry.second;
+    }
+    if (counts.empty() || total == 0) {
+        return false;
+    }
+
+    record.positions.push_back(pack_position(game.board));
+    record.visits.push_back(pack_visits(counts));
+    game.sides.push_back(game.board.get_turn() == Color::WHITE ? 1 : -1);
+
+    // Sample in proportion to visits early on for opening variety, then play the strongest move
+    size_t chosen = 0;
+    if (record.plies < config.temperature_plies) {
+        uint32_t pick = game.rng.bounded(static_cast<uint32_t>(total));
+        while (pick >= static_cast<uint32_t>(counts[chosen].second)) {
+            pick -= counts[chosen].second;
+            chosen++;
+        }
+    } else {
+        for (size_t i = 1; i < counts.size(); ++i) {
+            if (counts[i].second > counts[chosen].second) {
+                chosen = i;
+            }
+        }
+    }
+
+    const Move& move = counts[chosen].first;
+    game.board.make_move(move);
+    game.tree.advance(move);
+    record.plies++;
+    return begin_move(game);
+}
+
+void SelfPlay::finish_game(Game& game, const std::function<void(GameRecord&)>& on_game) {
+    GameRecord& record = game.record;
+    record.outcome = game.board.is_game_over() ? game.board.get_outcome() : 0;
+    record.values.reserve(game.sides.size());
+    for (int side : game.sides) {
+        record.values.push_back(static_cast<float>(record.outcome * side));
+    }
+
+    std::lock_guard<std::mutex> lock(output_mutex);
+    positions_done.fetch_add(record.plies);
+    games_done.fetch_add(1);
+    outcomes[record.outcome + 1].fetch_add(1);
+    if (!failed.load()) {
+        on_game(record);
+    }
+}
+
+SelfPlayStats SelfPlay::stats() const {
+    SelfPlayStats stats;
+    stats.games = games_done.load();
+    stats.positions = positions_done.load();
+    stats.simulations = simulations_done.load();
+    stats.simulations_saved = simulations_saved.load();
+    stats.black_wins = outcomes[0].load();
+    stats.draws = outcomes[1].load();
+    stats.white_wins = outcomes[2].load();
+    long long end = end_ns.load();
+    long long start = start_ns.load();
+    stats.seconds = start == 0 ? 0.0 : ((end != 0 ? end : now_ns()) - start) * 1e-9;
+    if (stats.seconds > 0.0) {
+        stats.games_per_hour = stats.games * 3600.0 / stats.seconds;
+        stats.positions_per_second = stats.positions / stats.seconds;
+    }
+    return stats;
+}
@@ -0,0 +1,128 @@
+#ifndef SELF_PLAY_H
+#define SELF_PLAY_H
+
+#include "ChessBoard.h"
+#include "MCTS.h"
+#include "Policy.h"
+#include "Replay.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Settings for a self-play run.
+ */
+struct SelfPlayConfig {
+    int games = 100;                // Total number of games to play
+    int concurrent_games = 64;      // Games in progress at once, shared out among the worker threads
+    int threads = 0;                // Worker threads, each stepping its share of the games in turn; 0 means one per core
+    int simulations = 200;          // Search simulations per move
+    int batch_size = 8;             // Leaves per evaluator call within one search
+    float c_puct = 1.0f;
+    int temperature_plies = 30;     // Moves are sampled in proportion to visits for this many plies, then the most visited is played
+    int max_plies = 512;            // Games still running after this many plies are scored as draws
+    bool early_stop = false;        // After the temperature plies, stop each search once its most visited move is decided
+    uint64_t seed = 0;              // Game g samples its moves from a generator seeded with seed + g
+};
+
+/**
+ * @brief One finished self-play game: a training record per position played.
+ */
+struct GameRecord {
+    int index = 0;                  // Game number within the run (0 .. games - 1)
+    int outcome = 0;                // 1 White win, -1 Black win, 0 draw (including games cut off at max_plies)
+    int plies = 0;
+    std::vector<PackedPosition> positions;          // Per position: the board (unpack_state() gives the network input)
+    std::vector<std::vector<VisitCount>> visits;    // Per position: root visit count of each move
+    std::vector<float> values;      // Per position: outcome from the perspective of the side to move there
+};
+
+/**
+ * @brief Throughput of a self-play run.
+ */
+struct SelfPlayStats {
+    long long games = 0;
+    long long positions = 0;
+    double seconds = 0.0;
+    double games_per_hour = 0.0;
+    double positions_per_second = 0.0;
+    long long simulations = 0;      // Simulations run over all searches
+    long long simulations_saved = 0;  // Simulations skipped by early stopping
+    long long white_wins = 0;
+    long long draws = 0;
+    long long black_wins = 0;
+};
+
+/**
+ * @brief Plays many games against itself at once to generate training data.
+ *
+ * A fixed pool of worker threads (one per core by default) shares out the concurrent games. Each game
+ * has its own MCTS, reused between moves, and a worker steps all of its games in turn: it gathers a
+ * batch of leaves from every game's search (see MCTS::gather()) and evaluates them together with one
+ * evaluator call, so a worker keeps many games going without a thread each. The workers share the
+ * evaluator, so pass one built with server_evaluator() to also merge the batches of different
+ * workers. Finished games are handed to a callback as they complete.
+ */
+class SelfPlay {
+public:
+    /**
+     * @throws std::invalid_argument if config.simulations, concurrent_games or batch_size is below 1.
+     */
+    SelfPlay(Evaluator evaluator, SelfPlayConfig config);
+
+    /**
+     * @brief Plays config.games games and returns when all are finished.
+     * @param on_game Called with each finished game. Calls are serialized but come from the worker
+     * threads, in completion order.
+     * @return Throughput of the run. An exception thrown by the evaluator or the callback stops the
+     * run (games in progress are abandoned) and is rethrown here once the workers have exited.
+     */
+    SelfPlayStats run(const std::function<void(GameRecord&)>& on_game);
+
+    /**
+     * @brief Returns the progress of the current (or last) run; safe to call while run() is in progress.
+     */
+    SelfPlayStats stats() const;
+
+private:
+    Evaluator evaluator;
+    SelfPlayConfig config;
+    std::atomic<int> next_game{0};
+    std::atomic<long long> games_done{0};
+    std::atomic<long long> positions_done{0};
+    std::atomic<long long> simulations_done{0};
+    std::atomic<long long> simulations_saved{0};
+    std::atomic<long long> outcomes[3] = {{0}, {0}, {0}};  // Black wins, draws, White wins
+    std::atomic<long long> start_ns{0};
+    std::atomic<long long> end_ns{0};
+    std::atomic<bool> failed{false};
+    std::mutex output_mutex;
+
+    struct Game;
+
+    /**
+     * @brief Body of a worker: plays games, up to slots of them at once, until none are left.
+     */
+    void work(int slots, const std::function<void(GameRecord&)>& on_game);
+
+    /**
+     * @brief Starts the search for the next move of a game.
+     * @return False if the game is over (or has reached max_plies) instead.
+     */
+    bool begin_move(Game& game);
+
+    /**
+     * @brief Ends a game's finished search, records the position and plays the chosen move.
+     * @return False if the game is over; otherwise the search for the next move has begun.
+     */
+    bool play_move(Game& game);
+
+    /**
+     * @brief Scores a finished game and hands its record to the callback.
+     */
+    void finish_game(Game& game, const std::function<void(GameRecord&)>& on_game);
+};
+
+#endif // SELF_PLAY_H
@@ -0,0 +1,321 @@
+#include "SharedMemory.h"
+#include "SelfPlay.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory counters must be lock-free");
+
+static constexpr size_t ALIGNMENT = 64;
+
+static size_t round_up(size_t n, size_t to) {
+    return (n + to - 1) / to * to;
+}
+
+static std::string shm_name(const std::string& name) {
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+// Waits (up to a second) for the creator of a region to finish initializing its header
+template <typename Header>
+static bool wait_for_magic(const Header* header, uint32_t magic) {
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        if (header->magic.load(std::memory_order_acquire) == magic) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+SharedRegion::SharedRegion(const std::string& name, size_t size) : region_name(shm_name(name)) {
+    int fd = shm_open(region_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        is_new = true;
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            shm_unlink(region_name.c_str());
+            throw std::runtime_error("cannot size shared memory " + region_name + " (" + std::strerror(errno) + ")");
+        }
+        region_size = size;
+    } else if (errno == EEXIST) {
+        fd = shm_open(region_name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open shared memory " + region_name + " (" + std::strerror(errno) + ")");
+        }
+        // The creator may not have sized it yet
+        struct stat info;
+        for (int attempt = 0; attempt < 1000; ++attempt) {
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        region_size = static_cast<size_t>(info.st_size);
+        if (region_size == 0) {
+            close(fd);
+            throw std::runtime_error("shared memory " + region_name + " was never initialized");
+        }
+    } else {
+        throw std::runtime_error("cannot create shared memory " + region_name + " (" + std::strerror(errno) + ")");
+    }
+
+    void* data = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("cannot map shared memory " + region_name);
+    }
+    region = static_cast<uint8_t*>(data);
+}
+
+SharedRegion::~SharedRegion() {
+    munmap(region, region_size);
+}
+
+uint8_t* SharedRegion::data() const {
+    return region;
+}
+
+size_t SharedRegion::size() const {
+    return region_size;
+}
+
+const std::string& SharedRegion::name() const {
+    return region_name;
+}
+
+bool SharedRegion::created() const {
+    return is_new;
+}
+
+bool SharedRegion::unlink(const std::string& name) {
+    return shm_unlink(shm_name(name).c_str()) == 0;
+}
+
+// The producer's and consumer's counters sit on separate cache lines so the two ends do not contend
+struct RecordRing::Header {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t capacity;
+    alignas(ALIGNMENT) std::atomic<uint64_t> head;  // Bytes written, including prefixes and padding
+    std::atomic<uint64_t> messages_pushed;
+    std::atomic<uint64_t> bytes_pushed;
+    std::atomic<uint64_t> full_waits;
+    alignas(ALIGNMENT) std::atomic<uint64_t> tail;  // Bytes consumed
+    std::atomic<uint64_t> messages_popped;
+};
+
+RecordRing::RecordRing(const std::string& name, size_t requested)
+    : region(name, round_up(sizeof(Header), ALIGNMENT) + round_up(std::max<size_t>(requested, 64), 8)) {
+    header = reinterpret_cast<Header*>(region.data());
+    buffer = region.data() + round_up(sizeof(Header), ALIGNMENT);
+    if (region.created()) {
+        new (header) Header();
+        header->version = VERSION;
+        header->capacity = region.size() - round_up(sizeof(Header), ALIGNMENT);
+        header->head.store(0);
+        header->tail.store(0);
+        header->magic.store(MAGIC, std::memory_order_release);
+    } else if (region.size() < sizeof(Header) || !wait_for_magic(header, MAGIC) || header->version != VERSION ||
+               header->capacity > region.size() - round_up(sizeof(Header), ALIGNMENT)) {
+        throw std::runtime_error("shared memory " + region.name() + " is not a record ring");
+    }
+    capacity = header->capacity;
+}
+
+void RecordRing::copy_in(uint64_t position, const uint8_t* data, size_t size) {
+    size_t offset = static_cast<size_t>(position % capacity);
+    size_t first = std::min(size, capacity - offset);
+    std::memcpy(buffer + offset, data, first);
+    std::memcpy(buffer, data + first, size - first);
+}
+
+void RecordRing::copy_out(uint64_t position, uint8_t* data, size_t size) const {
+    size_t offset = static_cast<size_t>(position % capacity);
+    size_t first = std::min(size, capacity - offset);
+    std::memcpy(data, buffer + offset, first);
+    std::memcpy(data + first, buffer, size - first);
+}
+
+bool RecordRing::push(const uint8_t* data, size_t size, int timeout_ms) {
+    size_t need = sizeof(uint64_t) + round_up(size, 8);
+    if (need > capacity) {
+        throw std::invalid_argument("message of " + std::to_string(size) + " bytes does not fit in ring " + region.name());
+    }
+    std::lock_guard<std::mutex> lock(producer_mutex);
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    if (capacity - (head - header->tail.load(std::memory_order_acquire)) < need) {
+        header->full_waits.fetch_add(1, std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        while (capacity - (head - header->tail.load(std::memory_order_acquire)) < need) {
+            if (timeout_ms >= 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(timeout_ms)) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    uint64_t length = size;
+    copy_in(head, reinterpret_cast<const uint8_t*>(&length), sizeof(length));
+    copy_in(head + sizeof(length), data, size);
+    header->head.store(head + need, std::memory_order_release);
+    header->messages_pushed.fetch_add(1, std::memory_order_relaxed);
+    header->bytes_pushed.fetch_add(size, std::memory_order_relaxed);
+    return true;
+}
+
+bool RecordRing::push_game(const GameRecord& game, uint32_t generation, int timeout_ms) {
+    std::vector<uint8_t> encoded;
+    encode_game(encoded, game, generation);
+    return push(encoded.data(), encoded.size(), timeout_ms);
+}
+
+bool RecordRing::pop(std::vector<uint8_t>& out) {
+    std::lock_guard<std::mutex> lock(consumer_mutex);
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    if (tail == head) {
+        return false;
+    }
+    uint64_t length = 0;
+    copy_out(tail, reinterpret_cast<uint8_t*>(&length), sizeof(length));
+    if (sizeof(length) + round_up(length, 8) > head - tail) {
+        throw std::runtime_error("corrupt message in ring " + region.name());
+    }
+    out.resize(length);
+    copy_out(tail + sizeof(length), out.data(), length);
+    header->tail.store(tail + sizeof(length) + round_up(length, 8), std::memory_order_release);
+    header->messages_popped.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+size_t RecordRing::drain(ShardWriter& writer) {
+    std::vector<uint8_t> message;
+    size_t records = 0;
+    while (pop(message)) {
+        records += writer.append_records(message.data(), message.size());
+    }
+    if (records > 0) {
+        writer.flush();
+    }
+    return records;
+}
+
+RingStats RecordRing::stats() const {
+    RingStats stats;
+    stats.messages_pushed = static_cast<long long>(header->messages_pushed.load(std::memory_order_relaxed));
+    stats.messages_popped = static_cast<long long>(header->messages_popped.load(std::memory_order_relaxed));
+    stats.bytes_pushed = static_cast<long long>(header->bytes_pushed.load(std::memory_order_relaxed));
+    stats.full_waits = static_cast<long long>(header->full_waits.load(std::memory_order_relaxed));
+    uint64_t tail = header->tail.load(std::memory_order_acquire);
+    stats.pending_bytes = static_cast<long long>(header->head.load(std::memory_order_acquire) - tail);
+    stats.capacity = capacity;
+    return stats;
+}
+
+const std::string& RecordRing::name() const {
+    return region.name();
+}
+
+struct WeightSlot::Header {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint64_t capacity;
+    alignas(ALIGNMENT) std::atomic<uint64_t> sequence;  // Odd while a publish is in progress
+    std::atomic<uint64_t> generation;
+    std::atomic<uint64_t> size;
+};
+
+WeightSlot::WeightSlot(const std::string& name, size_t requested)
+    : region(name, round_up(sizeof(Header), ALIGNMENT) + round_up(std::max<size_t>(requested, 64), ALIGNMENT)) {
+    header = reinterpret_cast<Header*>(region.data());
+    blob = region.data() + round_up(sizeof(Header), ALIGNMENT);
+    if (region.created()) {
+        new (header) Header();
+        header->version = VERSION;
+        header->capacity = region.size() - round_up(sizeof(Header), ALIGNMENT);
+        header->sequence.store(0);
+        header->generation.store(0);
+        header->size.store(0);
+        header->magic.store(MAGIC, std::memory_order_release);
+    } else if (region.size() < sizeof(Header) || !wait_for_magic(header, MAGIC) || header->version != VERSION ||
+               header->capacity > region.size() - round_up(sizeof(Header), ALIGNMENT)) {
+        throw std::runtime_error("shared memory " + region.name() + " is not a weight slot");
+    }
+    blob_capacity = header->capacity;
+}
+
+uint64_t WeightSlot::publish(const uint8_t* data, size_t size) {
+    if (size > blob_capacity) {
+        throw std::invalid_argument("blob of " + std::to_string(size) + " bytes does not fit in slot " + region.name() +
+                                    " (" + std::to_string(blob_capacity) + " bytes)");
+    }
+    // Odd from here on, even if a publisher that crashed mid-publish left the sequence odd
+    uint64_t odd = header->sequence.load(std::memory_order_relaxed) | 1;
+    header->sequence.store(odd, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(blob, data, size);
+    header->size.store(size, std::memory_order_relaxed);
+    uint64_t generation = header->generation.load(std::memory_order_relaxed) + 1;
+    header->generation.store(generation, std::memory_order_relaxed);
+    header->sequence.store(odd + 1, std::memory_order_release);
+    return generation;
+}
+
+uint64_t WeightSlot::generation() const {
+    return header->generation.load(std::memory_order_acquire);
+}
+
+uint64_t WeightSlot::read(std::shared_ptr<const uint8_t>& out, size_t& size, uint64_t known_generation) const {
+    std::shared_ptr<uint8_t> copy;
+    size_t copy_capacity = 0;
+    // A publish takes milliseconds; one still running after a second was cut short by a crash
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (true) {
+        uint64_t sequence = header->sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return 0;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t generation = header->generation.load(std::memory_order_relaxed);
+        size_t bytes = static_cast<size_t>(header->size.load(std::memory_order_relaxed));
+        if (generation > known_generation && bytes <= blob_capacity) {
+            if (copy_capacity < bytes || !copy) {
+                copy_capacity = std::max<size_t>(bytes, 1);
+                copy.reset(static_cast<uint8_t*>(::operator new(copy_capacity, std::align_val_t(ALIGNMENT))),
+                           [](uint8_t* p) { ::operator delete(p, std::align_val_t(ALIGNMENT)); });
+            }
+            std::memcpy(copy.get(), blob, bytes);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->sequence.load(std::memory_order_relaxed) != sequence) {
+            continue; // A publish overlapped the copy
+        }
+        if (generation <= known_generation) {
+            return 0;
+        }
+        out = std::move(copy);
+        size = bytes;
+        return generation;
+    }
+}
+
+size_t WeightSlot::capacity() const {
+    return blob_capacity;
+}
+
+const std::string& WeightSlot::name() const {
+    return region.name();
+}
@@ -0,0 +1,187 @@
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include "Replay.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Transport between the processes of one machine through POSIX shared memory (/dev/shm): self-play
+ * processes hand their games to the trainer through RecordRings, and the trainer publishes new
+ * weights to them through a WeightSlot. Objects are named like shm_open() names ("/chess-ring-0";
+ * the leading slash is optional) and outlive the processes that use them until unlink()ed.
+ */
+
+/**
+ * @brief A named shared-memory region, created on first open and mapped read-write.
+ */
+class SharedRegion {
+public:
+    /**
+     * @param name shm_open() name.
+     * @param size Bytes to create the region with; an existing region keeps its size.
+     * @throws std::runtime_error if the region cannot be opened or mapped.
+     */
+    SharedRegion(const std::string& name, size_t size);
+    ~SharedRegion();
+
+    SharedRegion(const SharedRegion&) = delete;
+    SharedRegion& operator=(const SharedRegion&) = delete;
+
+    uint8_t* data() const;
+    size_t size() const;
+    const std::string& name() const;
+
+    /**
+     * @brief True if this call created the region (it is zero-filled and needs initializing).
+     */
+    bool created() const;
+
+    /**
+     * @brief Removes the name; processes that have the region mapped keep using it.
+     * @return False if there was no such region.
+     */
+    static bool unlink(const std::string& name);
+
+private:
+    std::string region_name;
+    uint8_t* region = nullptr;
+    size_t region_size = 0;
+    bool is_new = false;
+};
+
+/**
+ * @brief Throughput counters of a RecordRing, shared by both ends.
+ */
+struct RingStats {
+    long long messages_pushed = 0;
+    long long messages_popped = 0;
+    long long bytes_pushed = 0;
+    long long pending_bytes = 0;    // Written but not yet consumed
+    long long full_waits = 0;       // Pushes that had to wait for the consumer to make room
+    size_t capacity = 0;
+};
+
+/**
+ * @brief Single-producer, single-consumer ring of variable-size messages in shared memory.
+ *
+ * The producer and consumer each own one counter (bytes written, bytes consumed), published with
+ * release stores and read with acquire loads, so neither side takes a lock or makes a system call
+ * while the ring has room. Messages are length-prefixed, padded to 8 bytes and may wrap around the
+ * end of the buffer. One process produces and one consumes per ring (threads of one process may
+ * share an end: pushes and pops are serialized by a process-local mutex).
+ */
+class RecordRing {
+public:
+    static constexpr uint32_t MAGIC = 0x474E5252;   // "RRNG"
+    static constexpr uint32_t VERSION = 1;
+
+    /**
+     * @brief Opens the ring, creating it with capacity bytes of message space if it does not exist.
+     * @throws std::runtime_error if the region exists but is not a ring.
+     */
+    RecordRing(const std::string& name, size_t capacity = 64 << 20);
+
+    /**
+     * @brief Appends a message, waiting while the ring is full.
+     * @param timeout_ms Longest wait for room; negative waits indefinitely.
+     * @return False if the ring was still full after timeout_ms.
+     * @throws std::invalid_argument if the message can never fit.
+     */
+    bool push(const uint8_t* data, size_t size, int timeout_ms = -1);
+
+    /**
+     * @brief Appends the records of a finished self-play game (see encode_game()) as one message.
+     */
+    bool push_game(const GameRecord& game, uint32_t generation = 0, int timeout_ms = -1);
+
+    /**
+     * @brief Removes the oldest message into out (replacing its contents).
+     * @return False if the ring is empty.
+     */
+    bool pop(std::vector<uint8_t>& out);
+
+    /**
+     * @brief Moves every pending message, which must hold encoded records, into a shard.
+     * @return Number of records appended.
+     */
+    size_t drain(ShardWriter& writer);
+
+    RingStats stats() const;
+    const std::string& name() const;
+
+private:
+    struct Header;
+
+    SharedRegion region;
+    Header* header = nullptr;
+    uint8_t* buffer = nullptr;
+    size_t capacity = 0;
+    std::mutex producer_mutex;
+    std::mutex consumer_mutex;
+
+    void copy_in(uint64_t position, const uint8_t* data, size_t size);
+    void copy_out(uint64_t position, uint8_t* data, size_t size) const;
+};
+
+/**
+ * @brief A versioned blob in shared memory, written by one publisher and read by any number of processes.
+ *
+ * Guarded by a sequence lock: the publisher makes the sequence odd, copies the data in and makes it
+ * even again; readers copy the data out and retry if the sequence was odd or changed meanwhile, so
+ * they never block the publisher and never see a torn blob. Each publish() bumps the generation, which
+ * readers compare against the one they last loaded.
+ */
+class WeightSlot {
+public:
+    static constexpr uint32_t MAGIC = 0x544F4C53;   // "SLOT"
+    static constexpr uint32_t VERSION = 1;
+
+    /**
+     * @brief Opens the slot, creating it with room for capacity bytes if it does not exist.
+     * @throws std::runtime_error if the region exists but is not a slot.
+     */
+    WeightSlot(const std::string& name, size_t capacity = 64 << 20);
+
+    /**
+     * @brief Replaces the blob. Only one process may publish to a slot; a publisher restarted after a
+     * crash may carry on with the same slot.
+     * @return The new generation (1 for the first publish).
+     * @throws std::invalid_argument if the data does not fit.
+     */
+    uint64_t publish(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Generation of the current blob (0 if nothing was published yet).
+     */
+    uint64_t generation() const;
+
+    /**
+     * @brief Copies the blob out if it is newer than known_generation.
+     *
+     * Waits for a publish in progress, but for a second at most: a publisher that crashed mid-publish
+     * leaves the blob unreadable until it (or its replacement) publishes again, and read() returns 0.
+     * @param out Receives the blob in a FILE_ALIGNMENT-aligned buffer (suitable for Network).
+     * @param size Receives its size.
+     * @return The generation read, or 0 if there is nothing newer than known_generation or the blob
+     * is still being written.
+     */
+    uint64_t read(std::shared_ptr<const uint8_t>& out, size_t& size, uint64_t known_generation = 0) const;
+
+    size_t capacity() const;
+    const std::string& name() const;
+
+private:
+    struct Header;
+
+    SharedRegion region;
+    Header* header = nullptr;
+    uint8_t* blob = nullptr;
+    size_t blob_capacity = 0;
+};
+
+#endif // SHARED_MEMORY_H
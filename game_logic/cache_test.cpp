@@ -0,0 +1,47 @@
+#include "EvalCache.h"
+#include <cstdio>
+#include <string>
+
+// Checks what the Python tests cannot reach through board-keyed lookups: two positions whose hashes
+// collide. An entry cached for one must not be returned for the other when their numbers of legal
+// moves differ. Returns nonzero on failure.
+// Usage: ./cache_test
+
+static int failures = 0;
+
+static void check(bool passed, const std::string& what) {
+    if (!passed) {
+        std::printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+int main() {
+    for (ReplacementPolicy policy : {ReplacementPolicy::ALWAYS, ReplacementPolicy::LRU, ReplacementPolicy::LFU}) {
+        EvalCache cache(1024, policy);
+        const uint64_t key = 0x9E3779B97F4A7C15ull;
+        Evaluation stored;
+        stored.value = 0.5f;
+        stored.priors = {0.25f, 0.25f, 0.5f};
+        cache.insert(key, stored);
+
+        Evaluation found;
+        check(cache.lookup(key, 3, found) && found.value == 0.5f && found.priors == stored.priors, "hit on the same key and move count");
+        found = Evaluation();
+        check(!cache.lookup(key, 4, found) && found.priors.empty(), "a different move count is a collision, not a hit");
+        check(!cache.lookup(key, 0, found), "no moves is a collision too");
+
+        // The colliding position's evaluation replaces the entry in place
+        Evaluation other;
+        other.value = -1.0f;
+        other.priors = {0.5f, 0.5f};
+        cache.insert(key, other);
+        check(cache.lookup(key, 2, found) && found.value == -1.0f, "the colliding position replaces the entry");
+        check(!cache.lookup(key, 3, found), "the replaced position misses");
+        EvalCacheStats stats = cache.stats();
+        check(stats.entries == 1 && stats.evictions == 0, "a refreshed key is not an eviction");
+        check(stats.lookups == 5 && stats.hits == 2, "lookup and hit counts");
+    }
+    std::printf("%s: evaluation cache collisions checked, %d failures\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
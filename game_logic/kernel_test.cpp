@@ -0,0 +1,177 @@
+#include "Kernels.h"
+#include "Random.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// Checks every GEMM and dot product kernel the CPU supports against the portable one, on shapes
+// that exercise the tile edges and the scalar column tails (odd M, N and K). The float kernels must agree
+// up to rounding, the INT8 kernels exactly. Returns nonzero on failure.
+// Usage: ./kernel_test
+
+static int failures = 0;
+
+static std::vector<float> random_floats(Xoshiro256& rng, size_t count) {
+    std::vector<float> values(count);
+    for (float& value : values) {
+        value = static_cast<float>(rng.bounded(1u << 20)) / (1u << 19) - 1.0f;
+    }
+    return values;
+}
+
+static void check(bool passed, const char* kernel, int M, int N, int K, const char* what) {
+    if (!passed) {
+        std::printf("FAIL %s M=%d N=%d K=%d: %s\n", kernel, M, N, K, what);
+        failures++;
+    }
+}
+
+using Gemm = std::function<void(const float*, const float*, const float*, float*, int, int, int, bool)>;
+
+// Float sums in a different order differ by rounding, at most a few ulps of the sum of |terms| per term
+static void check_gemm(const char* name, const Gemm& kernel, Xoshiro256& rng, int M, int N, int K) {
+    std::vector<float> A = random_floats(rng, static_cast<size_t>(M) * K);
+    std::vector<float> B = random_floats(rng, static_cast<size_t>(K) * N);
+    std::vector<float> bias = random_floats(rng, N);
+    std::vector<float> magnitude_A(A.size()), magnitude_B(B.size()), magnitude_bias(N);
+    std::transform(A.begin(), A.end(), magnitude_A.begin(), [](float x) { return std::fabs(x); });
+    std::transform(B.begin(), B.end(), magnitude_B.begin(), [](float x) { return std::fabs(x); });
+    std::transform(bias.begin(), bias.end(), magnitude_bias.begin(), [](float x) { return std::fabs(x); });
+    std::vector<float> bound(static_cast<size_t>(M) * N);
+    gemm_scalar(magnitude_A.data(), magnitude_B.data(), magnitude_bias.data(), bound.data(), M, N, K, false);
+
+    for (bool relu : {false, true}) {
+        // Poisoned outputs catch kernels that skip a column or row
+        std::vector<float> expected(static_cast<size_t>(M) * N, NAN);
+        std::vector<float> actual(static_cast<size_t>(M) * N, NAN);
+        gemm_scalar(A.data(), B.data(), bias.data(), expected.data(), M, N, K, relu);
+        kernel(A.data(), B.data(), bias.data(), actual.data(), M, N, K, relu);
+        bool close = true;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            close = close && std::fabs(actual[i] - expected[i]) <= 1e-5f * (K + 1) * bound[i] + 1e-6f;
+        }
+        check(close, name, M, N, K, relu ? "differs from scalar (relu)" : "differs from scalar");
+    }
+}
+
+static void check_dot(const char* name, float (*kernel)(const float*, const float*, int), Xoshiro256& rng, int n) {
+    std::vector<float> a = random_floats(rng, n);
+    std::vector<float> b = random_floats(rng, n);
+    float bound = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        bound += std::fabs(a[i] * b[i]);
+    }
+    float difference = std::fabs(kernel(a.data(), b.data(), n) - dot_scalar(a.data(), b.data(), n));
+    check(difference <= 1e-5f * (n + 1) * bound + 1e-6f, name, 1, 1, n, "dot product differs from scalar");
+}
+
+using GemmInt8 = std::function<void(const uint8_t*, const int8_t*, const float*, const float*, float*, int, int, int, bool)>;
+
+// With unit scales and no bias the outputs are the integer sums themselves (exact in float below 2^24),
+// which must match bit for bit; extreme codes check that no kernel saturates an intermediate sum
+static void check_gemm_int8(const char* name, const GemmInt8& kernel, Xoshiro256& rng, int M, int N, int K, bool extreme) {
+    std::vector<uint8_t> A(static_cast<size_t>(M) * K);
+    std::vector<int8_t> B(static_cast<size_t>(K) * N);
+    for (uint8_t& code : A) {
+        code = extreme ? 127 : static_cast<uint8_t>(rng.bounded(128));
+    }
+    for (int8_t& weight : B) {
+        weight = static_cast<int8_t>(extreme ? (rng.bounded(2) ? 127 : -128) : static_cast<int>(rng.bounded(256)) - 128);
+    }
+    std::vector<float> ones(N, 1.0f), zeros(N, 0.0f);
+    std::vector<float> expected(static_cast<size_t>(M) * N, NAN);
+    std::vector<float> actual(static_cast<size_t>(M) * N, NAN);
+    gemm_int8_scalar(A.data(), B.data(), ones.data(), zeros.data(), expected.data(), M, N, K, false);
+    kernel(A.data(), B.data(), ones.data(), zeros.data(), actual.data(), M, N, K, false);
+    check(expected == actual, name, M, N, K, extreme ? "integer sums differ (extreme codes)" : "integer sums differ");
+
+    // Scales, bias and relu are applied in float (fused or not), so only up to rounding
+    std::vector<float> scales = random_floats(rng, N), bias = random_floats(rng, N);
+    gemm_int8_scalar(A.data(), B.data(), scales.data(), bias.data(), expected.data(), M, N, K, true);
+    kernel(A.data(), B.data(), scales.data(), bias.data(), actual.data(), M, N, K, true);
+    bool close = true;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        close = close && std::fabs(actual[i] - expected[i]) <= 1e-6f * (std::fabs(expected[i]) + 1.0f) * 16;
+    }
+    check(close, name, M, N, K, "scaled outputs differ");
+}
+
+static void check_dot_int8(const char* name, int32_t (*kernel)(const uint8_t*, const int8_t*, int), Xoshiro256& rng, int n) {
+    std::vector<uint8_t> a(n);
+    std::vector<int8_t> b(n);
+    for (int i = 0; i < n; ++i) {
+        a[i] = static_cast<uint8_t>(rng.bounded(128));
+        b[i] = static_cast<int8_t>(static_cast<int>(rng.bounded(256)) - 128);
+    }
+    check(kernel(a.data(), b.data(), n) == dot_int8_scalar(a.data(), b.data(), n), name, 1, 1, n, "dot product differs from scalar");
+}
+
+int main() {
+    Xoshiro256 rng(1);
+    // M covers every tile height (1 .. 8) and a remainder; N the vector widths (16, 32) with odd tails;
+    // K includes 1 and the conv1/conv2 im2col depths
+    const int shapes[][3] = {{1, 1, 1}, {1, 33, 7}, {3, 17, 5}, {5, 47, 9}, {6, 16, 81}, {7, 31, 13},
+                             {8, 32, 1}, {9, 65, 27}, {13, 97, 19}, {17, 6, 129}, {64, 129, 81}, {37, 4096, 3}};
+    std::vector<std::pair<const char*, Gemm>> kernels = {{"gemm", gemm}};
+    std::vector<std::pair<const char*, float (*)(const float*, const float*, int)>> dots = {{"dot", dot}};
+    std::vector<std::pair<const char*, GemmInt8>> int8_kernels = {{"gemm_int8", gemm_int8}};
+    std::vector<std::pair<const char*, int32_t (*)(const uint8_t*, const int8_t*, int)>> int8_dots = {{"dot_int8", dot_int8}};
+#ifdef CHESS_X86
+    if (cpu_has_avx512()) {
+        kernels.emplace_back("gemm_avx512", gemm_avx512);
+        dots.emplace_back("dot_avx512", dot_avx512);
+    } else {
+        std::printf("skipped gemm_avx512: no AVX-512 on this CPU\n");
+    }
+    if (cpu_has_avx2_fma()) {
+        kernels.emplace_back("gemm_avx2", gemm_avx2);
+        dots.emplace_back("dot_avx2", dot_avx2);
+    } else {
+        std::printf("skipped gemm_avx2: no AVX2/FMA on this CPU\n");
+    }
+    if (cpu_has_avx512_vnni()) {
+        int8_kernels.emplace_back("gemm_int8_vnni", gemm_int8_vnni);
+        int8_dots.emplace_back("dot_int8_vnni", dot_int8_vnni);
+    } else {
+        std::printf("skipped gemm_int8_vnni: no AVX-512 VNNI on this CPU\n");
+    }
+    if (cpu_has_avx2_fma()) {
+        int8_kernels.emplace_back("gemm_int8_avx2", gemm_int8_avx2);
+        int8_dots.emplace_back("dot_int8_avx2", dot_int8_avx2);
+    } else {
+        std::printf("skipped gemm_int8_avx2: no AVX2/FMA on this CPU\n");
+    }
+#endif
+
+    for (const auto& kernel : kernels) {
+        for (const auto& shape : shapes) {
+            check_gemm(kernel.first, kernel.second, rng, shape[0], shape[1], shape[2]);
+        }
+    }
+    for (const auto& kernel : dots) {
+        for (int n : {1, 7, 15, 16, 17, 31, 33, 63, 65, 256, 257}) {
+            check_dot(kernel.first, kernel.second, rng, n);
+        }
+    }
+
+    // K is a multiple of 4 here (the quantized layers pad their inputs), up to conv2's 9 * 128
+    const int int8_shapes[][3] = {{1, 1, 4}, {1, 33, 8}, {3, 17, 12}, {4, 16, 4}, {5, 47, 36}, {7, 31, 84},
+                                  {8, 32, 4}, {9, 65, 76}, {13, 97, 20}, {17, 6, 132}, {64, 129, 1152}, {37, 4096, 256}};
+    for (const auto& kernel : int8_kernels) {
+        for (const auto& shape : int8_shapes) {
+            check_gemm_int8(kernel.first, kernel.second, rng, shape[0], shape[1], shape[2], false);
+        }
+        check_gemm_int8(kernel.first, kernel.second, rng, 9, 65, 1152, true);
+    }
+    for (const auto& kernel : int8_dots) {
+        for (int n : {1, 7, 31, 32, 33, 63, 64, 65, 129, 256, 1153}) {
+            check_dot_int8(kernel.first, kernel.second, rng, n);
+        }
+    }
+
+    std::printf("%s: %zu float and %zu INT8 kernels checked, %d failures\n", failures ? "FAILED" : "OK",
+                kernels.size() + dots.size(), int8_kernels.size() + int8_dots.size(), failures);
+    return failures ? 1 : 0;
+}
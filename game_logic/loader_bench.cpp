@@ -0,0 +1,37 @@
+#include "DataLoader.h"
+#include "Policy.h"
+#include <iostream>
+#include <cstdlib>
+
+// Measures how fast training batches can be drawn from a directory of shards (write one with
+// ./selfplay_bench ... dir/games.shard). The consumer only touches each batch, so this is the
+// ceiling the data pipeline puts on training throughput.
+// Usage: ./loader_bench directory [batches] [batch_size] [threads] [prefetch]
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " directory [batches] [batch_size] [threads] [prefetch]\n";
+        return 1;
+    }
+    int batches = argc > 2 ? std::atoi(argv[2]) : 200;
+    LoaderConfig config;
+    config.batch_size = argc > 3 ? std::atoi(argv[3]) : 256;
+    config.threads = argc > 4 ? std::atoi(argv[4]) : 0;
+    config.prefetch = argc > 5 ? std::atoi(argv[5]) : 8;
+
+    DataLoader loader(argv[1], 1 << 30, config);
+    double checksum = 0.0;
+    for (int b = 0; b < batches; ++b) {
+        std::shared_ptr<const TrainingBatch> batch = loader.next();
+        for (int i = 0; i < batch->size; ++i) {
+            checksum += batch->values[i] + batch->policies[static_cast<size_t>(i) * POLICY_SIZE];
+        }
+    }
+    LoaderStats stats = loader.stats();
+
+    std::cout << "Window: " << loader.size() << " positions  threads: " << loader.config().threads
+              << "  batch size: " << config.batch_size << "\n"
+              << "Batches: " << stats.batches << "  positions: " << stats.positions << "  time: " << stats.seconds << " s\n"
+              << "Positions/s: " << stats.positions_per_second << "  consumer waited: " << stats.wait_seconds << " s"
+              << "  (checksum " << checksum << ")\n";
+    return 0;
+}
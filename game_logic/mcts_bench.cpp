@@ -0,0 +1,40 @@
+#include "ChessBoard.h"
+#include "MCTS.h"
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+// Measures raw search speed with a uniform evaluator, i.e. the cost of the tree and the engine alone.
+// Runs the search with 1, 2, 4, ... threads up to max_threads and reports the scaling.
+// Usage: ./mcts_bench [simulations] [batch_size] [max_threads]
+int main(int argc, char** argv) {
+    int simulations = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int batch_size = argc > 2 ? std::atoi(argv[2]) : 1;
+    int max_threads = argc > 3 ? std::atoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency());
+    if (max_threads < 1) max_threads = 1;
+
+    ChessBoard board;
+    double base_rate = 0.0;
+    std::cout << "Simulations: " << simulations << ", batch size: " << batch_size << "\n";
+
+    for (int threads = 1; ; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+
+        MCTS tree(board, uniform_evaluator());
+        auto start_time = std::chrono::high_resolution_clock::now();
+        float value = tree.search(simulations, batch_size, threads);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+        double rate = simulations / seconds;
+        if (threads == 1) base_rate = rate;
+        std::cout << "Threads: " << threads << "  " << rate << " sims/s  speedup: " << (rate / base_rate)
+                  << "  collisions: " << tree.collisions() << "  root value: " << value
+                  << "  best: " << tree.best_move() << "\n";
+
+        if (threads == max_threads) break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "Network.h"
+#include "MCTS.h"
+#include "Random.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Positions reached by up to 80 random plies from the start, one per seed
+static std::vector<ChessBoard> random_positions(int count, uint64_t seed) {
+    std::vector<ChessBoard> boards(count);
+    for (int i = 0; i < count; ++i) {
+        Xoshiro256 rng(seed + static_cast<uint64_t>(i));
+        int plies = static_cast<int>(rng.bounded(80));
+        for (int p = 0; p < plies && !boards[i].is_game_over(); ++p) {
+            const std::vector<Move>& moves = boards[i].legal_moves();
+            boards[i].play_unchecked(moves[rng.bounded(static_cast<uint32_t>(moves.size()))]);
+            boards[i].refresh();
+        }
+    }
+    return boards;
+}
+
+// Dense policy head (all logits, then the masked softmax) against the legal-move-only head
+static void time_batches(const Network& network, const ChessBoard& board) {
+    for (int batch : {1, 8, 64}) {
+        std::vector<float> states(static_cast<size_t>(batch) * STATE_TENSOR_SIZE);
+        std::vector<const std::vector<Move>*> moves(batch, &board.legal_moves());
+        for (int i = 0; i < batch; ++i) {
+            board.copy_state_tensor(states.data() + static_cast<size_t>(i) * STATE_TENSOR_SIZE);
+        }
+        std::vector<float> values(batch);
+        std::vector<float> logits(static_cast<size_t>(batch) * POLICY_SIZE);
+        std::vector<Evaluation> results(batch);
+        int runs = 1 + 2000 / batch;
+        for (bool legal : {false, true}) {
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < runs; ++r) {
+                if (legal) {
+                    network.evaluate_moves(states.data(), moves, results);
+                } else {
+                    network.evaluate(states.data(), batch, values.data(), logits.data());
+                    for (int i = 0; i < batch; ++i) {
+                        results[i].priors.resize(moves[i]->size());
+                        masked_softmax(logits.data() + static_cast<size_t>(i) * POLICY_SIZE, *moves[i], results[i].priors.data());
+                    }
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Batch " << batch << (legal ? " (legal moves only): " : " (dense policy): ") << seconds / runs * 1e6
+                      << " us/batch  " << runs * batch / seconds << " positions/s\n";
+        }
+    }
+}
+
+// Times native ChessCNN inference at a few batch sizes in FP32 and INT8 (with the dense and the legal-move-only
+// policy head), reports the INT8 accuracy
+// on held-out positions, then times a search evaluated by the network.
+// Usage: ./network_bench weights.bin [simulations] [calibration_positions]
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " weights.bin [simulations] [calibration_positions]\n";
+        return 1;
+    }
+    auto load_start = std::chrono::steady_clock::now();
+    auto network = std::make_shared<Network>(argv[1]);
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+    int simulations = argc > 2 ? std::atoi(argv[2]) : 800;
+    int calibration = argc > 3 ? std::atoi(argv[3]) : 512;
+    std::cout << "Kernels: " << Network::kernel() << " / " << Network::int8_kernel()
+              << "  channels: " << network->channels() << "  loaded in " << load_ms << " ms"
+              << (network->mapped() ? " (mapped)" : " (converted from version 1)") << "\n";
+
+    ChessBoard board;
+    std::cout << "FP32\n";
+    time_batches(*network, board);
+
+    std::vector<ChessBoard> calibration_boards = random_positions(calibration, 1);
+    std::vector<float> states(static_cast<size_t>(calibration) * STATE_TENSOR_SIZE);
+    for (int i = 0; i < calibration; ++i) {
+        calibration_boards[i].copy_state_tensor(states.data() + static_cast<size_t>(i) * STATE_TENSOR_SIZE);
+    }
+    network->quantize(states.data(), calibration);
+    std::cout << "INT8 (calibrated on " << calibration << " positions)\n";
+    time_batches(*network, board);
+
+    std::vector<ChessBoard> held_out = random_positions(1024, 1000003);
+    std::vector<const ChessBoard*> held_out_ptrs;
+    for (const ChessBoard& position : held_out) {
+        held_out_ptrs.push_back(&position);
+    }
+    QuantizationReport report = network->compare_precision(held_out_ptrs);
+    std::cout << "INT8 vs FP32 on " << report.positions << " held-out positions: value MAE " << report.value_mae
+              << " (max " << report.value_max_error << "), policy KL " << report.policy_kl << " nats, top-1 agreement "
+              << report.top1_agreement * 100 << "%, speedup " << report.fp32_seconds / report.int8_seconds << "x\n";
+
+    for (Precision precision : {Precision::FP32, Precision::INT8}) {
+        network->set_precision(precision);
+        MCTS tree(board, network_evaluator(legal_network(network)));
+        auto start = std::chrono::steady_clock::now();
+        float value = tree.search(simulations, 8, 1);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Search (" << (precision == Precision::FP32 ? "FP32" : "INT8") << "): " << simulations
+                  << " simulations in " << seconds << " s (" << simulations / seconds << " sims/s)  root value: " << value << "\n";
+    }
+    return 0;
+}
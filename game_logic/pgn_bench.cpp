@@ -0,0 +1,23 @@
+#include "Pgn.h"
+#include <iostream>
+#include <cstdlib>
+
+// Converts a PGN file into training shards <out_prefix>-000.shard, -001.shard, ... (one per thread) and
+// reports the throughput.
+// Usage: ./pgn_bench games.pgn out_prefix [threads] [generation]
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " games.pgn out_prefix [threads] [generation]\n";
+        return 1;
+    }
+    IngestConfig config;
+    config.num_threads = argc > 3 ? std::atoi(argv[3]) : 0;
+    config.generation = argc > 4 ? static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10)) : 0;
+
+    IngestStats stats = ingest_pgn(argv[1], argv[2], config);
+    std::cout << "Games: " << stats.games << "  positions: " << stats.positions << "  skipped: " << stats.skipped
+              << "  truncated at an underpromotion: " << stats.truncated << "  shards: " << stats.shards << "\n"
+              << "Time: " << stats.seconds << " s  MB/s: " << stats.bytes / 1e6 / stats.seconds
+              << "  games/s: " << stats.games / stats.seconds << "  positions/s: " << stats.positions / stats.seconds << "\n";
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "SharedMemory.h"
+#include "Policy.h"
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Moves game-sized messages of encoded records from a forked producer process to this one through a
+// RecordRing, and copies a network-sized blob through a WeightSlot.
+// Usage: ./pipeline_bench [games] [plies_per_game] [ring_mb] [blob_mb]
+int main(int argc, char** argv) {
+    int games = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int plies = argc > 2 ? std::atoi(argv[2]) : 80;
+    size_t ring_bytes = static_cast<size_t>(argc > 3 ? std::atoi(argv[3]) : 16) << 20;
+    size_t blob_bytes = static_cast<size_t>(argc > 4 ? std::atoi(argv[4]) : 10) << 20;
+    std::string name = "/pipeline-bench-" + std::to_string(getpid());
+
+    // One self-play game: plies records with 30 root moves each
+    ChessBoard board;
+    std::vector<VisitCount> visits(30, VisitCount{0, 10});
+    std::vector<uint8_t> game;
+    for (int ply = 0; ply < plies; ++ply) {
+        encode_record(game, pack_position(board), visits, 1, 0, ply, plies, 0);
+    }
+
+    RecordRing ring(name + "-ring", ring_bytes);
+    auto start = std::chrono::steady_clock::now();
+    pid_t child = fork();
+    if (child == 0) {
+        RecordRing producer(name + "-ring");
+        for (int g = 0; g < games; ++g) {
+            producer.push(game.data(), game.size());
+        }
+        _exit(0);
+    }
+
+    std::vector<uint8_t> message;
+    long long records = 0;
+    for (int received = 0; received < games;) {
+        if (ring.pop(message)) {
+            records += static_cast<long long>(count_records(message.data(), message.size()));
+            received++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    waitpid(child, nullptr, 0);
+    RingStats stats = ring.stats();
+    SharedRegion::unlink(name + "-ring");
+
+    std::cout << "Ring: " << games << " games (" << records << " records, " << stats.bytes_pushed / 1e6 << " MB) in "
+              << seconds << " s  games/s: " << games / seconds << "  records/s: " << records / seconds
+              << "  MB/s: " << stats.bytes_pushed / 1e6 / seconds << "  producer waits: " << stats.full_waits << "\n";
+
+    WeightSlot slot(name + "-slot", blob_bytes);
+    std::vector<uint8_t> blob(blob_bytes, 7);
+    start = std::chrono::steady_clock::now();
+    uint64_t generation = slot.publish(blob.data(), blob.size());
+    double publish_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::shared_ptr<const uint8_t> copy;
+    size_t size = 0;
+    start = std::chrono::steady_clock::now();
+    uint64_t read = slot.read(copy, size, 0);
+    double read_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    bool unchanged = slot.read(copy, size, read) == 0;
+    SharedRegion::unlink(name + "-slot");
+
+    std::cout << "Weight slot: published generation " << generation << " (" << blob_bytes / 1e6 << " MB) in " << publish_ms
+              << " ms, read generation " << read << " in " << read_ms << " ms, re-read skipped: " << (unchanged ? "yes" : "no") << "\n";
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include "ChessBoard.h"
+#include "Playout.h"
+#include <iostream>
+#include <cstdlib>
+
+// Plays random games from the start position on all threads: a throughput test of move generation
+// and a stress test of the engine over many thousands of complete games.
+// Usage: ./playout_bench [games] [threads] [capture_bias]
+int main(int argc, char** argv) {
+    int games = argc > 1 ? std::atoi(argv[1]) : 2000;
+    PlayoutConfig config;
+    config.num_threads = argc > 2 ? std::atoi(argv[2]) : 0;
+    config.capture_bias = argc > 3 ? static_cast<float>(std::atof(argv[3])) : 0.0f;
+
+    ChessBoard board;
+    PlayoutResult result = playout(board, games, config);
+
+    std::cout << "Games: " << result.games << "  white: " << result.white_wins << "  draws: " << result.draws
+              << " (unfinished " << result.unfinished << ")  black: " << result.black_wins << "\n"
+              << "Mean length: " << result.mean_plies() << " plies (decisive games: " << result.mean_decisive_plies() << ")\n"
+              << "Time: " << result.seconds << " s  games/s: " << result.games / result.seconds
+              << "  plies/s: " << result.plies / result.seconds << "\n";
+    return 0;
+}
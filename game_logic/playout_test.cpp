@@ -0,0 +1,106 @@
+#include "Playout.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Checks the playouts: their results depend on the seed but not on the thread count, score() is
+// taken from the given side, and the playout evaluator values a position for its side to move.
+// Returns nonzero on failure.
+// Usage: ./playout_test
+
+static int failures = 0;
+
+static void check(bool passed, const std::string& what) {
+    if (!passed) {
+        std::printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+// Board after moves in "g1f3" form (rank 0 is White's home rank)
+static ChessBoard board_after(const std::vector<std::string>& moves) {
+    ChessBoard board;
+    for (const std::string& text : moves) {
+        Move move(text[1] - '1', text[0] - 'a', text[3] - '1', text[2] - 'a');
+        if (!board.make_move(move)) {
+            std::printf("FAIL illegal setup move %s\n", text.c_str());
+            failures++;
+        }
+    }
+    return board;
+}
+
+static bool same_games(const PlayoutResult& a, const PlayoutResult& b) {
+    return a.games == b.games && a.white_wins == b.white_wins && a.draws == b.draws && a.black_wins == b.black_wins &&
+           a.unfinished == b.unfinished && a.plies == b.plies && a.decisive_plies == b.decisive_plies;
+}
+
+static void check_thread_count_does_not_matter() {
+    const ChessBoard start;
+    for (float capture_bias : {0.0f, 0.5f}) {
+        PlayoutConfig config;
+        config.seed = 7;
+        config.max_plies = 300;
+        config.capture_bias = capture_bias;
+        config.num_threads = 1;
+        PlayoutResult one = playout(start, 200, config);
+        config.num_threads = 4;
+        PlayoutResult four = playout(start, 200, config);
+        std::string bias = "capture_bias " + std::to_string(capture_bias);
+        check(one.games == 200, bias + ": game count");
+        check(same_games(one, four), bias + ": 1 and 4 threads played different games");
+        check(one.white_wins + one.draws + one.black_wins == one.games, bias + ": outcomes do not add up");
+
+        config.seed = 8;
+        check(!same_games(one, playout(start, 200, config)), bias + ": another seed played the same games");
+    }
+}
+
+// Games from a finished position end at once with its outcome
+static void check_score_sign() {
+    ChessBoard fools_mate = board_after({"f2f3", "e7e5", "g2g4", "d8h4"});   // White to move, mated
+    ChessBoard scholars_mate = board_after({"e2e4", "e7e5", "f1c4", "b8c6", "d1h5", "g8f6", "h5f7"});   // Black mated
+    check(fools_mate.is_game_over() && scholars_mate.is_game_over(), "setup: the mates are not game over");
+
+    PlayoutResult black_won = playout(fools_mate, 10);
+    check(black_won.black_wins == 10 && black_won.plies == 0, "fool's mate: every game is a Black win");
+    check(black_won.score(Color::WHITE) == -1.0 && black_won.score(Color::BLACK) == 1.0, "fool's mate: score sign");
+    PlayoutResult white_won = playout(scholars_mate, 10);
+    check(white_won.white_wins == 10, "scholar's mate: every game is a White win");
+    check(white_won.score(Color::WHITE) == 1.0 && white_won.score(Color::BLACK) == -1.0, "scholar's mate: score sign");
+
+    PlayoutConfig config;
+    config.seed = 3;
+    PlayoutResult mixed = playout(ChessBoard(), 100, config);
+    double white = static_cast<double>(mixed.white_wins - mixed.black_wins) / mixed.games;
+    check(mixed.score(Color::WHITE) == white && mixed.score(Color::BLACK) == -white, "start position: score sign");
+    check(PlayoutResult().score(Color::WHITE) == 0.0, "no games: score");
+}
+
+// A mated side to move has lost, whichever colour it is
+static void check_evaluator_perspective() {
+    ChessBoard fools_mate = board_after({"f2f3", "e7e5", "g2g4", "d8h4"});
+    ChessBoard scholars_mate = board_after({"e2e4", "e7e5", "f1c4", "b8c6", "d1h5", "g8f6", "h5f7"});
+    ChessBoard start;
+    ChessBoard after_e4 = board_after({"e2e4"});
+    Evaluator evaluator = playout_evaluator(4);
+    std::vector<const ChessBoard*> boards = {&fools_mate, &scholars_mate, &start, &after_e4};
+    std::vector<Evaluation> results(boards.size());
+    evaluator(boards, results);
+    check(results[0].value == -1.0f, "evaluator: White to move and mated is worth -1, got " + std::to_string(results[0].value));
+    check(results[1].value == -1.0f, "evaluator: Black to move and mated is worth -1, got " + std::to_string(results[1].value));
+    check(results[0].priors.empty() && results[1].priors.empty(), "evaluator: a finished position has no priors");
+    for (size_t i = 2; i < boards.size(); ++i) {
+        size_t moves = boards[i]->legal_moves().size();
+        check(results[i].priors == std::vector<float>(moves, 1.0f / moves), "evaluator: priors are not uniform");
+        check(results[i].value >= -1.0f && results[i].value <= 1.0f, "evaluator: value out of range");
+    }
+}
+
+int main() {
+    check_thread_count_does_not_matter();
+    check_score_sign();
+    check_evaluator_perspective();
+    std::printf("%s: playouts checked, %d failures\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
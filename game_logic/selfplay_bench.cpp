@@ -0,0 +1,61 @@
+#include "EvalCache.h"
+#include "InferenceServer.h"
+#include "SelfPlay.h"
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <memory>
+
+// Measures self-play throughput with a constant network behind a shared InferenceServer, i.e. the
+// cost of the games, searches and batching alone. With cache_entries > 0 an evaluation cache of that
+// size sits in front of the server. With a shard path, the games are also written to that shard.
+// Usage: ./selfplay_bench [games] [concurrent_games] [simulations] [batch_size] [cache_entries] [shard]
+int main(int argc, char** argv) {
+    SelfPlayConfig config;
+    config.games = argc > 1 ? std::atoi(argv[1]) : 32;
+    config.concurrent_games = argc > 2 ? std::atoi(argv[2]) : 16;
+    config.simulations = argc > 3 ? std::atoi(argv[3]) : 100;
+    config.batch_size = argc > 4 ? std::atoi(argv[4]) : 4;
+    size_t cache_entries = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 0;
+    std::unique_ptr<ShardWriter> writer = argc > 6 ? std::make_unique<ShardWriter>(argv[6]) : nullptr;
+    config.max_plies = 200;
+
+    auto server = std::make_shared<InferenceServer>(
+        [](const float*, int batch, float* values, float* logits) {
+            std::fill(values, values + batch, 0.0f);
+            std::fill(logits, logits + static_cast<size_t>(batch) * POLICY_SIZE, 0.0f);
+        },
+        config.concurrent_games * config.batch_size, std::chrono::microseconds(500));
+
+    std::shared_ptr<EvalCache> cache;
+    Evaluator evaluator = server_evaluator(server);
+    if (cache_entries > 0) {
+        cache = std::make_shared<EvalCache>(cache_entries);
+        evaluator = cached_evaluator(evaluator, cache);
+    }
+
+    SelfPlay self_play(evaluator, config);
+    long long outcomes[3] = {0, 0, 0};
+    SelfPlayStats stats = self_play.run([&](GameRecord& game) {
+        outcomes[game.outcome + 1]++;
+        if (writer) {
+            writer->write_game(game);
+        }
+    });
+    InferenceStats inference = server->stats();
+
+    std::cout << "Games: " << stats.games << " (white " << outcomes[2] << ", draw " << outcomes[1] << ", black " << outcomes[0] << ")"
+              << "  positions: " << stats.positions << "  time: " << stats.seconds << " s\n"
+              << "Games/hour: " << stats.games_per_hour << "  positions/s: " << stats.positions_per_second << "\n"
+              << "Batches: " << inference.batches << "  mean batch: " << inference.mean_batch_size
+              << "  fill: " << inference.batch_fill << "  mean latency: " << inference.mean_latency_us << " us\n";
+    if (cache) {
+        EvalCacheStats cached = cache->stats();
+        std::cout << "Cache hits: " << cached.hits << " / " << cached.lookups << " (" << cached.hit_rate * 100.0 << "%)"
+                  << "  entries: " << cached.entries << "  evictions: " << cached.evictions << "\n";
+    }
+    if (writer) {
+        std::cout << "Shard " << writer->path() << ": " << writer->records() << " records\n";
+    }
+    return 0;
+}
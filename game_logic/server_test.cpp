@@ -0,0 +1,175 @@
+#include "InferenceServer.h"
+#include "Random.h"
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Checks the InferenceServer queue: requests pushed from many threads at once must each come back
+// with the evaluation of their own position, and destroying the server must fail the requests still
+// queued instead of leaving their callers waiting. Returns nonzero on failure.
+// Usage: ./server_test
+
+static int failures = 0;
+
+static void check(bool passed, const std::string& what) {
+    if (!passed) {
+        std::printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+// A value and logits that depend on every input of the position, so a result delivered to the wrong
+// request is caught
+static void fingerprint_network(const float* states, int batch, float* values, float* logits) {
+    for (int b = 0; b < batch; ++b) {
+        const float* state = states + static_cast<size_t>(b) * STATE_TENSOR_SIZE;
+        double sum = 0.0;
+        for (int i = 0; i < STATE_TENSOR_SIZE; ++i) {
+            sum += state[i] * static_cast<double>((i * 2654435761u) >> 24);
+        }
+        values[b] = static_cast<float>(std::sin(sum));
+        for (int p = 0; p < POLICY_SIZE; ++p) {
+            logits[static_cast<size_t>(b) * POLICY_SIZE + p] = static_cast<float>(std::sin(sum * 0.001 + p * 0.37));
+        }
+    }
+}
+
+static ChessBoard random_position(Xoshiro256& rng) {
+    ChessBoard board;
+    int plies = static_cast<int>(rng.bounded(60));
+    for (int p = 0; p < plies && !board.is_game_over(); ++p) {
+        const std::vector<Move>& moves = board.legal_moves();
+        board.play_unchecked(moves[rng.bounded(static_cast<uint32_t>(moves.size()))]);
+        board.refresh();
+    }
+    return board;
+}
+
+static bool same(const Evaluation& a, const Evaluation& b) {
+    return a.value == b.value && a.priors == b.priors;
+}
+
+// Producers submit interleaved with each other (and with the batching thread) and check their own results
+static void check_many_producers(int producers, int requests_per_producer, int max_batch_size) {
+    auto server = std::make_shared<InferenceServer>(BatchNetwork(fingerprint_network), max_batch_size, std::chrono::microseconds(200));
+    Evaluator direct = network_evaluator(BatchNetwork(fingerprint_network));
+    std::vector<int> wrong(producers, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; ++t) {
+        threads.emplace_back([&, t] {
+            Xoshiro256 rng(static_cast<uint64_t>(t) + 1);
+            std::vector<ChessBoard> boards;
+            std::vector<std::future<Evaluation>> futures;
+            for (int r = 0; r < requests_per_producer; ++r) {
+                boards.push_back(random_position(rng));
+                futures.push_back(server->submit(boards.back()));
+                if (rng.bounded(4) == 0) {
+                    std::this_thread::yield();
+                }
+            }
+            std::vector<const ChessBoard*> pointers;
+            for (const ChessBoard& board : boards) {
+                pointers.push_back(&board);
+            }
+            std::vector<Evaluation> expected(boards.size());
+            direct(pointers, expected);
+            for (size_t r = 0; r < futures.size(); ++r) {
+                wrong[t] += same(futures[r].get(), expected[r]) ? 0 : 1;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    int total_wrong = 0;
+    for (int count : wrong) {
+        total_wrong += count;
+    }
+    // The counters are bumped after the batch's futures are fulfilled, so give the last batch a moment
+    long long requests = static_cast<long long>(producers) * requests_per_producer;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (server->stats().requests < requests && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    InferenceStats stats = server->stats();
+    std::string shape = std::to_string(producers) + " producers, batch " + std::to_string(max_batch_size);
+    check(total_wrong == 0, shape + ": " + std::to_string(total_wrong) + " results went to the wrong request");
+    check(stats.requests == requests, shape + ": request count");
+    check(stats.mean_batch_size <= max_batch_size, shape + ": batch larger than max_batch_size");
+}
+
+// The network blocks on its first batch while more requests queue up behind it; the server is then
+// destroyed, and once the first batch finishes every queued request must fail rather than hang
+static void check_shutdown_fails_queued_requests() {
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool entered = false;
+    bool released = false;
+    BatchNetwork blocking = [&](const float* states, int batch, float* values, float* logits) {
+        std::unique_lock<std::mutex> lock(mutex);
+        entered = true;
+        changed.notify_all();
+        changed.wait(lock, [&] { return released; });
+        lock.unlock();
+        fingerprint_network(states, batch, values, logits);
+    };
+    auto server = std::make_unique<InferenceServer>(blocking, 1, std::chrono::microseconds(0));
+
+    ChessBoard board;
+    std::future<Evaluation> first = server->submit(board);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return entered; });
+    }
+    std::vector<std::future<Evaluation>> queued;
+    for (int i = 0; i < 50; ++i) {
+        queued.push_back(server->submit(board));
+    }
+
+    std::thread destroyer([&] { server.reset(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Let the destructor flag the stop first
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        released = true;
+    }
+    changed.notify_all();
+    destroyer.join();
+
+    check(first.wait_for(std::chrono::seconds(0)) == std::future_status::ready, "shutdown: batch in flight not finished");
+    try {
+        first.get();
+    } catch (const std::exception& e) {
+        check(false, std::string("shutdown: batch in flight failed: ") + e.what());
+    }
+    int stopped = 0;
+    for (std::future<Evaluation>& future : queued) {
+        if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            check(false, "shutdown: a queued request was left waiting");
+            return;
+        }
+        try {
+            future.get();
+        } catch (const std::exception& e) {
+            stopped += std::string(e.what()) == "inference server stopped" ? 1 : 0;
+        }
+    }
+    check(stopped == static_cast<int>(queued.size()), "shutdown: " + std::to_string(stopped) + " of " +
+          std::to_string(queued.size()) + " queued requests failed with 'inference server stopped'");
+}
+
+int main() {
+    check_many_producers(8, 300, 16);
+    check_many_producers(4, 200, 1);
+    check_many_producers(16, 100, 64);
+    check_shutdown_fails_queued_requests();
+    std::printf("%s: inference server checked, %d failures\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+"""
+Self-play data generation.
+
+Plays many games at once with the native search (`chessengine.self_play`): a pool of worker threads (one per core
+by default) shares out the concurrent games, each worker stepping its games in turn and batching their leaves, and
+the leaf evaluations of all workers are interleaved into shared network batches by a `chessengine.InferenceServer`. Finished games are written by the search threads to a binary shard
+(`chessengine.ShardWriter`), one compact record per position played: the packed board, the root visit counts and
+the game outcome. `chessengine.ReplayBuffer(out_dir, window)` samples training batches from the most recent positions
+of all shards in a directory. With `--ring`, games are instead sent to a trainer process through a shared-memory
+`chessengine.RecordRing`, and with `--weight-slot` the network is loaded from the newest weights the trainer has
+published to a `chessengine.WeightSlot` (reloaded between `--rounds`, and quantized again after every reload with
+`--int8`). With `--format npz`, games are instead written to `.npz` files holding, for every position played:
+- `states`: the (9, 8, 8) network input
+- `policies`: the root visit distribution over the 4096 policy entries
+- `values`: the game outcome from the perspective of the side to move
+
+Usage:
+    python selfplay.py --games 256 --concurrent 64 --simulations 200 --out selfplay_data
+    python selfplay.py --uniform ...            # No network (uniform priors), e.g. to measure the search alone
+    python selfplay.py --native weights.bin --int8 selfplay_data ...
+                                                # Native INT8 network (ChessCNN.export_native), calibrated on recorded states
+    python selfplay.py --weight-slot chess-weights --ring chess-ring-0 --rounds 100 ...
+                                                # Worker process of a training run (see README)
+"""
+import argparse
+import os
+import threading
+import time
+
+import numpy as np
+
+import chessengine
+
+
+class GameWriter:
+    """Collects finished games and writes them out to `.npz` files `games_per_file` games at a time."""
+    def __init__(self, out_dir, games_per_file):
+        self.out_dir = out_dir
+        self.games_per_file = games_per_file
+        self.pending = []
+        self.files = 0
+        self.lock = threading.Lock()
+
+    def __call__(self, record):
+        with self.lock:
+            self.pending.append(record)
+            if len(self.pending) >= self.games_per_file:
+                self.flush()
+
+    def flush(self):
+        if not self.pending:
+            return
+        path = os.path.join(self.out_dir, f"games_{self.files:05d}.npz")
+        np.savez(path,
+                 states=np.concatenate([r["states"] for r in self.pending]),
+                 policies=np.concatenate([r["policies"] for r in self.pending]),
+                 values=np.concatenate([r["values"] for r in self.pending]))
+        self.files += 1
+        self.pending = []
+
+
+def calibration_states(path, count, seed):
+    """Recorded network inputs to calibrate INT8 inference on: a sample of a shard directory or an .npz file."""
+    if os.path.isdir(path):
+        return chessengine.ReplayBuffer(path).sample(count, seed=seed)[0]
+    states = np.load(path)["states"].astype(np.float32)
+    return states[np.random.default_rng(seed).permutation(len(states))[:count]]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate training games by self-play")
+    parser.add_argument("--games", type=int, default=256, help="Number of games to play")
+    parser.add_argument("--concurrent", type=int, default=64, help="Games played at the same time")
+    parser.add_argument("--threads", type=int, default=0, help="Worker threads sharing the games (0: one per core)")
+    parser.add_argument("--simulations", type=int, default=200, help="Search simulations per move")
+    parser.add_argument("--batch-size", type=int, default=8, help="Leaves per network request within one search")
+    parser.add_argument("--max-wait-ms", type=float, default=2.0, help="Longest a request waits for its network batch to fill")
+    parser.add_argument("--puct", type=float, default=1.0, help="PUCT exploration constant")
+    parser.add_argument("--temperature-plies", type=int, default=30, help="Plies during which moves are sampled by visit count")
+    parser.add_argument("--max-plies", type=int, default=512, help="Games longer than this are scored as draws")
+    parser.add_argument("--early-stop", action="store_true",
+                        help="After the temperature plies, end each search once its most visited move is decided")
+    parser.add_argument("--cache-size", type=int, default=1 << 20,
+                        help="Positions kept in the shared evaluation cache (0 to disable)")
+    parser.add_argument("--cache-policy", choices=["always", "lru", "lfu"], default="lru",
+                        help="Which cached evaluation a full cache bucket evicts")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--weights", default=None, help="ChessCNN weights to load")
+    parser.add_argument("--native", default=None,
+                        help="Evaluate natively with weights written by ChessCNN.export_native (no Python in the search)")
+    parser.add_argument("--int8", default=None, metavar="DATA",
+                        help="With --native or --weight-slot: quantize to INT8 (every reload too), calibrating on recorded states "
+                             "(a shard directory or .npz file)")
+    parser.add_argument("--uniform", action="store_true", help="Use uniform priors and zero values instead of the network")
+    parser.add_argument("--out", default="selfplay_data", help="Output directory")
+    parser.add_argument("--format", choices=["shard", "npz"], default="shard",
+                        help="Write one binary shard per run, or .npz files of --games-per-file games")
+    parser.add_argument("--generation", type=int, default=0, help="Network generation stored with each shard record")
+    parser.add_argument("--games-per-file", type=int, default=64)
+    parser.add_argument("--ring", default=None, metavar="NAME",
+                        help="Send games to a trainer through this shared-memory ring instead of writing files")
+    parser.add_argument("--weight-slot", default=None, metavar="NAME",
+                        help="Load the native network from this shared-memory slot (waits for the first publish) and "
+                             "store its generation with each record")
+    parser.add_argument("--rounds", type=int, default=1,
+                        help="Play --games this many times, reloading newer weights from --weight-slot between rounds")
+    args = parser.parse_args()
+
+    if args.weight_slot:
+        slot = chessengine.WeightSlot(args.weight_slot)
+        loaded = slot.network()
+        while loaded is None:   # Nothing published yet, or a publish cut short until the trainer publishes again
+            time.sleep(0.1)
+            loaded = slot.network()
+    server = None
+    generation = args.generation
+    # The same calibration sample quantizes every native network, including the ones reloaded between rounds
+    calibration = calibration_states(args.int8, 1024, args.seed) if args.int8 and (args.native or args.weight_slot) else None
+    if args.weight_slot:
+        generation, network = loaded
+        if calibration is not None:
+            network.quantize(calibration)
+        server = chessengine.InferenceServer(network, max_batch_size=args.concurrent * args.batch_size,
+                                             max_wait_ms=args.max_wait_ms)
+    elif args.native:
+        network = chessengine.Network(args.native)
+        if calibration is not None:
+            network.quantize(calibration)
+        server = chessengine.InferenceServer(network, max_batch_size=args.concurrent * args.batch_size,
+                                             max_wait_ms=args.max_wait_ms)
+    elif not args.uniform:
+        from Model import ChessCNN
+        model = ChessCNN()
+        if args.weights:
+            model.load(args.weights)
+        model.eval()
+        server = chessengine.InferenceServer(model.evaluate_batch,
+                                             max_batch_size=args.concurrent * args.batch_size,
+                                             max_wait_ms=args.max_wait_ms)
+
+    cache = chessengine.EvalCache(args.cache_size, args.cache_policy) if args.cache_size > 0 else None
+    writer = shard = ring = None
+    if args.ring:
+        ring = chessengine.RecordRing(args.ring)
+    elif args.format == "npz":
+        os.makedirs(args.out, exist_ok=True)
+        writer = GameWriter(args.out, args.games_per_file)
+    else:
+        os.makedirs(args.out, exist_ok=True)
+        # Shards are read back in name order, so name them by creation time
+        shard = chessengine.ShardWriter(os.path.join(args.out, f"{time.strftime('%Y%m%d-%H%M%S')}-{os.getpid()}.shard"))
+    start = time.time()
+    for round_index in range(args.rounds):
+        if args.weight_slot and round_index > 0:
+            newer = slot.network(generation)
+            if newer is not None:
+                generation, network = newer
+                if calibration is not None:
+                    network.quantize(calibration)
+                server = chessengine.InferenceServer(network, max_batch_size=args.concurrent * args.batch_size,
+                                                     max_wait_ms=args.max_wait_ms)
+                if cache is not None:
+                    cache.clear()
+                print(f"Loaded weights generation {generation}")
+        stats = chessengine.self_play(server, games=args.games, concurrent_games=args.concurrent, threads=args.threads,
+                                      simulations=args.simulations, batch_size=args.batch_size, c_puct=args.puct,
+                                      temperature_plies=args.temperature_plies, max_plies=args.max_plies,
+                                      seed=args.seed + round_index, early_stop=args.early_stop, cache=cache, on_game=writer,
+                                      writer=ring if ring is not None else shard, generation=generation)
+    if writer is not None:
+        writer.flush()
+
+    if args.rounds > 1:
+        print(f"Played {args.rounds} rounds in {time.time() - start:.1f} s; the last one:")
+    print(f"Played {stats['games']} games ({stats['positions']} positions) in {stats['seconds']:.1f} s")
+    print(f"White wins: {stats['white_wins']}, draws: {stats['draws']}, black wins: {stats['black_wins']}")
+    print(f"Games/hour: {stats['games_per_hour']:.0f}, positions/second: {stats['positions_per_second']:.1f}")
+    if args.early_stop:
+        total = stats["simulations"] + stats["simulations_saved"]
+        print(f"Simulations run: {stats['simulations']}, saved by early stopping: {stats['simulations_saved']} "
+              f"({stats['simulations_saved'] / max(total, 1):.0%})")
+    if server is not None:
+        inference = server.stats()
+        print(f"Network batches: {inference['batches']}, mean batch fill: {inference['batch_fill']:.0%}, "
+              f"mean latency: {inference['mean_latency_us'] / 1000:.2f} ms")
+    if cache is not None:
+        cached = cache.stats()
+        print(f"Evaluation cache: {cached['hits']} hits out of {cached['lookups']} lookups ({cached['hit_rate']:.0%}), "
+              f"{cached['entries']} positions cached")
+    if ring is not None:
+        ring_stats = ring.stats()
+        print(f"Sent {ring_stats['messages_pushed']} games ({ring_stats['bytes_pushed'] / 1e6:.1f} MB) to {ring.name}, "
+              f"{ring_stats['full_waits']} waits for the trainer")
+    elif shard is not None:
+        print(f"Wrote {shard.records} positions to {shard.path}")
+    else:
+        print(f"Wrote {writer.files} file(s) to {args.out}")
+
+
+if __name__ == "__main__":
+    main()
@@ -2,7 +2,7 @@ from setuptools import setup, Extension
 import pybind11
 import os
 
-cpp_args = ['-std=c++17', '-O3']
+cpp_args = ['-std=c++17', '-O3', '-pthread']
 
 ext_modules = [
     Extension(
@@ -10,6 +10,17 @@ ext_modules = [
         sources=[
             'bindings.cpp',
             'game_logic/ChessBoard.cpp',
+            'game_logic/Policy.cpp',
+            'game_logic/MCTS.cpp',
+            'game_logic/InferenceServer.cpp',
+            'game_logic/EvalCache.cpp',
+            'game_logic/Playout.cpp',
+            'game_logic/Network.cpp',
+            'game_logic/SelfPlay.cpp',
+            'game_logic/Replay.cpp',
+            'game_logic/DataLoader.cpp',
+            'game_logic/Pgn.cpp',
+            'game_logic/SharedMemory.cpp',
         ],
         include_dirs=[
             pybind11.get_include(),
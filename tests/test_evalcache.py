@@ -0,0 +1,168 @@
+"""Evaluation cache: hits and misses, replacement in a full bucket, and the cached evaluator in front of a search."""
+import random
+import unittest
+
+import numpy as np
+
+import chessengine
+
+SHARD_SHIFT = 58    # The top 6 bits of a position's hash pick its shard; a cache of capacity 1 has one bucket per shard
+
+
+def same_bucket(count, seed=0):
+    """count positions whose hashes share a shard, and so the single bucket of EvalCache(1)."""
+    rng = random.Random(seed)
+    groups, board = {}, chessengine.ChessBoard()
+    while True:
+        moves = board.legal_moves()
+        if board.is_game_over() or not moves:
+            board = chessengine.ChessBoard()
+            continue
+        board = board.step(rng.choice(moves))
+        group = groups.setdefault(board.hash() >> SHARD_SHIFT, {})
+        group[board.hash()] = board
+        if len(group) == count:
+            return list(group.values())
+
+
+def uniform(board):
+    return [1.0 / len(board.legal_moves())] * len(board.legal_moves())
+
+
+def fingerprint(states):
+    """A value per state that depends on all of it, so a value cached under the wrong position is caught."""
+    weights = np.sin(np.arange(9 * 64, dtype=np.float64))
+    return np.tanh(states.reshape(len(states), -1) @ weights).astype(np.float32)
+
+
+class EvalCacheTest(unittest.TestCase):
+    def test_hit_miss_and_stats(self):
+        cache = chessengine.EvalCache(1000)
+        self.assertEqual(cache.capacity, 1024)      # Whole buckets of 4 in each of the 64 shards
+        board, other = same_bucket(2)
+        self.assertIsNone(cache.lookup(board))
+        priors = [0.5] + [0.5 / (len(board.legal_moves()) - 1)] * (len(board.legal_moves()) - 1)
+        cache.insert(board, 0.25, priors)
+        value, cached = cache.lookup(board)
+        self.assertEqual(value, 0.25)
+        self.assertEqual(len(cached), len(priors))
+        for expected, actual in zip(priors, cached):
+            self.assertAlmostEqual(actual, expected, delta=1e-3 * expected)     # Stored in half precision
+        self.assertIsNone(cache.lookup(other))
+        with self.assertRaisesRegex(ValueError, "one entry per legal move"):
+            cache.insert(board, 0.0, priors[:-1])
+
+        stats = cache.stats()
+        self.assertEqual((stats["lookups"], stats["hits"], stats["inserts"], stats["evictions"], stats["entries"]),
+                         (3, 1, 1, 0, 1))
+        self.assertAlmostEqual(stats["hit_rate"], 1 / 3)
+        cache.reset_stats()
+        stats = cache.stats()
+        self.assertEqual((stats["lookups"], stats["hits"], stats["inserts"], stats["hit_rate"]), (0, 0, 0, 0.0))
+        self.assertEqual(stats["entries"], 1)       # Counters only; the entries stay
+
+        # Inserting a cached position again refreshes it in place
+        cache.insert(board, -0.5, uniform(board))
+        self.assertEqual(cache.lookup(board)[0], -0.5)
+        self.assertEqual((cache.stats()["entries"], cache.stats()["evictions"]), (1, 0))
+
+    def test_lru_evicts_the_least_recently_used(self):
+        cache = chessengine.EvalCache(1, "lru")
+        a, b, c, d, e = same_bucket(5)
+        for value, board in enumerate((a, b, c, d)):
+            cache.insert(board, value, uniform(board))
+        cache.lookup(a)                             # b is now the least recently used
+        cache.insert(e, 4, uniform(e))
+        self.assertIsNone(cache.lookup(b))
+        self.assertEqual([cache.lookup(board)[0] for board in (a, c, d, e)], [0, 2, 3, 4])
+        self.assertEqual((cache.stats()["evictions"], cache.stats()["entries"]), (1, 4))
+
+    def test_lfu_evicts_the_least_used(self):
+        cache = chessengine.EvalCache(1, "lfu")
+        a, b, c, d, e, f = same_bucket(6)
+        for board in (a, b, c, d):
+            cache.insert(board, 0.0, uniform(board))
+        for board in (a, a, b, d):
+            cache.lookup(board)
+        cache.insert(e, 0.0, uniform(e))            # c has no hits
+        self.assertIsNone(cache.lookup(c))
+        cache.insert(f, 0.0, uniform(f))            # A new entry starts without hits, so e goes next
+        self.assertIsNone(cache.lookup(e))
+        for board in (a, b, d, f):
+            self.assertIsNotNone(cache.lookup(board))
+        cache.lookup(f)
+        # Equal hits: b, d and f have two each, and b was used least recently
+        cache.insert(c, 0.0, uniform(c))
+        self.assertIsNone(cache.lookup(b))
+
+    def test_always_replaces_the_mapped_slot(self):
+        cache = chessengine.EvalCache(1, "always")
+        boards = same_bucket(12)
+        slots = {}
+        for board in boards:
+            slots.setdefault((board.hash() >> 32) % 4, []).append(board)
+        first, second = next(group for group in slots.values() if len(group) >= 2)[:2]
+        cache.insert(first, 1.0, uniform(first))
+        cache.insert(second, 2.0, uniform(second))  # Same slot: replaced even though the bucket has room
+        self.assertIsNone(cache.lookup(first))
+        self.assertEqual(cache.lookup(second)[0], 2.0)
+        self.assertEqual(cache.stats()["evictions"], 1)
+
+    def test_clear(self):
+        cache = chessengine.EvalCache(1, "lfu")
+        boards = same_bucket(3)
+        for board in boards:
+            cache.insert(board, 1.0, uniform(board))
+            cache.lookup(board)
+        cache.clear()
+        self.assertEqual(cache.stats()["entries"], 0)
+        self.assertTrue(all(cache.lookup(board) is None for board in boards))
+        self.assertEqual(cache.capacity, 256)
+        # The freed slots are filled again without evicting anything
+        for board in boards:
+            cache.insert(board, 2.0, uniform(board))
+        self.assertEqual([cache.lookup(board)[0] for board in boards], [2.0] * 3)
+        self.assertEqual((cache.stats()["entries"], cache.stats()["evictions"]), (3, 0))
+
+
+class CachedEvaluatorTest(unittest.TestCase):
+    def recorder(self):
+        calls = []
+        def evaluate(states):
+            calls.append(np.array(states))
+            return fingerprint(states), np.zeros((len(states), 4096), dtype=np.float32)
+        return evaluate, calls
+
+    def test_only_misses_are_forwarded_in_order(self):
+        cache = chessengine.EvalCache(1 << 16)
+        root = chessengine.ChessBoard()
+        children = [root.step(m) for m in root.legal_moves()]
+        # Every other root move is cached with its correct value, so batches mix hits and misses
+        cached = children[::2]
+        for board in cached:
+            cache.insert(board, float(fingerprint(np.asarray(board.get_state_tensor(), dtype=np.float32)[None])[0]),
+                         uniform(board))
+        cached_states = {np.asarray(board.get_state_tensor(), dtype=np.float32).tobytes() for board in cached}
+
+        evaluate, calls = self.recorder()
+        tree = chessengine.MCTS(root, evaluate, cache=cache)
+        tree.search(300, batch_size=8)
+        forwarded = np.concatenate(calls)
+        self.assertFalse(any(state.tobytes() in cached_states for state in forwarded))
+        self.assertGreaterEqual(cache.stats()["hits"], len(cached))
+
+        # Each evaluated position was cached with its own value, not a neighbour's in the batch
+        for board in [root] + children:
+            entry = cache.lookup(board)
+            self.assertIsNotNone(entry)
+            expected = fingerprint(np.asarray(board.get_state_tensor(), dtype=np.float32)[None])[0]
+            self.assertAlmostEqual(entry[0], float(expected), places=6)
+
+        # The same search again is answered entirely from the cache
+        evaluate, calls = self.recorder()
+        chessengine.MCTS(root, evaluate, cache=cache).search(300, batch_size=8)
+        self.assertEqual(calls, [])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,262 @@
+"""Transpositions in both searches (shared nodes and draws by repetition), search limits and the Gumbel root search."""
+import unittest
+
+import numpy as np
+
+import chessengine
+from MCTS import MCTS_Deep
+
+
+class GraphGame:
+    """
+    Toy game on a fixed graph of named positions; turns alternate. Two move orders reach P:
+    R -a-> A -x-> X -p-> P and R -b-> B -c-> C -p-> P. From P, move x leads to X, which only the first order has seen.
+    """
+    EDGES = {"R": {"a": "A", "b": "B"}, "A": {"x": "X"}, "B": {"c": "C"}, "C": {"p": "P"},
+             "X": {"p": "P", "w": "W"}, "P": {"x": "X", "l": "L"}, "W": {}, "L": {}}
+    OUTCOMES = {"W": 1, "L": -1}    # From White's (player 1) perspective
+
+    def __init__(self, name="R", player=1):
+        self.name = name
+        self.player = player
+
+    def copy(self):
+        return type(self)(self.name, self.player)
+
+    def step(self, action):
+        return type(self)(self.EDGES[self.name][action], -self.player)
+
+    def is_terminal(self):
+        return self.OUTCOMES.get(self.name)
+
+    def key(self):
+        return (self.name, self.player)
+
+
+class GraphModel:
+    """Uniform priors; position X is worth 0.5 to its side to move, everything else 0."""
+    def forward(self, state):
+        actions = list(type(state).EDGES[state.name])
+        return (0.5 if state.name == "X" else 0.0), {action: 1.0 / len(actions) for action in actions}
+
+
+class DeepTranspositionTest(unittest.TestCase):
+    def expand(self, mcts, actions):
+        """Expands the nodes along `actions` from the root; returns the path and the last node."""
+        path, node = [], mcts.root
+        for action in actions:
+            path.append((node, action))
+            node = mcts._expand(path)
+        return path, node
+
+    def test_repetition_on_one_path_shares_the_node(self):
+        mcts = MCTS_Deep(GraphGame(), GraphModel(), transpositions=True)
+        repeating, x = self.expand(mcts, ["a", "x", "p", "x"])
+        parent = repeating[-1][0]
+        self.assertTrue(mcts._repeats(repeating, x))
+        self.assertIs(parent.children["x"], repeating[1][0].children["x"])
+        self.assertFalse(x.terminal)
+
+        # The other move order reaches the same parent, and x is an ordinary move from there
+        other, node = self.expand(mcts, ["b", "c", "p", "x"])
+        self.assertIs(other[-1][0], parent)
+        self.assertIs(node, x)
+        self.assertFalse(mcts._repeats(other, node))
+        mcts._backup(other, 0.0 if mcts._repeats(other, node) else node.value)
+        self.assertEqual(parent.Q[parent.index["x"]], 0.5)
+
+    def test_search_on_a_cyclic_graph(self):
+        mcts = MCTS_Deep(GraphGame(), GraphModel(), transpositions=True)
+        mcts.search(num_simulations=200)
+        self.assertEqual(mcts.root.N_visits, 200)
+        self.assertEqual(mcts.num_nodes, len(mcts._subtree(mcts.root)))
+
+
+class ArmsGame(GraphGame):
+    """One move from the root to each of eight terminal positions, worth VALUES to White (the root player)."""
+    VALUES = [-1.0, -0.5, 0.0, 1.0, -0.25, 0.25, -0.75, 0.5]
+    ARMS = [f"a{i}" for i in range(len(VALUES))]
+    EDGES = {"R": {arm: arm.upper() for arm in ARMS}, **{arm.upper(): {} for arm in ARMS}}
+    OUTCOMES = {arm.upper(): value for arm, value in zip(ARMS, VALUES)}
+    BEST = "a3"
+
+
+class GumbelSearchTest(unittest.TestCase):
+    def test_halving_keeps_the_best_arm(self):
+        for seed in range(5):
+            mcts = MCTS_Deep(ArmsGame(), GraphModel(), seed=seed)
+            mcts.search(num_simulations=96, root_policy="gumbel", gumbel_k=8)
+            self.assertEqual(mcts.last_search["action"], ArmsGame.BEST)
+            self.assertEqual(mcts.last_search["simulations"], 96)
+            self.assertEqual(mcts.root.N.sum(), 96)
+            # Three phases of 96 // (3 * 8) = 4 simulations per arm: 8 arms, then 4, then the last 2 share the rest
+            counts = sorted(mcts.root.visit_counts().values())
+            self.assertEqual(counts, [4] * 4 + [12] * 2 + [28] * 2)
+            self.assertEqual(mcts.root.visit_counts()[ArmsGame.BEST], 28)
+
+    def test_budget_is_respected(self):
+        for simulations, k in ((1, 8), (7, 8), (50, 4), (33, 2)):
+            mcts = MCTS_Deep(ArmsGame(), GraphModel(), seed=0)
+            mcts.search(num_simulations=simulations, root_policy="gumbel", gumbel_k=k)
+            self.assertEqual(mcts.last_search["simulations"], simulations)
+            self.assertEqual(mcts.root.N_visits, simulations)
+            self.assertLessEqual(np.count_nonzero(mcts.root.N), k)
+
+    def test_single_candidate_gets_the_budget(self):
+        # gumbel_k=1: one arm is drawn and searched, rather than returned with the raw prior
+        mcts = MCTS_Deep(ArmsGame(), GraphModel(), seed=0)
+        mcts.search(num_simulations=20, root_policy="gumbel", gumbel_k=1)
+        self.assertEqual(mcts.last_search["simulations"], 20)
+        self.assertEqual(np.count_nonzero(mcts.root.N), 1)
+        self.assertEqual(mcts.root.visit_counts()[mcts.last_search["action"]], 20)
+
+        # One legal move: A's only move leads to X, worth 0.5 to White, so A (Black to move) is worth about -0.5
+        mcts = MCTS_Deep(GraphGame("A", -1), GraphModel(), seed=0)
+        value, counts = mcts.search(num_simulations=20, root_policy="gumbel")
+        self.assertEqual((mcts.last_search["simulations"], counts), (20, {"x": 20}))
+        self.assertEqual(mcts.last_search["action"], "x")
+        self.assertLess(value, -0.4)
+
+    def test_improved_policy_favours_the_higher_q(self):
+        mcts = MCTS_Deep(ArmsGame(), GraphModel(), seed=1)
+        mcts.search(num_simulations=64, root_policy="gumbel", gumbel_k=8)
+        policy = mcts.last_search["policy"]
+        self.assertEqual(set(policy), set(ArmsGame.ARMS))
+        self.assertAlmostEqual(sum(policy.values()), 1.0)
+        # Uniform priors, and every arm visited: the policy is ordered by the arms' values
+        ranked = sorted(ArmsGame.ARMS, key=policy.get)
+        self.assertEqual(ranked, sorted(ArmsGame.ARMS, key=lambda arm: ArmsGame.OUTCOMES[arm.upper()]))
+        self.assertEqual(mcts.improved_policy(), policy)
+
+    def test_completed_q(self):
+        mcts = MCTS_Deep(ArmsGame(), GraphModel())
+        # Before any visit, every action gets the root's prior value
+        np.testing.assert_array_equal(mcts._completed_q(), np.zeros(8))
+        for _ in range(3):
+            mcts._simulate(1.0, "a3")
+        mcts._simulate(1.0, "a0")
+        q = mcts._completed_q()
+        # Visited actions keep their Q from the root player's side; the others get the prior value mixed with
+        # the prior-weighted mean of the visited Qs: (0 + 4 / (2/8) * (1/8 * 1 + 1/8 * -1)) / (1 + 4) = 0
+        self.assertEqual((q[3], q[0]), (1.0, -1.0))
+        np.testing.assert_allclose(q[[1, 2, 4, 5, 6, 7]], 0.0)
+        mcts._simulate(1.0, "a5")
+        # (0 + 5 / (3/8) * (1/8) * (1 - 1 + 0.25)) / 6 = 0.1389
+        np.testing.assert_allclose(mcts._completed_q()[[1, 2, 4, 6, 7]], 5 / 3 * 0.25 / 6)
+
+
+def square(name):
+    """(rank, file) of a square such as "g1"; rank 0 is White's home rank."""
+    return int(name[1]) - 1, ord(name[0]) - ord("a")
+
+
+def move(text):
+    """Move from "g1f3"-style text."""
+    (from_x, from_y), (to_x, to_y) = square(text[:2]), square(text[2:])
+    return chessengine.Move(from_x, from_y, to_x, to_y)
+
+
+def board_after(moves):
+    board = chessengine.ChessBoard()
+    for text in moves:
+        board = board.step(move(text))
+    return board
+
+
+class ScriptedEvaluator:
+    """Zero values and priors concentrated on scripted moves ({moves played: {move: weight}}), uniform elsewhere."""
+    def __init__(self, script):
+        self.script = [(np.asarray(board_after(line).get_state_tensor(), dtype=np.float32),
+                        {chessengine.move_to_index(move(text)): weight for text, weight in choices.items()})
+                       for line, choices in script.items()]
+
+    def __call__(self, states):
+        logits = np.zeros((len(states), 4096), dtype=np.float32)
+        for i, state in enumerate(states):
+            for tensor, choices in self.script:
+                if np.array_equal(state.reshape(-1), tensor):
+                    for index, weight in choices.items():
+                        logits[i, index] = 12.0 + np.log(weight)
+        return np.zeros(len(states), dtype=np.float32), logits
+
+
+class NativeTranspositionTest(unittest.TestCase):
+    # Knight moves only. X (Nf3 Nc6) is on the first move order to P but not on the second:
+    #   Nf3 Nc6 (X) Ng1 Nb4 Nf3 (P), then Nc6 repeats X
+    #   Nf3 Na6 Ng1 Nb4 Nf3 (P), then Nc6 reaches X for the first time on this path
+    # The first order is searched first, so its repetition is what first meets P's Nc6 edge.
+    REPEATING = ["g1f3", "b8c6", "f3g1", "c6b4", "g1f3"]
+    OTHER = ["g1f3", "b8a6", "f3g1", "a6b4", "g1f3"]
+
+    def scripted_search(self, simulations):
+        script = {(): {"g1f3": 1.0},
+                  ("g1f3",): {"b8c6": 0.9, "b8a6": 0.1},
+                  ("g1f3", "b8c6"): {"f3g1": 1.0},
+                  ("g1f3", "b8c6", "f3g1"): {"c6b4": 1.0},
+                  ("g1f3", "b8a6"): {"f3g1": 1.0},
+                  ("g1f3", "b8a6", "f3g1"): {"a6b4": 1.0},
+                  ("g1f3", "b8c6", "f3g1", "c6b4"): {"g1f3": 1.0},
+                  tuple(self.REPEATING): {"b4c6": 1.0}}
+        tree = chessengine.MCTS(chessengine.ChessBoard(), ScriptedEvaluator(script))
+        tree.set_transpositions(True)
+        tree.search(simulations)
+        return tree
+
+    def test_both_orders_reach_the_same_position(self):
+        self.assertEqual(board_after(self.REPEATING).hash(), board_after(self.OTHER).hash())
+        self.assertEqual(board_after(self.REPEATING + ["b4c6"]).hash(), board_after(["g1f3", "b8c6"]).hash())
+
+    def test_repetition_on_one_path_shares_the_node(self):
+        tree = self.scripted_search(300)
+        self.assertGreater(tree.transposition_hits(), 0)
+        for text in self.OTHER + ["b4c6"]:
+            self.assertTrue(tree.advance(move(text)))
+        # Reached through the other move order, Nc6 leads to the searched position X, not to a draw
+        counts = tree.root_visit_counts()
+        self.assertTrue(counts)
+        self.assertGreater(counts[(2, 5, 0, 6)], 0)     # X's own scripted move, Ng1
+
+
+class NativeSearchLimitsTest(unittest.TestCase):
+    def test_early_stop_is_opt_in(self):
+        # One move takes nearly all the prior, so an early-stopping search would be decided long before its budget
+        def tree():
+            return chessengine.MCTS(chessengine.ChessBoard(), ScriptedEvaluator({(): {"g1f3": 1.0}}))
+        stats = tree().search_limited(400)
+        self.assertEqual(stats["reason"], "simulations")
+        self.assertEqual(stats["simulations"], 400)
+        stats = tree().search_limited(400, early_stop=True)
+        self.assertEqual(stats["reason"], "decided")
+        self.assertEqual(stats["simulations"] + stats["saved"], 400)
+        self.assertGreater(stats["saved"], 0)
+
+    def test_memory_budget_prunes_the_tree(self):
+        budget = 200000
+        tree = chessengine.MCTS(chessengine.ChessBoard())
+        tree.set_memory_budget(budget)
+        visits = 0
+        for threads in (1, 2, 1):
+            tree.search(4000, batch_size=8, num_threads=threads)
+            visits += 4000
+            # The budget bounds the live tree; the arenas keep the pruned slots and are larger
+            self.assertLessEqual(tree.live_memory(), budget)
+            self.assertGreaterEqual(tree.memory_usage(), tree.live_memory())
+            # Cut edges keep their own statistics, so every simulation is still counted below the root
+            counts = tree.root_visit_counts()
+            self.assertEqual(len(counts), 20)
+            self.assertEqual(tree.root_visits(), visits)
+            self.assertEqual(sum(counts.values()), visits - 1)
+        self.assertGreater(tree.pruned_nodes(), 0)
+
+        # The pruned tree can still be re-rooted and searched, with pruned slots reused
+        best = tree.best_move()
+        kept = tree.root_visit_counts()[(best.start.x, best.start.y, best.to.x, best.to.y)]
+        self.assertTrue(tree.advance(best))
+        tree.search(2000, batch_size=8)
+        self.assertLessEqual(tree.live_memory(), budget)
+        self.assertEqual(sum(tree.root_visit_counts().values()), tree.root_visits() - 1)
+        self.assertGreaterEqual(tree.root_visits(), 2000 + kept)
+
+
+if __name__ == "__main__":
+    unittest.main()
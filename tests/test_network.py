@@ -0,0 +1,216 @@
+"""Native network (chessengine.Network) against the PyTorch model and a NumPy reference."""
+import os
+import tempfile
+import unittest
+
+import numpy as np
+
+import chessengine
+
+try:
+    import torch
+    from Game import ChessGame
+    from Model import ChessCNN, _fold_batch_norm
+except ImportError:
+    torch = None
+
+NATIVE_MAGIC = 0x4E4E4343
+
+
+def random_boards(count, seed):
+    """Positions from random games, restarting whenever a game ends."""
+    rng = np.random.default_rng(seed)
+    boards, board = [], chessengine.ChessBoard()
+    while len(boards) < count:
+        moves = board.legal_moves()
+        if board.is_game_over() or not moves:
+            board = chessengine.ChessBoard()
+            continue
+        board = board.step(moves[rng.integers(len(moves))])
+        boards.append(board)
+    return boards
+
+
+def states_of(boards):
+    return np.stack([np.asarray(board.get_state_tensor(), dtype=np.float32).reshape(9, 8, 8) for board in boards])
+
+
+def legal_softmax(board, logits):
+    """The dense path's priors: softmax of one position's full logits over its legal moves, in legal_moves() order."""
+    legal = logits[[chessengine.move_to_index(move) for move in board.legal_moves()]].astype(np.float64)
+    exp = np.exp(legal - legal.max())
+    return exp / exp.sum()
+
+
+def random_layers(rng, input_channels=9, channels=8, hidden=16):
+    """Folded ChessCNN tensors in PyTorch layouts, in the order of a version 1 file, He-initialized."""
+    def layer(outputs, inputs, *kernel):
+        fan_in = inputs * int(np.prod(kernel, dtype=int))
+        weight = rng.normal(0.0, np.sqrt(2.0 / fan_in), size=(outputs, inputs, *kernel)).astype(np.float32)
+        return weight, rng.normal(0.0, 0.1, size=outputs).astype(np.float32)
+    layers = [layer(channels, inputs, 3, 3) for inputs in (input_channels, channels, channels)]
+    layers.append(layer(4, channels))           # Policy head convolution
+    layers.append(layer(2, channels))           # Value head convolution
+    layers.append(layer(4096, 4 * 64))          # policy_fc
+    layers.append(layer(hidden, 2 * 64))        # value_fc1
+    layers.append(layer(1, hidden))             # value_fc2
+    return layers
+
+
+def write_version1(path, layers):
+    """The original export format: a 5-word header, then the tensors packed in PyTorch layouts."""
+    channels, input_channels = layers[0][0].shape[:2]
+    header = np.array([NATIVE_MAGIC, 1, input_channels, channels, layers[6][0].shape[0]], dtype="<u4")
+    with open(path, "wb") as f:
+        f.write(header.tobytes())
+        for weight, bias in layers:
+            f.write(np.ascontiguousarray(weight, dtype="<f4").tobytes())
+            f.write(np.ascontiguousarray(bias, dtype="<f4").tobytes())
+
+
+def reference_forward(layers, states):
+    """ChessCNN._network_forward on folded tensors, in float64: (values, logits)."""
+    def relu(x):
+        return np.maximum(x, 0.0)
+    x = states.astype(np.float64)
+    batch = len(x)
+    for weight, bias in layers[:3]:
+        padded = np.pad(x, ((0, 0), (0, 0), (1, 1), (1, 1)))
+        out = np.zeros((batch, weight.shape[0], 8, 8)) + bias.reshape(1, -1, 1, 1)
+        for ky in range(3):
+            for kx in range(3):
+                out += np.einsum("bcyx,oc->boyx", padded[:, :, ky:ky + 8, kx:kx + 8], weight[:, :, ky, kx])
+        x = relu(out)
+    policy = relu(np.einsum("bcyx,oc->boyx", x, layers[3][0]) + layers[3][1].reshape(1, -1, 1, 1)).reshape(batch, -1)
+    value = relu(np.einsum("bcyx,oc->boyx", x, layers[4][0]) + layers[4][1].reshape(1, -1, 1, 1)).reshape(batch, -1)
+    logits = policy @ layers[5][0].T + layers[5][1]
+    value = relu(value @ layers[6][0].T + layers[6][1])
+    value = np.tanh(value @ layers[7][0].T + layers[7][1])
+    return value.reshape(-1), logits
+
+
+class NetworkTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.addCleanup(self.directory.cleanup)
+        self.states = states_of(random_boards(24, seed=1))
+
+    def path(self, name):
+        return os.path.join(self.directory.name, name)
+
+    def test_version1_file_matches_reference(self):
+        layers = random_layers(np.random.default_rng(0))
+        write_version1(self.path("v1.bin"), layers)
+        network = chessengine.Network(self.path("v1.bin"))
+        self.assertFalse(network.mapped)
+        self.assertEqual(network.channels, 8)
+
+        values, logits = network.evaluate(self.states)
+        expected_values, expected_logits = reference_forward(layers, self.states)
+        np.testing.assert_allclose(values, expected_values, rtol=1e-4, atol=1e-5)
+        np.testing.assert_allclose(logits, expected_logits, rtol=1e-4, atol=1e-4)
+
+    def test_version1_file_rejects_truncation(self):
+        write_version1(self.path("v1.bin"), random_layers(np.random.default_rng(0)))
+        with open(self.path("v1.bin"), "r+b") as f:
+            f.truncate(os.path.getsize(self.path("v1.bin")) - 4)
+        with self.assertRaisesRegex(RuntimeError, "truncated"):
+            chessengine.Network(self.path("v1.bin"))
+
+    def test_int8_stays_close_to_fp32(self):
+        write_version1(self.path("v1.bin"), random_layers(np.random.default_rng(2), channels=32, hidden=32))
+        network = chessengine.Network(self.path("v1.bin"))
+        held_out = random_boards(128, seed=3)
+        with self.assertRaises(RuntimeError):
+            network.compare_precision(held_out)
+
+        network.quantize(states_of(random_boards(256, seed=2)))
+        self.assertTrue(network.quantized)
+        self.assertEqual(network.precision, "int8")
+        report = network.compare_precision(held_out)
+        self.assertEqual(report["positions"], 128)
+        self.assertLess(report["value_mae"], 0.02)
+        self.assertLess(report["value_max_error"], 0.15)
+        self.assertLess(report["policy_kl"], 0.005)
+        self.assertGreaterEqual(report["top1_agreement"], 0.9)
+
+        network.precision = "fp32"
+        fp32_values, _ = network.evaluate(self.states)
+        network.precision = "int8"
+        int8_values, _ = network.evaluate(self.states)
+        np.testing.assert_allclose(int8_values, fp32_values, atol=0.15)
+
+    def test_legal_move_priors_match_dense_path(self):
+        # evaluate_boards (evaluate_moves) computes only the legal moves' logits; it must agree with the full
+        # logits of evaluate followed by a softmax over the legal moves, at both precisions
+        write_version1(self.path("v1.bin"), random_layers(np.random.default_rng(4), channels=16, hidden=32))
+        network = chessengine.Network(self.path("v1.bin"))
+        boards = random_boards(40, seed=5)
+        states = states_of(boards)
+        for precision in ("fp32", "int8"):
+            if precision == "int8":
+                network.quantize(states_of(random_boards(128, seed=6)))
+            values, logits = network.evaluate(states)
+            results = network.evaluate_boards(boards)
+            self.assertEqual(len(results), len(boards))
+            for board, (value, priors), dense_value, row in zip(boards, results, values, logits):
+                self.assertAlmostEqual(value, dense_value, places=6, msg=precision)
+                self.assertEqual(len(priors), len(board.legal_moves()))
+                np.testing.assert_allclose(priors, legal_softmax(board, row), rtol=1e-4, atol=1e-6, err_msg=precision)
+
+    @unittest.skipUnless(torch, "needs PyTorch")
+    def test_legal_forward_matches_dense_forward(self):
+        # ChessCNN.forward on a chess position gathers the legal moves' rows of policy_fc; the dense path is
+        # _network_forward plus the masked softmax of _create_policy_dict
+        torch.manual_seed(1)
+        model = ChessCNN(num_channels=16).eval()
+        games = [ChessGame(board) for board in random_boards(12, seed=7)]
+        batch = model.forward_batch(games)
+        for game, (batch_value, batch_policy) in zip(games, batch):
+            value, policy = model.forward(game)
+            with torch.no_grad():
+                dense_value, logits = model._network_forward(model._prepare_tensor(game.get_feature_plane()))
+            dense_policy = model._create_policy_dict(logits, game.get_policy_mask())
+            self.assertAlmostEqual(value, dense_value.item(), places=5)
+            self.assertAlmostEqual(batch_value, dense_value.item(), places=5)
+            self.assertEqual(set(policy), {(m.start.x, m.start.y, m.to.x, m.to.y) for m in game.board.legal_moves()})
+            for move, prior in policy.items():
+                self.assertAlmostEqual(prior, dense_policy.get(move, 0.0), places=5)
+                self.assertAlmostEqual(batch_policy[move], prior, places=5)
+
+    @unittest.skipUnless(torch, "needs PyTorch")
+    def test_export_matches_torch(self):
+        torch.manual_seed(0)
+        model = ChessCNN(num_channels=16)
+        # Batch norm statistics away from the identity, so folding them is exercised
+        for module in model.modules():
+            if isinstance(module, torch.nn.BatchNorm2d):
+                module.running_mean.uniform_(-0.5, 0.5)
+                module.running_var.uniform_(0.5, 2.0)
+                module.weight.data.uniform_(0.5, 1.5)
+                module.bias.data.uniform_(-0.2, 0.2)
+        model.eval()
+        model.export_native(self.path("v2.bin"))
+        network = chessengine.Network(self.path("v2.bin"))
+        self.assertTrue(network.mapped)
+
+        values, logits = network.evaluate(self.states)
+        with torch.no_grad():
+            expected_values, expected_logits = model._network_forward(torch.from_numpy(self.states))
+        np.testing.assert_allclose(values, expected_values.view(-1).numpy(), rtol=1e-4, atol=1e-5)
+        np.testing.assert_allclose(logits, expected_logits.numpy(), rtol=1e-4, atol=1e-4)
+
+        # The same weights in the version 1 layout are converted to exactly the same network
+        params = {name: tensor.numpy() for name, tensor in model.state_dict().items()}
+        layers = [_fold_batch_norm(params, conv, bn) for conv, bn in
+                  [("conv1", "bn1"), ("conv2", "bn2"), ("conv3", "bn3"), ("policy_conv", "policy_bn"), ("value_conv", "value_bn")]]
+        layers = layers[:3] + [(weight.reshape(len(weight), -1), bias) for weight, bias in layers[3:]]
+        layers += [(params[f"{fc}.weight"], params[f"{fc}.bias"]) for fc in ("policy_fc", "value_fc1", "value_fc2")]
+        write_version1(self.path("v1.bin"), layers)
+        converted_values, converted_logits = chessengine.Network(self.path("v1.bin")).evaluate(self.states)
+        np.testing.assert_array_equal(converted_values, values)
+        np.testing.assert_array_equal(converted_logits, logits)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,178 @@
+"""PGN ingestion: SAN resolution and the records written for a PGN file."""
+import glob
+import os
+import tempfile
+import unittest
+
+import numpy as np
+
+import chessengine
+from test_mcts import board_after, move
+from test_network import states_of
+
+# A White pawn one step from promoting on h8, with the rook that guarded g8 moved there
+PROMOTION = ["h2h4", "g7g5", "h4g5", "h7h6", "g5h6", "g8f6", "h6h7", "h8g8"]
+
+PGN = """[Event "Comments and variations"]
+[Result "1-0"]
+
+1. e4 {The king's pawn; (not a variation)} (1. d4 d5 (1... Nf6 2. c4 {nested}) 2. c4) 1... e5
+; a line comment
+2.Nf3 $1 Nc6 3. Bb5!? a6 1-0
+
+[Event "Set up position"]
+[SetUp "1"]
+[FEN "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1"]
+[Result "1-0"]
+
+1. e4 Kd7 1-0
+
+[Event "Underpromotion"]
+[Result "0-1"]
+
+1. h4 g5 2. hxg5 h6 3. gxh6 Nf6 4. h7 Rg8 5. hxg8=N Rxg8 0-1
+
+[Event "Unfinished"]
+[Result "*"]
+
+1. e4 e5 *
+
+[Event "Illegal move"]
+[Result "1/2-1/2"]
+
+1. e4 e5 2. Ke3 1/2-1/2
+"""
+
+SPANISH = ["e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6"]
+
+
+class SanTest(unittest.TestCase):
+    def assertResolves(self, board, san, expected):
+        self.assertEqual(chessengine.move_to_index(board.parse_san(san)), chessengine.move_to_index(move(expected)), san)
+
+    def test_castling(self):
+        board = board_after(["e2e4", "e7e5", "g1f3", "g8f6", "f1c4", "f8c5"])
+        self.assertResolves(board, "O-O", "e1g1")
+        self.assertResolves(board, "0-0+", "e1g1")
+        with self.assertRaisesRegex(ValueError, "illegal castling"):
+            board.parse_san("O-O-O")
+        board = board_after(["d2d4", "d7d5", "b1c3", "b8c6", "c1f4", "c8f5", "d1d2", "d8d7", "e1c1"])
+        self.assertResolves(board, "O-O-O", "e8c8")
+        self.assertResolves(board, "0-0-0", "e8c8")
+
+    def test_disambiguation(self):
+        # Knights on b1 and f3 both reach d2
+        board = board_after(["d2d4", "d7d5", "g1f3", "g8f6"])
+        self.assertResolves(board, "Nbd2", "b1d2")
+        self.assertResolves(board, "Nfd2", "f3d2")
+        self.assertResolves(board, "Nf3d2", "f3d2")
+        with self.assertRaisesRegex(ValueError, "ambiguous"):
+            board.parse_san("Nd2")
+        # Knights on g1 and g5 both reach f3 and h3
+        board = board_after(["b1c3", "a7a6", "c3e4", "a6a5", "e4g5", "a5a4"])
+        self.assertResolves(board, "N1f3", "g1f3")
+        self.assertResolves(board, "N5f3", "g5f3")
+        self.assertResolves(board, "N5h3", "g5h3")
+        with self.assertRaisesRegex(ValueError, "ambiguous"):
+            board.parse_san("Nh3")
+
+    def test_en_passant(self):
+        board = board_after(["e2e4", "a7a6", "e4e5", "d7d5"])
+        self.assertResolves(board, "exd6", "e5d6")
+        self.assertEqual(board.step(board.parse_san("exd6")).hash(),
+                         board_after(["e2e4", "a7a6", "e4e5", "d7d5", "e5d6"]).hash())
+        with self.assertRaisesRegex(ValueError, "illegal move"):
+            board_after(["e2e4", "a7a6", "e4e5", "d7d5", "a2a3", "a6a5"]).parse_san("exd6")
+
+    def test_promotion(self):
+        board = board_after(PROMOTION)
+        for san in ("h8=Q", "h8Q", "h8=Q+", "h8Q#"):
+            self.assertResolves(board, san, "h7h8")
+        self.assertResolves(board, "hxg8=Q", "h7g8")
+        self.assertResolves(board, "hxg8Q", "h7g8")
+        for san in ("h8=N", "h8R", "hxg8=B+"):
+            with self.assertRaisesRegex(ValueError, "underpromotion"):
+                board.parse_san(san)
+        with self.assertRaisesRegex(ValueError, "bad promotion"):
+            board.parse_san("h8=K")
+
+    def test_suffixes_and_errors(self):
+        board = chessengine.ChessBoard()
+        for san in ("e4", "e4+", "e4!", "e4?!", "e4!!", "e4#"):
+            self.assertResolves(board, san, "e2e4")
+        self.assertResolves(board, "Nf3!?", "g1f3")
+        for san, error in (("", "empty move"), ("+", "empty move"), ("Qe4", "illegal move"), ("e5", "illegal move"),
+                           ("Ke2x", "not a SAN move"), ("z9", "not a SAN move")):
+            with self.assertRaisesRegex(ValueError, error):
+                board.parse_san(san)
+
+
+class IngestTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.addCleanup(self.directory.cleanup)
+
+    def ingest(self, text, **kwargs):
+        path = os.path.join(self.directory.name, "games.pgn")
+        with open(path, "w") as f:
+            f.write(text)
+        shards = os.path.join(self.directory.name, "shards")
+        os.makedirs(shards)
+        return chessengine.ingest_pgn(path, os.path.join(shards, "games"), **kwargs), shards
+
+    def test_counts_and_records(self):
+        stats, shards = self.ingest(PGN, num_threads=1, generation=7)
+        self.assertEqual((stats["games"], stats["skipped"], stats["truncated"]), (2, 3, 1))
+        self.assertEqual(stats["positions"], 6 + 8)
+        self.assertEqual(stats["shards"], 1)
+        self.assertEqual(stats["bytes"], len(PGN))
+
+        # The variations and comments are skipped; the underpromotion game is kept up to the promotion
+        buffer = chessengine.ReplayBuffer(shards)
+        self.assertEqual(len(buffer), 14)
+        states, policies, values = buffer.decode(list(range(14)))
+        for offset, (moves, game, result) in zip((0, 6), ((SPANISH, 0, 1), (PROMOTION, 1, -1))):
+            boards = [board_after(moves[:ply]) for ply in range(len(moves))]
+            np.testing.assert_array_equal(states[offset:offset + len(moves)], states_of(boards))
+            for ply, text in enumerate(moves):
+                index = offset + ply
+                record = buffer.record(index)
+                self.assertEqual((record["game"], record["ply"], record["game_plies"]), (game, ply, len(moves)))
+                self.assertEqual((record["generation"], record["visits"]), (7, 1))
+                self.assertEqual(values[index], result if ply % 2 == 0 else -result)
+                self.assertEqual(policies[index].argmax(), chessengine.move_to_index(move(text)))
+                self.assertEqual(policies[index].sum(), 1.0)
+
+    def test_game_ids_are_unique_across_threads(self):
+        # Large enough to be split across threads
+        games = "".join(PGN.split("\n\n[Event \"Set up")[0] + "\n\n" for _ in range(100))
+        stats, shards = self.ingest(games, num_threads=3)
+        self.assertGreater(stats["shards"], 1)
+        self.assertEqual((stats["games"], stats["positions"]), (100, 600))
+        self.assertEqual(len(glob.glob(os.path.join(shards, "*.shard"))), stats["shards"])
+
+        buffer = chessengine.ReplayBuffer(shards)
+        records = [buffer.record(i) for i in range(len(buffer))]
+        self.assertEqual(sorted({record["game"] for record in records}), list(range(100)))
+        for game in range(100):
+            self.assertEqual([record["ply"] for record in records if record["game"] == game], list(range(6)))
+
+    def test_existing_shards_are_not_appended_to(self):
+        stats, shards = self.ingest(PGN, num_threads=1)
+        path = os.path.join(shards, "games-000.shard")
+        size = os.path.getsize(path)
+        with self.assertRaisesRegex(RuntimeError, "shard already exists: .*games-000.shard"):
+            chessengine.ingest_pgn(os.path.join(self.directory.name, "games.pgn"), os.path.join(shards, "games"))
+        self.assertEqual(os.path.getsize(path), size)
+        self.assertEqual(len(chessengine.ReplayBuffer(shards)), stats["positions"])
+
+        # Another prefix in the same directory is fine, and so is one that only starts like an existing one
+        for prefix in ("more", "games-000"):
+            more = chessengine.ingest_pgn(os.path.join(self.directory.name, "games.pgn"), os.path.join(shards, prefix),
+                                          num_threads=1)
+            self.assertEqual(more["positions"], stats["positions"])
+        self.assertEqual(sorted(os.listdir(shards)), ["games-000-000.shard", "games-000.shard", "more-000.shard"])
+
+
+if __name__ == "__main__":
+    unittest.main()
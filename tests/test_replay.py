@@ -0,0 +1,204 @@
+"""Replay storage: the shard format, torn records and the sliding window of ReplayBuffer."""
+import os
+import struct
+import tempfile
+import threading
+import unittest
+import uuid
+
+import numpy as np
+
+import chessengine
+from test_mcts import board_after
+from test_network import random_boards, states_of
+
+# Positions whose packing is easy to get wrong: castling rights partly lost, en passant for either side
+SPECIAL_GAMES = [
+    ["e2e4", "e7e5", "g1f3", "b8c6", "f1c4", "f8c5"],             # Both sides may castle either way
+    ["e2e4", "e7e5", "g1f3", "b8c6", "f1c4", "f8c5", "e1g1"],     # White castled, Black to move
+    ["e2e4", "e7e5", "g1f3", "g8f6", "h1g1", "h8g8"],             # Only the queen sides remain
+    ["e2e4", "e7e5", "e1e2", "e8e7"],                             # Neither side may castle
+    ["e2e4", "a7a6", "e4e5", "d7d5"],                             # White may capture en passant on d6
+    ["h2h3", "e7e5", "h3h4", "e5e4", "d2d4"],                     # Black may capture en passant on d3
+    ["e2e4", "d7d5", "e4e5", "f7f5", "a2a3"],                     # The en passant chance has passed
+]
+
+
+class ReplayTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.addCleanup(self.directory.cleanup)
+
+    def path(self, name):
+        return os.path.join(self.directory.name, name)
+
+    def write_shard(self, name, boards, game=0, **kwargs):
+        writer = chessengine.ShardWriter(self.path(name))
+        for ply, board in enumerate(boards):
+            moves = [chessengine.move_to_index(move) for move in board.legal_moves()]
+            writer.append(board, moves, list(range(1, len(moves) + 1)), 1, game=game, ply=ply, **kwargs)
+        writer.flush()
+        return writer
+
+    def test_packed_positions_decode_to_the_state_tensor(self):
+        boards = [board_after(moves) for moves in SPECIAL_GAMES] + random_boards(60, seed=8)
+        self.write_shard("0.shard", boards)
+        states, policies, values = chessengine.ReplayBuffer(self.directory.name).decode(list(range(len(boards))))
+        np.testing.assert_array_equal(states, states_of(boards))
+        np.testing.assert_allclose(policies.sum(axis=1), 1.0, rtol=1e-5)
+        np.testing.assert_array_equal(values, 1.0)
+
+    def test_large_visit_counts_are_scaled_down(self):
+        board = chessengine.ChessBoard()
+        moves = [chessengine.move_to_index(move) for move in board.legal_moves()[:5]]
+        writer = chessengine.ShardWriter(self.path("0.shard"))
+        writer.append(board, moves, [70000, 40000, 10, 0, 1], 0)
+        writer.append(board, moves, [65535, 300, 2, 0, 1], 0)
+        writer.flush()
+        _, policies, _ = chessengine.ReplayBuffer(self.directory.name).decode([0, 1])
+
+        # Scaled by 65535 / 70000 and rounded, keeping the single visit; counts up to 65535 are kept as they are
+        for policy, counts in zip(policies, ([65535, 37449, 9, 0, 1], [65535, 300, 2, 0, 1])):
+            expected = np.zeros(4096)
+            expected[moves] = counts
+            np.testing.assert_allclose(policy, expected / expected.sum(), rtol=1e-6, atol=1e-9)
+        with self.assertRaises(ValueError):
+            writer.append(board, moves, [1, -1, 0, 0, 0], 0)
+
+    def test_torn_record_is_cut_off_on_reopen(self):
+        boards = random_boards(6, seed=9)
+        self.write_shard("0.shard", boards)
+        size = os.path.getsize(self.path("0.shard"))
+        with open(self.path("0.shard"), "r+b") as f:
+            f.seek(64)
+            first = f.read(52 + 4 * len(boards[0].legal_moves()))
+            f.seek(0, os.SEEK_END)
+            f.write(first[:-4])     # A crash in the middle of a record: its header but not all its visit counts
+
+        self.assertEqual(len(chessengine.ReplayBuffer(self.directory.name)), 6)
+        writer = chessengine.ShardWriter(self.path("0.shard"))
+        self.assertEqual(writer.records, 6)
+        self.assertEqual(os.path.getsize(self.path("0.shard")), size)
+
+        board = random_boards(7, seed=9)[-1]
+        writer.append(board, [chessengine.move_to_index(board.legal_moves()[0])], [3], -1, game=1, ply=6)
+        writer.flush()
+        buffer = chessengine.ReplayBuffer(self.directory.name)
+        self.assertEqual(len(buffer), 7)
+        self.assertEqual(buffer.record(6)["game"], 1)
+        states, _, values = buffer.decode([6])
+        np.testing.assert_array_equal(states, states_of([board]))
+        self.assertEqual(values[0], -1.0)
+
+    def test_window_slides_and_unmaps_old_shards(self):
+        boards = random_boards(5, seed=10)
+        self.write_shard("000.shard", boards, game=0)
+        self.write_shard("001.shard", boards, game=1)
+        buffer = chessengine.ReplayBuffer(self.directory.name, window=7)
+        self.assertEqual(len(buffer), 7)
+        self.assertEqual(buffer.num_shards, 2)
+        self.assertEqual((buffer.record(0)["game"], buffer.record(0)["ply"]), (0, 3))
+        self.assertEqual((buffer.record(6)["game"], buffer.record(6)["ply"]), (1, 4))
+
+        # A new shard pushes every position of the first out of the window, so it is unmapped
+        self.write_shard("002.shard", boards, game=2)
+        self.assertEqual(buffer.refresh(), 7)
+        self.assertEqual(buffer.num_shards, 2)
+        self.assertEqual((buffer.record(0)["game"], buffer.record(0)["ply"]), (1, 3))
+        with self.assertRaises(IndexError):
+            buffer.record(7)
+
+        # Records appended to a shard are picked up too, and a shard named before the newest one is ignored
+        writer = chessengine.ShardWriter(self.path("002.shard"))
+        board = boards[0]
+        writer.append(board, [chessengine.move_to_index(board.legal_moves()[0])], [1], 0, game=2, ply=5)
+        writer.flush()
+        self.write_shard("0000.shard", boards, game=3)
+        self.assertEqual(buffer.refresh(), 7)
+        self.assertEqual((buffer.record(0)["game"], buffer.record(0)["ply"]), (1, 4))
+        self.assertEqual((buffer.record(6)["game"], buffer.record(6)["ply"]), (2, 5))
+        self.assertEqual(buffer.num_shards, 2)
+
+        # Once the window lies inside the newest shard, only that one stays mapped
+        writer = self.write_shard("003.shard", boards * 2, game=4)
+        self.assertEqual(writer.records, 10)
+        self.assertEqual(buffer.refresh(), 7)
+        self.assertEqual(buffer.num_shards, 1)
+
+    def test_shard_shorter_than_its_header_is_picked_up_later(self):
+        boards = random_boards(5, seed=11)
+        self.write_shard("000.shard", boards, game=0)
+        open(self.path("001.shard"), "wb").close()      # Created, but its writer has not written the header yet
+        self.write_shard("002.shard", boards, game=2)
+        buffer = chessengine.ReplayBuffer(self.directory.name)
+        self.assertEqual((len(buffer), buffer.num_shards), (5, 1))     # 002 waits for 001 to keep the name order
+        self.assertEqual(buffer.refresh(), 5)
+
+        self.write_shard("001.shard", boards, game=1)
+        self.assertEqual(buffer.refresh(), 15)
+        self.assertEqual([buffer.record(i)["game"] for i in range(0, 15, 5)], [0, 1, 2])
+
+        # The data loader refreshes the same way
+        open(self.path("003.shard"), "wb").close()
+        loader = chessengine.DataLoader(self.directory.name, batch_size=4, threads=1, seed=0)
+        self.assertEqual(loader.refresh(), 15)
+
+    def test_move_outside_the_policy_is_rejected_when_indexed(self):
+        board = chessengine.ChessBoard()
+        self.write_shard("000.shard", [board])
+        with open(self.path("000.shard"), "rb") as f:
+            record = bytearray(f.read()[64:])
+        self.assertEqual(len(record), 52 + 4 * 20)
+        struct.pack_into("<H", record, 52 + 4 * 7, 4096)     # The move of the eighth visit count
+
+        with open(self.path("000.shard"), "ab") as f:
+            f.write(record)
+        with self.assertRaisesRegex(RuntimeError, "corrupt shard record"):
+            chessengine.ReplayBuffer(self.directory.name)
+        with self.assertRaisesRegex(RuntimeError, "corrupt shard record"):
+            chessengine.ShardWriter(self.path("000.shard"))
+
+        # Records received from another process are checked before they are written
+        name = "/test_replay_" + uuid.uuid4().hex
+        ring = chessengine.RecordRing(name, 1 << 16)
+        self.addCleanup(chessengine.RecordRing.unlink, name)
+        writer = chessengine.ShardWriter(self.path("001.shard"))
+        ring.push(bytes(record))
+        with self.assertRaisesRegex(RuntimeError, "corrupt shard record"):
+            ring.drain(writer)
+        self.assertEqual(writer.records, 0)
+
+    def test_refresh_while_other_threads_sample(self):
+        boards = random_boards(40, seed=12)
+        self.write_shard("000.shard", boards)
+        buffer = chessengine.ReplayBuffer(self.directory.name, window=40)
+        done, errors = threading.Event(), []
+
+        def sample():
+            try:
+                while not done.is_set():
+                    states, _, _ = buffer.sample(256)
+                    self.assertEqual(states.shape, (256, 9, 8, 8))
+            except Exception as error:
+                errors.append(error)
+
+        threads = [threading.Thread(target=sample) for _ in range(3)]
+        for thread in threads:
+            thread.start()
+        # Every new shard pushes the previous one out of the window, so refresh() unmaps it under the readers
+        for shard in range(1, 200):
+            self.write_shard(f"{shard:03d}.shard", boards, game=shard)
+            self.assertEqual(buffer.refresh(), 40)
+        done.set()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(errors, [])
+        self.assertEqual(buffer.num_shards, 1)
+
+    def test_missing_directory_is_an_error(self):
+        with self.assertRaisesRegex(RuntimeError, "cannot list shard directory"):
+            chessengine.ReplayBuffer(self.path("missing"))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,42 @@
+"""Native self-play: the worker pool that shares out the concurrent games."""
+import unittest
+
+import chessengine
+
+
+class SelfPlayTest(unittest.TestCase):
+    def play(self, threads, **kwargs):
+        games = []
+        stats = chessengine.self_play(None, games=10, concurrent_games=7, simulations=30, max_plies=40, seed=3,
+                                      threads=threads, on_game=games.append, **kwargs)
+        return stats, sorted(games, key=lambda game: game["index"])
+
+    def test_games_do_not_depend_on_the_workers(self):
+        # Each game has its own tree and move sampler, so how the games are shared out changes nothing
+        stats, games = self.play(1)
+        self.assertEqual(stats["games"], 10)
+        self.assertEqual([game["index"] for game in games], list(range(10)))
+        self.assertEqual(stats["positions"], sum(len(game["values"]) for game in games))
+        for threads in (3, 7, 0):
+            other_stats, other_games = self.play(threads)
+            self.assertEqual(other_stats["positions"], stats["positions"])
+            self.assertEqual(other_stats["simulations"], stats["simulations"])
+            for game, other in zip(games, other_games):
+                self.assertEqual(game["outcome"], other["outcome"])
+                self.assertTrue((game["policies"] == other["policies"]).all())
+
+    def test_evaluator_error_stops_the_run(self):
+        def failing(states):
+            raise ValueError("network failed")
+        with self.assertRaisesRegex(ValueError, "network failed"):
+            chessengine.self_play(failing, games=8, concurrent_games=4, simulations=10, threads=2)
+
+    def test_settings_are_checked(self):
+        # Without simulations every game would end at once as a draw and be recorded as one
+        for setting in ("simulations", "concurrent_games", "batch_size"):
+            with self.assertRaisesRegex(ValueError, "at least 1"):
+                chessengine.self_play(None, games=2, **{setting: 0})
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,63 @@
+"""Weight slot: publishing and reading blobs, and a publisher that crashes mid-publish."""
+import os
+import struct
+import time
+import unittest
+import uuid
+
+import chessengine
+
+SEQUENCE_OFFSET = 64    # The sequence counter of the slot header, after magic, version and capacity (64-byte aligned)
+
+
+class WeightSlotTest(unittest.TestCase):
+    def setUp(self):
+        self.name = "test_slot_" + uuid.uuid4().hex
+        self.addCleanup(chessengine.WeightSlot.unlink, self.name)
+
+    def sequence(self):
+        with open(os.path.join("/dev/shm", self.name), "rb") as f:
+            f.seek(SEQUENCE_OFFSET)
+            return struct.unpack("<Q", f.read(8))[0]
+
+    def set_sequence(self, value):
+        with open(os.path.join("/dev/shm", self.name), "r+b") as f:
+            f.seek(SEQUENCE_OFFSET)
+            f.write(struct.pack("<Q", value))
+
+    def test_publish_and_read(self):
+        slot = chessengine.WeightSlot(self.name, 4096)
+        self.assertIsNone(slot.read())
+        self.assertEqual(slot.publish(b"first"), 1)
+        self.assertEqual(slot.publish(b"second"), 2)
+        self.assertEqual(self.sequence(), 4)
+        reader = chessengine.WeightSlot(self.name)
+        self.assertEqual(reader.read(), (2, b"second"))
+        self.assertIsNone(reader.read(2))
+        with self.assertRaises(ValueError):
+            slot.publish(bytes(8192))
+
+    @unittest.skipUnless(os.path.isdir("/dev/shm"), "needs /dev/shm")
+    def test_restart_after_a_crash_mid_publish(self):
+        publisher = chessengine.WeightSlot(self.name, 4096)
+        publisher.publish(b"before")
+        reader = chessengine.WeightSlot(self.name)
+        self.set_sequence(self.sequence() + 1)      # The publisher died between marking the publish and finishing it
+
+        # The reader gives up on the torn blob instead of waiting forever
+        start = time.monotonic()
+        self.assertIsNone(reader.read())
+        self.assertLess(time.monotonic() - start, 5.0)
+        self.assertIsNone(reader.network())
+
+        # A restarted publisher's publishes are readable again
+        restarted = chessengine.WeightSlot(self.name)
+        self.assertEqual(restarted.publish(b"after"), 2)
+        self.assertEqual(self.sequence() % 2, 0)
+        self.assertEqual(reader.read(), (2, b"after"))
+        self.assertEqual(restarted.publish(b"again"), 3)
+        self.assertEqual(reader.read(2), (3, b"again"))
+
+
+if __name__ == "__main__":
+    unittest.main()